@@ -3,7 +3,13 @@
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "devices/iosched.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* A block device. */
 struct block
@@ -19,6 +25,14 @@ struct block
 
     unsigned long long read_cnt;        /* Number of sectors read. */
     unsigned long long write_cnt;       /* Number of sectors written. */
+    struct iostat stats;                /* Request statistics. */
+
+    struct lock queue_lock;             /* Protects queue. */
+    struct condition queue_nonempty;    /* Signaled when queue fills. */
+    struct iosched_queue queue;         /* Pending requests. */
+    struct block_request *barrier;      /* Pending flush, or null. */
+    struct list held;                   /* Requests submitted after
+                                           BARRIER, in arrival order. */
   };
 
 /* List of all block devices. */
@@ -27,7 +41,33 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 /* The block block assigned to each Pintos role. */
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
+/* Request statistics for each Pintos role, covering whichever
+   device held the role when each request completed. */
+static struct iostat role_stats[BLOCK_ROLE_CNT];
+
+/* A completed request, as remembered in the trace. */
+struct trace_entry
+  {
+    struct block *block;        /* Device. */
+    bool write;                 /* Write or read? */
+    block_sector_t sector;      /* First sector. */
+    size_t cnt;                 /* Number of sectors. */
+    int64_t submit_time;        /* timer_usec() at submission, */
+    int64_t issue_time;         /* ...when handed to the driver, */
+    int64_t complete_time;      /* ...and when the driver finished. */
+  };
+
+/* Ring buffer of the last trace_size completed requests, on all
+   devices.  Disabled if trace_size is 0. */
+static struct trace_entry *trace;
+static size_t trace_size;
+static unsigned long long trace_cnt;   /* Requests ever traced. */
+
 static struct block *list_elem_to_block (struct list_elem *);
+static void check_sectors (struct block *, block_sector_t, size_t cnt);
+static void transfer_sync (struct block *, bool write, block_sector_t,
+                           size_t cnt, void *buffer);
+static void io_thread (void *block_);
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -120,9 +160,7 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
-  check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  transfer_sync (block, false, sector, 1, buffer);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +171,306 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
+  transfer_sync (block, true, sector, 1, (void *) buffer);
+}
+
+/* Verifies that the CNT sectors starting at SECTOR are valid
+   offsets within BLOCK.  Panics if not. */
+static void
+check_sectors (struct block *block, block_sector_t sector, size_t cnt)
+{
+  ASSERT (cnt > 0);
   check_sector (block, sector);
-  ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  if (cnt > block->size - sector)
+    PANIC ("Access past end of device %s (sector=%"PRDSNu", cnt=%zu, "
+           "size=%"PRDSNu")\n", block_name (block), sector, cnt,
+           block->size);
+}
+
+/* Reads the CNT consecutive sectors starting at SECTOR from BLOCK
+   into BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes.  Drivers that can move several sectors per command do
+   so; for others this is the same as CNT calls to block_read().
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_read_multiple (struct block *block, block_sector_t sector, size_t cnt,
+                     void *buffer)
+{
+  transfer_sync (block, false, sector, cnt, buffer);
+}
+
+/* Writes the CNT consecutive sectors starting at SECTOR to BLOCK
+   from BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes.
+   Returns after the block device has acknowledged receiving all
+   of the data.  Drivers that can move several sectors per
+   command do so; for others this is the same as CNT calls to
+   block_write().
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_write_multiple (struct block *block, block_sector_t sector, size_t cnt,
+                      const void *buffer)
+{
+  transfer_sync (block, true, sector, cnt, (void *) buffer);
+}
+
+/* Waits until every write to BLOCK that completed before the
+   call is on stable media.  Block writes only wait for the
+   device to acknowledge the data, which a device with its write
+   cache enabled does before the data is safe from power loss, so
+   a file system calls this at its durability points. */
+void
+block_flush (struct block *block)
+{
+  struct block_request r;
+  struct semaphore done;
+
+  sema_init (&done, 0);
+  block_flush_request_init (&r, block_request_sema_up, &done);
+  block_submit (block, &r);
+  sema_down (&done);
+}
+
+/* Initializes request R to move CNT sectors starting at SECTOR
+   between a block device and BUFFER, writing them to the device
+   if WRITE is true and reading them otherwise.  DONE, if
+   non-null, will be called with R and AUX once R completes.
+   BUFFER must be a kernel address, because the device's I/O
+   thread, not the caller, carries out the transfer. */
+void
+block_request_init (struct block_request *r, bool write,
+                    block_sector_t sector, size_t cnt, void *buffer,
+                    block_request_func *done, void *aux)
+{
+  r->write = write;
+  r->sector = sector;
+  r->cnt = cnt;
+  r->buffer = buffer;
+  r->flush = false;
+  r->done = done;
+  r->aux = aux;
+}
+
+/* Initializes request R as a cache flush barrier.  DONE, if
+   non-null, will be called with R and AUX once R completes. */
+void
+block_flush_request_init (struct block_request *r,
+                          block_request_func *done, void *aux)
+{
+  block_request_init (r, true, 0, 0, NULL, done, aux);
+  r->flush = true;
+}
+
+/* Queues request R on BLOCK and returns without waiting for it.
+   Panics if R lies outside BLOCK. */
+void
+block_submit (struct block *block, struct block_request *r)
+{
+  if (!r->flush)
+    {
+      check_sectors (block, r->sector, r->cnt);
+      ASSERT (!r->write || block->type != BLOCK_FOREIGN);
+      ASSERT (is_kernel_vaddr (r->buffer));
+    }
+
+  r->run_cnt = r->cnt;
+  r->merged = NULL;
+  r->submit_time = timer_usec ();
+  lock_acquire (&block->queue_lock);
+  if (block->barrier != NULL)
+    list_push_back (&block->held, &r->elem);
+  else if (r->flush)
+    block->barrier = r;
+  else
+    iosched_add (&block->queue, r);
+  cond_signal (&block->queue_nonempty, &block->queue_lock);
+  lock_release (&block->queue_lock);
+}
+
+/* Completion function that ups SEMA, a struct semaphore *.
+   Submitting several requests with the same semaphore, then
+   downing it once per request, waits for all of them while
+   they proceed in parallel, even on different devices. */
+void
+block_request_sema_up (struct block_request *r UNUSED, void *sema)
+{
+  sema_up (sema);
+}
+
+/* Queues a request to move CNT sectors starting at SECTOR
+   between BLOCK and BUFFER, as in block_request_init(), and
+   waits for it to complete. */
+static void
+transfer_sync (struct block *block, bool write, block_sector_t sector,
+               size_t cnt, void *buffer)
+{
+  struct block_request r;
+  struct semaphore done;
+
+  sema_init (&done, 0);
+  block_request_init (&r, write, sector, cnt, buffer,
+                      block_request_sema_up, &done);
+  block_submit (block, &r);
+  sema_down (&done);
+}
+
+/* Has BLOCK's driver move CNT sectors starting at SECTOR to
+   BLOCK from BUFFER if WRITE is true, or from BLOCK into BUFFER
+   otherwise. */
+static void
+driver_transfer (struct block *block, bool write, block_sector_t sector,
+                 size_t cnt, void *buffer)
+{
+  const struct block_operations *ops = block->ops;
+  uint8_t *p = buffer;
+  size_t i;
+
+  if (write)
+    {
+      if (ops->write_multiple != NULL)
+        ops->write_multiple (block->aux, sector, cnt, p);
+      else
+        for (i = 0; i < cnt; i++)
+          ops->write (block->aux, sector + i, p + i * BLOCK_SECTOR_SIZE);
+      block->write_cnt += cnt;
+    }
+  else
+    {
+      if (ops->read_multiple != NULL)
+        ops->read_multiple (block->aux, sector, cnt, p);
+      else
+        for (i = 0; i < cnt; i++)
+          ops->read (block->aux, sector + i, p + i * BLOCK_SECTOR_SIZE);
+      block->read_cnt += cnt;
+    }
+}
+
+/* Returns the histogram bucket for a latency of US
+   microseconds. */
+static int
+latency_bucket (int64_t us)
+{
+  int bucket = 0;
+
+  while (us >= 2 && bucket < IOSTAT_BUCKETS - 1)
+    {
+      us >>= 1;
+      bucket++;
+    }
+  return bucket;
+}
+
+/* Adds request R, which waited from its submission until
+   ISSUE_TIME and was served until COMPLETE_TIME, to S. */
+static void
+add_to_stats (struct iostat *s, const struct block_request *r,
+              int64_t issue_time, int64_t complete_time)
+{
+  enum iostat_dir dir = r->write ? IOSTAT_WRITE : IOSTAT_READ;
+
+  s->requests[dir]++;
+  s->bytes[dir] += r->cnt * BLOCK_SECTOR_SIZE;
+  s->wait[dir][latency_bucket (issue_time - r->submit_time)]++;
+  s->service[dir][latency_bucket (complete_time - issue_time)]++;
+}
+
+/* Records completed request R on BLOCK in BLOCK's statistics,
+   those of BLOCK's roles, and the trace. */
+static void
+account_request (struct block *block, const struct block_request *r,
+                 int64_t issue_time, int64_t complete_time)
+{
+  enum intr_level old_level;
+  int role;
+
+  old_level = intr_disable ();
+  add_to_stats (&block->stats, r, issue_time, complete_time);
+  for (role = 0; role < BLOCK_ROLE_CNT; role++)
+    if (block_by_role[role] == block)
+      add_to_stats (&role_stats[role], r, issue_time, complete_time);
+
+  if (trace != NULL)
+    {
+      struct trace_entry *t = &trace[trace_cnt++ % trace_size];
+      t->block = block;
+      t->write = r->write;
+      t->sector = r->sector;
+      t->cnt = r->cnt;
+      t->submit_time = r->submit_time;
+      t->issue_time = issue_time;
+      t->complete_time = complete_time;
+    }
+  intr_set_level (old_level);
+}
+
+/* Issues BLOCK's pending flush barrier, which the caller has
+   checked is the only request left, then queues the requests
+   held behind it, up to the next barrier, and completes it. */
+static void
+issue_barrier (struct block *block)
+{
+  struct block_request *r = block->barrier;
+
+  if (block->ops->flush != NULL)
+    block->ops->flush (block->aux);
+
+  lock_acquire (&block->queue_lock);
+  block->barrier = NULL;
+  while (!list_empty (&block->held) && block->barrier == NULL)
+    {
+      struct block_request *h = list_entry (list_pop_front (&block->held),
+                                            struct block_request, elem);
+      if (h->flush)
+        block->barrier = h;
+      else
+        iosched_add (&block->queue, h);
+    }
+  lock_release (&block->queue_lock);
+
+  if (r->done != NULL)
+    r->done (r, r->aux);
+}
+
+/* I/O thread for block device BLOCK_.  Issues BLOCK's queued
+   requests one at a time, in the order its I/O scheduler picks,
+   and runs their completion functions.  A pending flush barrier
+   is issued once the scheduler has drained. */
+static void
+io_thread (void *block_)
+{
+  struct block *block = block_;
+
+  for (;;)
+    {
+      struct block_request *r, *next;
+      int64_t issue_time, complete_time;
+
+      lock_acquire (&block->queue_lock);
+      while (iosched_empty (&block->queue) && block->barrier == NULL)
+        cond_wait (&block->queue_nonempty, &block->queue_lock);
+      if (iosched_empty (&block->queue))
+        {
+          lock_release (&block->queue_lock);
+          issue_barrier (block);
+          continue;
+        }
+      r = iosched_next (&block->queue);
+      lock_release (&block->queue_lock);
+
+      issue_time = timer_usec ();
+      driver_transfer (block, r->write, r->sector, r->run_cnt, r->buffer);
+      complete_time = timer_usec ();
+
+      /* A completion function may free its request. */
+      for (; r != NULL; r = next)
+        {
+          next = r->merged;
+          account_request (block, r, issue_time, complete_time);
+          if (r->done != NULL)
+            r->done (r, r->aux);
+        }
+    }
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -160,10 +494,79 @@ block_type (struct block *block)
   return block->type;
 }
 
-/* Prints statistics for each block device used for a Pintos role. */
+/* Prints histogram HIST, labeled LABEL, listing only nonempty
+   buckets by their lower bounds in microseconds. */
+static void
+print_histogram (const char *label, const unsigned long long *hist)
+{
+  int i;
+
+  printf ("    %s:", label);
+  for (i = 0; i < IOSTAT_BUCKETS; i++)
+    if (hist[i] != 0)
+      printf (" %lluus+ %llu", i == 0 ? 0 : 1ULL << i, hist[i]);
+  printf ("\n");
+}
+
+/* Prints the request counts and latency histograms in S. */
+static void
+print_iostat (const struct iostat *s)
+{
+  static const char *dir_names[IOSTAT_DIR_CNT] = {"read", "write"};
+  int dir;
+
+  for (dir = 0; dir < IOSTAT_DIR_CNT; dir++)
+    if (s->requests[dir] != 0)
+      {
+        printf ("  %s: %llu requests, %llu bytes\n",
+                dir_names[dir], s->requests[dir], s->bytes[dir]);
+        print_histogram ("wait", s->wait[dir]);
+        print_histogram ("service", s->service[dir]);
+      }
+}
+
+/* Returns true if BLOCK holds some Pintos role. */
+static bool
+has_role (const struct block *block)
+{
+  int i;
+
+  for (i = 0; i < BLOCK_ROLE_CNT; i++)
+    if (block_by_role[i] == block)
+      return true;
+  return false;
+}
+
+/* Prints the trace of recent requests, oldest first. */
+static void
+print_trace (void)
+{
+  unsigned long long i, first;
+
+  if (trace == NULL || trace_cnt == 0)
+    return;
+
+  first = trace_cnt > trace_size ? trace_cnt - trace_size : 0;
+  printf ("I/O trace (last %llu of %llu requests, times in us):\n",
+          trace_cnt - first, trace_cnt);
+  for (i = first; i < trace_cnt; i++)
+    {
+      const struct trace_entry *t = &trace[i % trace_size];
+      printf ("  %lld %s %c %"PRDSNu"+%zu wait %lld service %lld\n",
+              t->submit_time, t->block->name, t->write ? 'W' : 'R',
+              t->sector, t->cnt, t->issue_time - t->submit_time,
+              t->complete_time - t->issue_time);
+    }
+}
+
+/* Prints statistics for each block device used for a Pintos
+   role, with latency histograms for the role, then those of
+   other devices that did any I/O, then the request trace if
+   enabled. */
 void
 block_print_stats (void)
 {
+  struct list_elem *e;
   int i;
 
   for (i = 0; i < BLOCK_ROLE_CNT; i++)
@@ -174,8 +577,60 @@ block_print_stats (void)
           printf ("%s (%s): %llu reads, %llu writes\n",
                   block->name, block_type_name (block->type),
                   block->read_cnt, block->write_cnt);
+          print_iostat (&role_stats[i]);
+        }
+    }
+
+  for (e = list_begin (&all_blocks); e != list_end (&all_blocks);
+       e = list_next (e))
+    {
+      struct block *block = list_entry (e, struct block, list_elem);
+      if (!has_role (block) && block->read_cnt + block->write_cnt > 0)
+        {
+          printf ("%s: %llu reads, %llu writes\n",
+                  block->name, block->read_cnt, block->write_cnt);
+          print_iostat (&block->stats);
         }
     }
+
+  print_trace ();
+}
+
+/* Copies into *STATS the request statistics for NAME, which may
+   name a role ("filesys", "scratch", "swap") or a block device
+   ("hda").  Returns false if there is no such role or device. */
+bool
+block_get_stats (const char *name, struct iostat *stats)
+{
+  const struct iostat *s = NULL;
+  enum intr_level old_level;
+  int i;
+
+  for (i = 0; i < BLOCK_ROLE_CNT; i++)
+    if (!strcmp (name, block_type_name (i)))
+      s = &role_stats[i];
+  if (s == NULL)
+    {
+      struct block *block = block_get_by_name (name);
+      if (block == NULL)
+        return false;
+      s = &block->stats;
+    }
+
+  old_level = intr_disable ();
+  *stats = *s;
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Keeps a trace of the last CNT requests on all block devices,
+   printed by block_print_stats().  May be called before the
+   memory allocator is initialized; the trace is allocated when
+   the first block device is registered. */
+void
+block_trace_configure (size_t cnt)
+{
+  trace_size = cnt;
 }
 
 /* Registers a new block device with the given NAME.  If
@@ -189,9 +644,18 @@ block_register (const char *name, enum block_type type,
                 const struct block_operations *ops, void *aux)
 {
   struct block *block = malloc (sizeof *block);
+  char thread_name[sizeof block->name + 3];
+
   if (block == NULL)
     PANIC ("Failed to allocate memory for block device descriptor");
 
+  if (trace == NULL && trace_size > 0)
+    {
+      trace = calloc (trace_size, sizeof *trace);
+      if (trace == NULL)
+        trace_size = 0;
+    }
+
   list_push_back (&all_blocks, &block->list_elem);
   strlcpy (block->name, name, sizeof block->name);
   block->type = type;
@@ -200,6 +664,12 @@ block_register (const char *name, enum block_type type,
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+  memset (&block->stats, 0, sizeof block->stats);
+  lock_init (&block->queue_lock);
+  cond_init (&block->queue_nonempty);
+  iosched_init (&block->queue, iosched_default);
+  block->barrier = NULL;
+  list_init (&block->held);
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -208,6 +678,10 @@ block_register (const char *name, enum block_type type,
     printf (", %s", extra_info);
   printf ("\n");
 
+  snprintf (thread_name, sizeof thread_name, "%s-io", block->name);
+  if (thread_create (thread_name, PRI_MAX, io_thread, block) == TID_ERROR)
+    PANIC ("Failed to start I/O thread for block device %s", block->name);
+
   return block;
 }
 
@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 #include <inttypes.h>
+#include <iostat.h>
+#include <list.h>
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -53,11 +55,67 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multiple (struct block *, block_sector_t, size_t cnt,
+                          void *);
+void block_write_multiple (struct block *, block_sector_t, size_t cnt,
+                           const void *);
+void block_flush (struct block *);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
+/* Asynchronous requests.
+
+   A request moves CNT consecutive sectors between a block device
+   and BUFFER.  Submitting it queues it on the device and returns
+   at once; the device's I/O thread later issues it, in the order
+   chosen by the device's I/O scheduler (see devices/iosched.h),
+   and then calls its DONE function, if any, from that thread.
+   The request and BUFFER must stay valid until then.  DONE must
+   not wait for I/O on the same device or block on a lock held by
+   a thread that might, or the device deadlocks.
+
+   A flush request, set up by block_flush_request_init(), moves
+   no data.  It is a barrier: it is issued only after every
+   request submitted before it has completed, and no request
+   submitted after it is issued until it completes.  It
+   completes once everything written before it is on stable
+   media. */
+struct block_request;
+typedef void block_request_func (struct block_request *, void *aux);
+
+struct block_request
+  {
+    /* Set by block_request_init() or block_flush_request_init(). */
+    bool flush;                 /* Cache flush barrier? */
+    bool write;                 /* Write to device (or read from it)? */
+    block_sector_t sector;      /* First sector. */
+    size_t cnt;                 /* Number of sectors. */
+    void *buffer;               /* CNT * BLOCK_SECTOR_SIZE bytes. */
+    block_request_func *done;   /* Called on completion, if non-null. */
+    void *aux;                  /* Passed to DONE. */
+
+    /* Owned by the block layer and I/O scheduler. */
+    struct list_elem elem;      /* Element in queue in scheduling order. */
+    struct list_elem fifo_elem; /* Element in queue in arrival order. */
+    int64_t deadline;           /* Timer tick by which to issue it. */
+    int64_t submit_time;        /* timer_usec() when submitted. */
+    size_t run_cnt;             /* Sectors in this request and MERGED. */
+    struct block_request *merged;   /* Next request served together with
+                                       this one, in sector order. */
+  };
+
+void block_request_init (struct block_request *, bool write,
+                         block_sector_t, size_t cnt, void *buffer,
+                         block_request_func *, void *aux);
+void block_flush_request_init (struct block_request *,
+                               block_request_func *, void *aux);
+void block_submit (struct block *, struct block_request *);
+void block_request_sema_up (struct block_request *, void *sema);
+
 /* Statistics. */
 void block_print_stats (void);
+bool block_get_stats (const char *name, struct iostat *);
+void block_trace_configure (size_t cnt);
 
 /* Lower-level interface to block device drivers. */
 
@@ -65,6 +123,19 @@ struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+
+    /* Transfer CNT consecutive sectors at once.  Optional: a
+       driver that leaves these null gets one read or write call
+       per sector instead. */
+    void (*read_multiple) (void *aux, block_sector_t, size_t cnt,
+                           void *buffer);
+    void (*write_multiple) (void *aux, block_sector_t, size_t cnt,
+                            const void *buffer);
+
+    /* Writes data that the device has acknowledged, but may still
+       hold in a volatile write cache, to stable media.  Optional:
+       null for a device without such a cache. */
+    void (*flush) (void *aux);
   };
 
 struct block *block_register (const char *name, enum block_type,
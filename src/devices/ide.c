@@ -3,12 +3,16 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/block.h"
 #include "devices/partition.h"
+#include "devices/pci.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -30,10 +34,32 @@
 #define reg_ctl(CHANNEL) ((CHANNEL)->reg_base + 0x206)  /* Control (w/o). */
 #define reg_alt_status(CHANNEL) reg_ctl (CHANNEL)       /* Alt Status (r/o). */
 
+/* Bus-master IDE port addresses, relative to the base found in
+   the controller's PCI BAR4.  See [SFF-8038i]. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRD table. */
+
+/* Bus-master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start/stop bus master. */
+#define BM_CMD_TO_MEMORY 0x08   /* Transfer direction: 1=disk to memory. */
+
+/* Bus-master Status Register bits (write 1 to clear). */
+#define BM_STA_ERR 0x02         /* Error. */
+#define BM_STA_INTR 0x04        /* Interrupt. */
+
+/* PCI class and subclass of an IDE controller, and the bit in
+   its programming interface byte that marks bus-master
+   support. */
+#define PCI_CLASS_STORAGE 0x01
+#define PCI_SUBCLASS_IDE 0x01
+#define PCI_IDE_BUS_MASTER 0x80
+
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +75,31 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+#define CMD_FLUSH_CACHE 0xe7            /* FLUSH CACHE. */
+
+/* Most sectors a single command can transfer, encoded as a
+   sector count of 0. */
+#define MAX_SECTORS_PER_CMD 256
+
+/* A physical region descriptor.  The bus master walks a table
+   of these, moving SIZE bytes to or from ADDR for each, until
+   it reaches an entry with PRD_EOT set.  A region must not
+   cross a 64 kB boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address; must be even. */
+    uint16_t size;              /* Byte count, with 0 meaning 64 kB. */
+    uint16_t flags;             /* PRD_EOT on the last entry. */
+  };
+
+#define PRD_EOT 0x8000          /* End of table. */
+#define PRD_BOUNDARY 0x10000    /* Regions may not cross this. */
+#define PRD_CNT (PGSIZE / sizeof (struct prd))  /* Table size. */
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +108,10 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    int multiple;               /* Sectors per interrupt for READ/WRITE
+                                   MULTIPLE, or 0 if not supported. */
+    bool dma;                   /* Supports READ/WRITE DMA? */
+    bool flush;                 /* Supports FLUSH CACHE? */
   };
 
 /* An ATA channel (aka controller).
@@ -72,6 +127,9 @@ struct channel
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+    uint16_t bm_base;           /* Bus-master base port, or 0 if none. */
+    struct prd *prdt;           /* PRD table, one page, if bm_base != 0. */
+
     struct ata_disk devices[2];     /* The devices on this channel. */
   };
 
@@ -81,11 +139,19 @@ static struct channel channels[CHANNEL_CNT];
 
 static struct block_operations ide_operations;
 
+/* Use bus-master DMA for transfers when the controller and disk
+   support it?  Cleared to force PIO, e.g. for benchmarking. */
+bool ide_use_dma = true;
+
+static uint16_t find_bus_master (void);
+
 static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static void select_sector (struct ata_disk *, block_sector_t, size_t cnt);
+static bool dma_transfer (struct ata_disk *, block_sector_t, size_t cnt,
+                          const void *buffer, bool to_memory);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -101,6 +167,7 @@ static void interrupt_handler (struct intr_frame *);
 void
 ide_init (void) 
 {
+  uint16_t bm_base = find_bus_master ();
   size_t chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
@@ -126,6 +193,18 @@ ide_init (void)
       lock_init (&c->lock);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+
+      /* Set up bus-master DMA.  The second channel's registers
+         follow the first's. */
+      c->bm_base = 0;
+      c->prdt = NULL;
+      if (bm_base != 0)
+        {
+          c->bm_base = bm_base + chan_no * 8;
+          c->prdt = palloc_get_page (PAL_ASSERT);
+          outb (reg_bm_command (c), 0);
+          outb (reg_bm_status (c), BM_STA_ERR | BM_STA_INTR);
+        }
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -136,6 +215,9 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->multiple = 0;
+          d->dma = false;
+          d->flush = false;
         }
 
       /* Register interrupt handler. */
@@ -154,10 +236,58 @@ ide_init (void)
           identify_ata_device (&c->devices[dev_no]);
     }
 }
+/* Looks for a PCI IDE controller capable of bus-master DMA
+   whose channels sit at the legacy ports we drive, and enables
+   bus mastering on it.  Returns its bus-master base port, or 0
+   if there is none, in which case all transfers use PIO. */
+static uint16_t
+find_bus_master (void)
+{
+  struct pci_addr addr;
+  uint32_t class, bar;
+  uint8_t prog_if;
+
+  if (!pci_find_class (PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, &addr))
+    return 0;
+
+  /* Bits 0 and 2 of the programming interface select native
+     rather than legacy ports for channels 0 and 1. */
+  class = pci_read_config (addr, PCI_REG_CLASS);
+  prog_if = class >> 8;
+  if (!(prog_if & PCI_IDE_BUS_MASTER) || (prog_if & 0x05) != 0)
+    return 0;
+
+  /* BAR4 must be an I/O space base address. */
+  bar = pci_read_config (addr, PCI_REG_BAR (4));
+  if (!(bar & 1) || (bar & 0xfffc) == 0)
+    return 0;
+
+  pci_write_config (addr, PCI_REG_CMD,
+                    (pci_read_config (addr, PCI_REG_CMD)
+                     | PCI_CMD_IO | PCI_CMD_MASTER));
+  printf ("ide: bus-master DMA at port %#x\n", bar & 0xfffc);
+  return bar & 0xfffc;
+}
+
+/* Returns true if any disk can use bus-master DMA. */
+bool
+ide_dma_available (void)
+{
+  size_t chan_no;
+  int dev_no;
+
+  for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+    for (dev_no = 0; dev_no < 2; dev_no++)
+      if (channels[chan_no].devices[dev_no].dma)
+        return true;
+  return false;
+}
 
 /* Disk detection and identification. */
 
 static char *descramble_ata_string (char *, int size);
+static void set_multiple_mode (struct ata_disk *, const char *id);
+static bool is_virtual_disk (const char *model, const char *serial);
 
 /* Resets an ATA channel and waits for any devices present on it
    to finish the reset. */
@@ -293,8 +423,11 @@ identify_ata_device (struct ata_disk *d)
      physical IDE disks rather than virtual ones.  If we don't
      allow access to those, we're less likely to scribble on
      someone's important data.  You can disable this check by
-     hand if you really want to do so. */
-  if (capacity >= 1024 * 1024 * 1024 / BLOCK_SECTOR_SIZE)
+     hand if you really want to do so.  Disks that identify
+     themselves as QEMU or Bochs virtual disks are exempt, so
+     the file system can use the whole 28-bit LBA range. */
+  if (capacity >= 1024 * 1024 * 1024 / BLOCK_SECTOR_SIZE
+      && !is_virtual_disk (model, serial))
     {
       printf ("%s: ignoring ", d->name);
       print_human_readable_size (capacity * 512);
@@ -303,12 +436,60 @@ identify_ata_device (struct ata_disk *d)
       return;
     }
 
+  set_multiple_mode (d, id);
+
+  /* Word 49, bit 8: DMA supported. */
+  d->dma = c->bm_base != 0 && (id[49 * 2 + 1] & 0x01) != 0;
+
+  /* Word 83, bit 12: FLUSH CACHE supported, valid only if bits
+     15:14 of the word are 01.  Older disks without the command
+     write through, so they need no flush. */
+  d->flush = (id[83 * 2 + 1] & 0xc0) == 0x40
+             && (id[83 * 2 + 1] & 0x10) != 0;
+
   /* Register. */
   block = block_register (d->name, BLOCK_RAW, extra_info, capacity,
                           &ide_operations, d);
   partition_scan (block);
 }
 
+/* Enables READ/WRITE MULTIPLE on disk D, whose IDENTIFY DEVICE
+   data is ID, with the largest block size the disk supports.
+   Leaves D->multiple at 0 if the disk supports no block size
+   or rejects the setting. */
+static void
+set_multiple_mode (struct ata_disk *d, const char *id)
+{
+  struct channel *c = d->channel;
+  int max = (uint8_t) id[47 * 2];
+  int multiple;
+
+  d->multiple = 0;
+  if (max == 0)
+    return;
+
+  /* Block sizes must be powers of 2. */
+  for (multiple = 1; multiple * 2 <= max; multiple *= 2)
+    continue;
+
+  select_device_wait (d);
+  outb (reg_nsect (c), multiple);
+  issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+  sema_down (&c->completion_wait);
+  wait_while_busy (d);
+  if (!(inb (reg_status (c)) & STA_ERR))
+    d->multiple = multiple;
+}
+
+/* Returns true if MODEL and SERIAL, as read from an IDENTIFY
+   DEVICE block, name a disk emulated by QEMU or Bochs. */
+static bool
+is_virtual_disk (const char *model, const char *serial)
+{
+  return (!memcmp (model, "QEMU ", 5)
+          || !memcmp (serial, "BXHD", 4));
+}
+
 /* Translates STRING, which consists of SIZE bytes in a funky
    format, into a null-terminated string in-place.  Drops
    trailing whitespace and null bytes.  Returns STRING.  */
@@ -347,12 +528,15 @@ ide_read (void *d_, block_sector_t sec_no, void *buffer)
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
+  if (!dma_transfer (d, sec_no, 1, buffer, true))
+    {
+      select_sector (d, sec_no, 1);
+      issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+      sema_down (&c->completion_wait);
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
+      input_sector (c, buffer);
+    }
   lock_release (&c->lock);
 }
 
@@ -367,33 +551,153 @@ ide_write (void *d_, block_sector_t sec_no, const void *buffer)
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
+  if (!dma_transfer (d, sec_no, 1, buffer, false))
+    {
+      select_sector (d, sec_no, 1);
+      issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
+      output_sector (c, buffer);
+      sema_down (&c->completion_wait);
+    }
+  lock_release (&c->lock);
+}
+
+/* Reads CNT sectors starting at SEC_NO from disk D into BUFFER,
+   which must have room for CNT * BLOCK_SECTOR_SIZE bytes.  Each
+   command moves up to MAX_SECTORS_PER_CMD sectors, by DMA
+   straight into BUFFER if possible.  Otherwise PIO is used,
+   with one interrupt per D->multiple sectors if READ MULTIPLE
+   is enabled and one per sector otherwise.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_read_multiple (void *d_, block_sector_t sec_no, size_t cnt, void *buffer)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  size_t per_intr = d->multiple > 0 ? (size_t) d->multiple : 1;
+  uint8_t *p = buffer;
+
+  while (cnt > 0)
+    {
+      size_t n = cnt < MAX_SECTORS_PER_CMD ? cnt : MAX_SECTORS_PER_CMD;
+      size_t done, i;
+
+      lock_acquire (&c->lock);
+      if (!dma_transfer (d, sec_no, n, p, true))
+        {
+          select_sector (d, sec_no, n);
+          issue_pio_command (c, d->multiple > 0 ? CMD_READ_MULTIPLE
+                                                : CMD_READ_SECTOR_RETRY);
+          for (done = 0; done < n; done += i)
+            {
+              sema_down (&c->completion_wait);
+              if (!wait_while_busy (d))
+                PANIC ("%s: disk read failed, sector=%"PRDSNu,
+                       d->name, sec_no + done);
+              for (i = 0; i < per_intr && done + i < n; i++)
+                input_sector (c, p + (done + i) * BLOCK_SECTOR_SIZE);
+            }
+        }
+      lock_release (&c->lock);
+
+      sec_no += n;
+      cnt -= n;
+      p += n * BLOCK_SECTOR_SIZE;
+    }
+}
+
+/* Writes CNT sectors starting at SEC_NO to disk D from BUFFER,
+   which must contain CNT * BLOCK_SECTOR_SIZE bytes.  Returns
+   after the disk has acknowledged receiving the data.  Commands
+   are split as in ide_read_multiple().
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_write_multiple (void *d_, block_sector_t sec_no, size_t cnt,
+                    const void *buffer)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  size_t per_intr = d->multiple > 0 ? (size_t) d->multiple : 1;
+  const uint8_t *p = buffer;
+
+  while (cnt > 0)
+    {
+      size_t n = cnt < MAX_SECTORS_PER_CMD ? cnt : MAX_SECTORS_PER_CMD;
+      size_t done, i;
+
+      lock_acquire (&c->lock);
+      if (!dma_transfer (d, sec_no, n, p, false))
+        {
+          select_sector (d, sec_no, n);
+          issue_pio_command (c, d->multiple > 0 ? CMD_WRITE_MULTIPLE
+                                                : CMD_WRITE_SECTOR_RETRY);
+          for (done = 0; done < n; done += i)
+            {
+              if (!wait_while_busy (d))
+                PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                       d->name, sec_no + done);
+              for (i = 0; i < per_intr && done + i < n; i++)
+                output_sector (c, p + (done + i) * BLOCK_SECTOR_SIZE);
+              sema_down (&c->completion_wait);
+            }
+        }
+      lock_release (&c->lock);
+
+      sec_no += n;
+      cnt -= n;
+      p += n * BLOCK_SECTOR_SIZE;
+    }
+}
+
+/* Writes disk D's write cache to the media with FLUSH CACHE,
+   returning once the disk reports that it is done.  Does nothing
+   if D does not support the command.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_flush (void *d_)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+
+  if (!d->flush)
+    return;
+
+  lock_acquire (&c->lock);
+  select_device_wait (d);
+  issue_pio_command (c, CMD_FLUSH_CACHE);
   sema_down (&c->completion_wait);
+  wait_while_busy (d);
+  if (inb (reg_alt_status (c)) & STA_ERR)
+    PANIC ("%s: cache flush failed", d->name);
   lock_release (&c->lock);
 }
 
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_multiple,
+    ide_write_multiple,
+    ide_flush
   };
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the number CNT of sectors to transfer to the
+   disk's sector selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= MAX_SECTORS_PER_CMD);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt == MAX_SECTORS_PER_CMD ? 0 : cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -401,6 +705,104 @@ select_sector (struct ata_disk *d, block_sector_t sec_no)
         DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0) | (sec_no >> 24));
 }
 
+/* Stores in *PHYS the physical address of the byte at P.
+   Requests reach the driver on the device's I/O thread, which
+   has no user address space, so only a kernel address has one.
+   Returns false if P is not a kernel address. */
+static bool
+buffer_phys (const void *p, uintptr_t *phys)
+{
+  if (!is_kernel_vaddr (p))
+    return false;
+  *phys = vtop (p);
+  return true;
+}
+
+/* Fills in channel C's PRD table to describe the SIZE bytes at
+   BUFFER, one region per physically contiguous run that does
+   not cross a 64 kB boundary.  The bus master then transfers
+   directly to or from BUFFER, without a bounce buffer.  Returns
+   false if some part of BUFFER cannot be described. */
+static bool
+build_prd_table (struct channel *c, const void *buffer, size_t size)
+{
+  const uint8_t *p = buffer;
+  uintptr_t end = 0;
+  size_t prd_cnt = 0;
+
+  while (size > 0)
+    {
+      size_t chunk = PGSIZE - pg_ofs (p);
+      uintptr_t phys;
+
+      if (chunk > size)
+        chunk = size;
+      if (!buffer_phys (p, &phys) || phys % 2 != 0)
+        return false;
+
+      /* Extend the previous region or start a new one.  A
+         region's byte count wraps to 0 exactly at 64 kB, which
+         is how the hardware encodes that size. */
+      if (prd_cnt > 0 && phys == end && phys % PRD_BOUNDARY != 0)
+        c->prdt[prd_cnt - 1].size += chunk;
+      else
+        {
+          if (prd_cnt >= PRD_CNT)
+            return false;
+          c->prdt[prd_cnt].addr = phys;
+          c->prdt[prd_cnt].size = chunk;
+          c->prdt[prd_cnt].flags = 0;
+          prd_cnt++;
+        }
+      end = phys + chunk;
+      p += chunk;
+      size -= chunk;
+    }
+  c->prdt[prd_cnt - 1].flags = PRD_EOT;
+  return true;
+}
+
+/* Moves CNT sectors starting at SEC_NO between disk D and
+   BUFFER by bus-master DMA: into BUFFER if TO_MEMORY is true,
+   out of it otherwise.  The CPU is free for other threads until
+   the completion interrupt.  The caller must hold D's channel
+   lock.  Returns false, having done nothing, if DMA is disabled
+   or unsupported or BUFFER is unsuitable, in which case the
+   caller should fall back to PIO. */
+static bool
+dma_transfer (struct ata_disk *d, block_sector_t sec_no, size_t cnt,
+              const void *buffer, bool to_memory)
+{
+  struct channel *c = d->channel;
+  uint8_t direction = to_memory ? BM_CMD_TO_MEMORY : 0;
+  uint8_t bm_status, status;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+
+  if (!ide_use_dma || !d->dma
+      || !build_prd_table (c, buffer, cnt * BLOCK_SECTOR_SIZE))
+    return false;
+
+  /* Load the table and direction, clear stale status, then
+     start the bus master once the disk has the command. */
+  outl (reg_bm_prdt (c), vtop (c->prdt));
+  outb (reg_bm_command (c), direction);
+  outb (reg_bm_status (c), BM_STA_ERR | BM_STA_INTR);
+  select_sector (d, sec_no, cnt);
+  issue_pio_command (c, to_memory ? CMD_READ_DMA : CMD_WRITE_DMA);
+  outb (reg_bm_command (c), direction | BM_CMD_START);
+  sema_down (&c->completion_wait);
+
+  outb (reg_bm_command (c), direction);
+  bm_status = inb (reg_bm_status (c));
+  outb (reg_bm_status (c), BM_STA_ERR | BM_STA_INTR);
+  status = inb (reg_alt_status (c));
+  if ((bm_status & BM_STA_ERR) || (status & (STA_BSY | STA_ERR)))
+    PANIC ("%s: DMA %s failed, sector=%"PRDSNu,
+           d->name, to_memory ? "read" : "write", sec_no);
+  return true;
+}
+
 /* Writes COMMAND to channel C and prepares for receiving a
    completion interrupt. */
 static void
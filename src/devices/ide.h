@@ -1,6 +1,12 @@
 #ifndef DEVICES_IDE_H
 #define DEVICES_IDE_H
 
+#include <stdbool.h>
+
+/* Use bus-master DMA when available?  (Default: true.) */
+extern bool ide_use_dma;
+
 void ide_init (void);
+bool ide_dma_available (void);
 
 #endif /* devices/ide.h */
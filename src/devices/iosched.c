@@ -0,0 +1,204 @@
+#include "devices/iosched.h"
+#include <debug.h>
+#include <string.h>
+#include "devices/timer.h"
+
+/* Most sectors that merging may combine into one request, the
+   most one ATA command can move. */
+#define MAX_MERGE_SECTORS 256
+
+/* Ticks a request may wait under the deadline scheduler before
+   it is issued ahead of the elevator order.  Reads usually have
+   a thread waiting on them; writes usually do not. */
+#define READ_EXPIRE (TIMER_FREQ / 2)
+#define WRITE_EXPIRE (TIMER_FREQ * 5)
+
+static const struct iosched noop_sched;
+static const struct iosched clook_sched;
+static const struct iosched deadline_sched;
+
+/* Policy given to newly registered block devices. */
+const struct iosched *iosched_default = &deadline_sched;
+
+/* Returns the I/O scheduler called NAME ("noop", "clook" or
+   "deadline"), or a null pointer if there is none. */
+const struct iosched *
+iosched_find (const char *name)
+{
+  static const struct iosched *scheds[] =
+    {&noop_sched, &clook_sched, &deadline_sched};
+  size_t i;
+
+  for (i = 0; i < sizeof scheds / sizeof *scheds; i++)
+    if (!strcmp (name, scheds[i]->name))
+      return scheds[i];
+  return NULL;
+}
+
+/* Initializes Q as an empty queue scheduled by SCHED. */
+void
+iosched_init (struct iosched_queue *q, const struct iosched *sched)
+{
+  q->sched = sched;
+  list_init (&q->sorted);
+  list_init (&q->fifo);
+  q->head = 0;
+}
+
+/* Returns true if Q holds no requests. */
+bool
+iosched_empty (struct iosched_queue *q)
+{
+  return list_empty (&q->sorted);
+}
+
+/* Returns the request that owns list element E in a queue's
+   sorted list. */
+static struct block_request *
+sorted_entry (struct list_elem *e)
+{
+  return list_entry (e, struct block_request, elem);
+}
+
+/* Returns true if request B can be merged onto the end of
+   request A. */
+static bool
+can_merge (const struct block_request *a, const struct block_request *b)
+{
+  return (a->write == b->write
+          && a->sector + a->run_cnt == b->sector
+          && (uint8_t *) a->buffer + a->run_cnt * BLOCK_SECTOR_SIZE
+             == (uint8_t *) b->buffer
+          && a->run_cnt + b->run_cnt <= MAX_MERGE_SECTORS);
+}
+
+/* Removes request B from Q and appends it to request A, which
+   it must continue, so that both are issued as one. */
+static void
+merge (struct block_request *a, struct block_request *b)
+{
+  struct block_request *tail;
+
+  list_remove (&b->elem);
+  list_remove (&b->fifo_elem);
+  for (tail = a; tail->merged != NULL; tail = tail->merged)
+    continue;
+  tail->merged = b;
+  a->run_cnt += b->run_cnt;
+  if (b->deadline < a->deadline)
+    a->deadline = b->deadline;
+}
+
+/* Adds request R to Q, merging it with its neighbours in
+   scheduling order where possible. */
+void
+iosched_add (struct iosched_queue *q, struct block_request *r)
+{
+  ASSERT (r->run_cnt == r->cnt && r->merged == NULL);
+
+  r->deadline = timer_ticks () + (r->write ? WRITE_EXPIRE : READ_EXPIRE);
+  list_push_back (&q->fifo, &r->fifo_elem);
+  q->sched->add (q, r);
+
+  if (list_next (&r->elem) != list_end (&q->sorted))
+    {
+      struct block_request *next = sorted_entry (list_next (&r->elem));
+      if (can_merge (r, next))
+        merge (r, next);
+    }
+  if (list_prev (&r->elem) != list_head (&q->sorted))
+    {
+      struct block_request *prev = sorted_entry (list_prev (&r->elem));
+      if (can_merge (prev, r))
+        merge (prev, r);
+    }
+}
+
+/* Removes and returns the request in nonempty Q to issue
+   next. */
+struct block_request *
+iosched_next (struct iosched_queue *q)
+{
+  struct block_request *r;
+
+  ASSERT (!iosched_empty (q));
+  r = q->sched->next (q);
+  list_remove (&r->elem);
+  list_remove (&r->fifo_elem);
+  q->head = r->sector + r->run_cnt;
+  return r;
+}
+
+/* No-op scheduler: first come, first served. */
+
+static void
+noop_add (struct iosched_queue *q, struct block_request *r)
+{
+  list_push_back (&q->sorted, &r->elem);
+}
+
+static struct block_request *
+noop_next (struct iosched_queue *q)
+{
+  return sorted_entry (list_front (&q->sorted));
+}
+
+static const struct iosched noop_sched = {"noop", noop_add, noop_next};
+
+/* C-LOOK elevator: requests are kept sorted by sector and
+   served in one sweep toward higher sectors, after which the
+   head returns to the lowest pending sector. */
+
+static bool
+sector_less (const struct list_elem *a_, const struct list_elem *b_,
+             void *aux UNUSED)
+{
+  return sorted_entry ((struct list_elem *) a_)->sector
+         < sorted_entry ((struct list_elem *) b_)->sector;
+}
+
+static void
+clook_add (struct iosched_queue *q, struct block_request *r)
+{
+  list_insert_ordered (&q->sorted, &r->elem, sector_less, NULL);
+}
+
+static struct block_request *
+clook_next (struct iosched_queue *q)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&q->sorted); e != list_end (&q->sorted);
+       e = list_next (e))
+    if (sorted_entry (e)->sector >= q->head)
+      return sorted_entry (e);
+  return sorted_entry (list_front (&q->sorted));
+}
+
+static const struct iosched clook_sched = {"clook", clook_add, clook_next};
+
+/* Deadline: C-LOOK, except that a request that has waited past
+   its deadline is issued first, so that a stream of requests
+   near the head cannot starve one far away. */
+
+static struct block_request *
+deadline_next (struct iosched_queue *q)
+{
+  int64_t now = timer_ticks ();
+  struct list_elem *e;
+
+  /* Reads and writes expire after different times, and merging
+     can move a deadline forward, so check every request. */
+  for (e = list_begin (&q->fifo); e != list_end (&q->fifo);
+       e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request,
+                                            fifo_elem);
+      if (now >= r->deadline)
+        return r;
+    }
+  return clook_next (q);
+}
+
+static const struct iosched deadline_sched =
+  {"deadline", clook_add, deadline_next};
@@ -0,0 +1,53 @@
+#ifndef DEVICES_IOSCHED_H
+#define DEVICES_IOSCHED_H
+
+#include <list.h>
+#include <stdbool.h>
+#include "devices/block.h"
+
+/* Block device I/O schedulers.
+
+   Each block device keeps its pending requests in an
+   iosched_queue.  The device's scheduler decides where new
+   requests go in the queue and which one its I/O thread issues
+   next.  Whatever the scheduler, a new request is merged with a
+   queued neighbour that continues it on disk and in memory, in
+   the same direction, so that both go out as one command.
+
+   The caller must serialize access to a queue. */
+
+struct iosched_queue;
+
+/* An I/O scheduling policy. */
+struct iosched
+  {
+    const char *name;
+
+    /* Inserts request R into Q->sorted. */
+    void (*add) (struct iosched_queue *q, struct block_request *r);
+
+    /* Returns the request in nonempty Q to issue next, without
+       removing it. */
+    struct block_request *(*next) (struct iosched_queue *q);
+  };
+
+/* Pending requests of one block device. */
+struct iosched_queue
+  {
+    const struct iosched *sched;    /* Scheduling policy. */
+    struct list sorted;         /* Requests in scheduling order. */
+    struct list fifo;           /* Requests in arrival order. */
+    block_sector_t head;        /* Sector following the last one issued. */
+  };
+
+/* Policy given to newly registered block devices. */
+extern const struct iosched *iosched_default;
+
+const struct iosched *iosched_find (const char *name);
+
+void iosched_init (struct iosched_queue *, const struct iosched *);
+bool iosched_empty (struct iosched_queue *);
+void iosched_add (struct iosched_queue *, struct block_request *);
+struct block_request *iosched_next (struct iosched_queue *);
+
+#endif /* devices/iosched.h */
@@ -0,0 +1,227 @@
+#include "devices/lapic.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Local Advanced Programmable Interrupt Controller (APIC).
+   Refer to [IA32-v3a] chapter 10 "Advanced Programmable
+   Interrupt Controller (APIC)" for details.
+
+   Each CPU has a local APIC, which accepts the interrupts meant
+   for that CPU and lets it interrupt other CPUs by sending them
+   inter-processor interrupts (IPIs).  Pintos uses the local
+   APICs only for IPIs and, on the CPUs other than the boot CPU,
+   for a periodic timer interrupt.  Devices still interrupt the
+   boot CPU alone, through the PICs, which its local APIC passes
+   through as configured by the BIOS ("virtual wire mode").
+
+   Every local APIC appears at the same physical address, and
+   each CPU sees its own there. */
+
+/* Local APIC registers, as byte offsets. */
+#define LAPIC_ID       0x020    /* Local APIC ID. */
+#define LAPIC_TPR      0x080    /* Task priority. */
+#define LAPIC_EOI      0x0b0    /* End of interrupt. */
+#define LAPIC_SVR      0x0f0    /* Spurious interrupt vector. */
+#define LAPIC_ICR_LO   0x300    /* Interrupt command, bits 0...31. */
+#define LAPIC_ICR_HI   0x310    /* Interrupt command, bits 32...63. */
+#define LAPIC_LVT_TIMER 0x320   /* Local vector table: timer. */
+#define LAPIC_LVT_LINT0 0x350   /* Local vector table: LINT0 pin. */
+#define LAPIC_LVT_LINT1 0x360   /* Local vector table: LINT1 pin. */
+#define LAPIC_TIMER_INIT 0x380  /* Timer initial count. */
+#define LAPIC_TIMER_CUR 0x390   /* Timer current count. */
+#define LAPIC_TIMER_DIV 0x3e0   /* Timer divide configuration. */
+
+/* Register bits. */
+#define SVR_ENABLE      0x100           /* APIC software enable. */
+#define LVT_MASKED      0x10000         /* Interrupt masked. */
+#define LVT_PERIODIC    0x20000         /* Timer: periodic mode. */
+#define LVT_NMI         0x400           /* Delivery mode NMI. */
+#define ICR_INIT        0x500           /* Delivery mode INIT. */
+#define ICR_STARTUP     0x600           /* Delivery mode start-up. */
+#define ICR_PENDING     0x1000          /* Delivery status: pending. */
+#define ICR_ASSERT      0x4000          /* Level assert. */
+#define TIMER_DIV_16    0x3             /* Timer counts at bus clock / 16. */
+
+/* Virtual address of the local APIC's registers.  Pintos maps
+   at most 64 MB of RAM above PHYS_BASE, so the APIC's physical
+   address, far above that, is free to map at the same virtual
+   address. */
+static volatile uint32_t *lapic;
+
+/* Local APIC timer counts per timer tick.
+   Initialized by lapic_init(). */
+static uint32_t timer_count;
+
+static intr_handler_func lapic_timer_interrupt;
+static void map_registers (uintptr_t phys_addr);
+static void calibrate (void);
+
+/* Returns the local APIC register at byte offset REG. */
+static inline uint32_t
+lapic_read (int reg)
+{
+  return lapic[reg / 4];
+}
+
+/* Sets the local APIC register at byte offset REG to VALUE. */
+static inline void
+lapic_write (int reg, uint32_t value)
+{
+  lapic[reg / 4] = value;
+}
+
+/* Maps the local APICs' registers at physical address PHYS_ADDR
+   into the kernel's address space, enables the boot CPU's local
+   APIC, and measures the APIC timer against the PIT.  Interrupts
+   must be on. */
+void
+lapic_init (uintptr_t phys_addr)
+{
+  ASSERT (intr_get_level () == INTR_ON);
+
+  map_registers (phys_addr);
+  lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_VEC_SPURIOUS);
+  calibrate ();
+
+  intr_register_ext (LAPIC_VEC_TIMER, lapic_timer_interrupt, "LAPIC Timer");
+  printf ("Local APIC at %#"PRIxPTR": %'"PRIu32" timer counts per tick.\n",
+          phys_addr, timer_count);
+}
+
+/* Enables the local APIC of a CPU other than the boot CPU and
+   starts its timer.  Its LINT0 pin, which carries the PICs'
+   interrupts on the boot CPU, is masked, so that devices
+   interrupt only the boot CPU. */
+void
+lapic_init_ap (void)
+{
+  ASSERT (lapic != NULL);
+
+  lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_VEC_SPURIOUS);
+  lapic_write (LAPIC_TPR, 0);
+  lapic_write (LAPIC_LVT_LINT0, LVT_MASKED);
+  lapic_write (LAPIC_LVT_LINT1, LVT_NMI);
+
+  lapic_write (LAPIC_TIMER_DIV, TIMER_DIV_16);
+  lapic_write (LAPIC_LVT_TIMER, LVT_PERIODIC | LAPIC_VEC_TIMER);
+  lapic_write (LAPIC_TIMER_INIT, timer_count);
+}
+
+/* Returns the current CPU's local APIC ID. */
+uint8_t
+lapic_id (void)
+{
+  return lapic_read (LAPIC_ID) >> 24;
+}
+
+/* Acknowledges the interrupt that the current CPU is handling.
+   If we don't acknowledge it, the local APIC will not deliver
+   any interrupt of equal or lower priority. */
+void
+lapic_eoi (void)
+{
+  lapic_write (LAPIC_EOI, 0);
+}
+
+/* Sends the command LOW to the CPU whose local APIC ID is
+   APIC_ID, and waits for the local APIC to accept it. */
+static void
+send_command (uint8_t apic_id, uint32_t low)
+{
+  lapic_write (LAPIC_ICR_HI, (uint32_t) apic_id << 24);
+  lapic_write (LAPIC_ICR_LO, low);
+  while (lapic_read (LAPIC_ICR_LO) & ICR_PENDING)
+    asm volatile ("pause");
+}
+
+/* Interrupts the CPU whose local APIC ID is APIC_ID with
+   interrupt vector VEC. */
+void
+lapic_send_ipi (uint8_t apic_id, uint8_t vec)
+{
+  send_command (apic_id, ICR_ASSERT | vec);
+}
+
+/* Resets the CPU whose local APIC ID is APIC_ID, leaving it
+   waiting for lapic_send_startup(). */
+void
+lapic_send_init (uint8_t apic_id)
+{
+  send_command (apic_id, ICR_INIT | ICR_ASSERT);
+}
+
+/* Starts the CPU whose local APIC ID is APIC_ID, which must be
+   waiting after lapic_send_init(), in real mode at PHYS_ADDR,
+   which must be page-aligned and below 1 MB. */
+void
+lapic_send_startup (uint8_t apic_id, uintptr_t phys_addr)
+{
+  ASSERT (phys_addr % PGSIZE == 0 && phys_addr < 0x100000);
+
+  send_command (apic_id, ICR_STARTUP | ICR_ASSERT | (phys_addr >> PGBITS));
+}
+
+/* Local APIC timer interrupt handler, on CPUs other than the
+   boot CPU, which counts time with the PIT in timer.c. */
+static void
+lapic_timer_interrupt (struct intr_frame *args UNUSED)
+{
+  thread_tick ();
+}
+
+/* Maps the page at PHYS_ADDR at the same virtual address in
+   init_page_dir, with caching disabled, as device registers
+   require.  User page directories copy init_page_dir's kernel
+   entries when created, so this must be done before any is. */
+static void
+map_registers (uintptr_t phys_addr)
+{
+  uint32_t *pde, *pt;
+
+  ASSERT (phys_addr % PGSIZE == 0);
+  ASSERT (phys_addr >= (uintptr_t) PHYS_BASE + init_ram_pages * PGSIZE);
+
+  lapic = (volatile uint32_t *) phys_addr;
+  pde = &init_page_dir[pd_no ((void *) lapic)];
+  if (*pde == 0)
+    {
+      pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+      *pde = pde_create (pt);
+    }
+  pt = pde_get_pt (*pde);
+  pt[pt_no ((void *) lapic)] = phys_addr | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+
+  /* Flush the TLB by reloading CR3. */
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)) : "memory");
+}
+
+/* Sets timer_count to the number of local APIC timer counts in
+   one timer tick. */
+static void
+calibrate (void)
+{
+  int64_t start;
+
+  lapic_write (LAPIC_TIMER_DIV, TIMER_DIV_16);
+  lapic_write (LAPIC_LVT_TIMER, LVT_MASKED);
+
+  /* Wait for a timer tick to start, then count to the next. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    barrier ();
+  lapic_write (LAPIC_TIMER_INIT, UINT32_MAX);
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    barrier ();
+  timer_count = UINT32_MAX - lapic_read (LAPIC_TIMER_CUR);
+  lapic_write (LAPIC_TIMER_INIT, 0);
+}
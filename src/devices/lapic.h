@@ -0,0 +1,29 @@
+#ifndef DEVICES_LAPIC_H
+#define DEVICES_LAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Interrupt vectors delivered by the local APIC.  They sit above
+   the PICs' and every other vector that Pintos uses, and all
+   of them are external interrupts, acknowledged by lapic_eoi(). */
+#define LAPIC_VEC_TIMER 0xf0            /* Local APIC timer. */
+#define LAPIC_VEC_RESCHEDULE 0xf1       /* Reschedule IPI. */
+#define LAPIC_VEC_SPURIOUS 0xff         /* Spurious, never acknowledged. */
+
+/* Returns true if VEC is a local APIC vector that needs an EOI. */
+static inline bool
+is_lapic_vec (uint8_t vec)
+{
+  return vec >= LAPIC_VEC_TIMER && vec < LAPIC_VEC_SPURIOUS;
+}
+
+void lapic_init (uintptr_t phys_addr);
+void lapic_init_ap (void);
+uint8_t lapic_id (void);
+void lapic_eoi (void);
+void lapic_send_ipi (uint8_t apic_id, uint8_t vec);
+void lapic_send_init (uint8_t apic_id);
+void lapic_send_startup (uint8_t apic_id, uintptr_t phys_addr);
+
+#endif /* devices/lapic.h */
@@ -0,0 +1,100 @@
+#include "devices/pci.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+#include "threads/io.h"
+
+/* Minimal access to PCI configuration space through
+   configuration mechanism #1, which every PC chipset that
+   Pintos runs on (and QEMU and Bochs) implements.  Only
+   enough is provided to locate a device by class and program
+   its command register and base addresses. */
+
+/* Configuration mechanism #1 ports. */
+#define PCI_CONFIG_ADDRESS 0xcf8        /* Address (w/o). */
+#define PCI_CONFIG_DATA 0xcfc           /* Data (r/w). */
+
+/* Bit 31 of the address register enables the access. */
+#define PCI_CONFIG_ENABLE 0x80000000
+
+/* Vendor ID read back for a function that is not present. */
+#define PCI_NO_VENDOR 0xffff
+
+/* Bit 7 of the header type marks a multi-function device. */
+#define PCI_HEADER_MULTI 0x80
+
+/* Selects register REG of the function at ADDR for the next
+   access to PCI_CONFIG_DATA. */
+static void
+select_register (struct pci_addr addr, uint8_t reg)
+{
+  ASSERT (addr.dev < 32 && addr.func < 8);
+  ASSERT (reg % 4 == 0);
+  outl (PCI_CONFIG_ADDRESS, (PCI_CONFIG_ENABLE
+                             | (uint32_t) addr.bus << 16
+                             | (uint32_t) addr.dev << 11
+                             | (uint32_t) addr.func << 8
+                             | reg));
+}
+
+/* Returns the 32-bit configuration register REG of the
+   function at ADDR. */
+uint32_t
+pci_read_config (struct pci_addr addr, uint8_t reg)
+{
+  enum intr_level old_level = intr_disable ();
+  uint32_t value;
+
+  select_register (addr, reg);
+  value = inl (PCI_CONFIG_DATA);
+  intr_set_level (old_level);
+  return value;
+}
+
+/* Sets the 32-bit configuration register REG of the function
+   at ADDR to VALUE. */
+void
+pci_write_config (struct pci_addr addr, uint8_t reg, uint32_t value)
+{
+  enum intr_level old_level = intr_disable ();
+
+  select_register (addr, reg);
+  outl (PCI_CONFIG_DATA, value);
+  intr_set_level (old_level);
+}
+
+/* Searches bus 0, where the chipset's integrated devices live,
+   for the first function with the given base CLASS and
+   SUBCLASS.  If one is found, stores its location in *ADDR and
+   returns true; otherwise returns false. */
+bool
+pci_find_class (uint8_t class, uint8_t subclass, struct pci_addr *addr)
+{
+  struct pci_addr a;
+
+  a.bus = 0;
+  for (a.dev = 0; a.dev < 32; a.dev++)
+    {
+      int func_cnt = 1;
+
+      for (a.func = 0; a.func < func_cnt; a.func++)
+        {
+          uint32_t class_reg;
+
+          if ((pci_read_config (a, PCI_REG_ID) & 0xffff) == PCI_NO_VENDOR)
+            continue;
+          if (a.func == 0
+              && (pci_read_config (a, PCI_REG_HEADER) >> 16)
+                 & PCI_HEADER_MULTI)
+            func_cnt = 8;
+
+          class_reg = pci_read_config (a, PCI_REG_CLASS);
+          if ((class_reg >> 24) == class
+              && ((class_reg >> 16) & 0xff) == subclass)
+            {
+              *addr = a;
+              return true;
+            }
+        }
+    }
+  return false;
+}
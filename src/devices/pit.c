@@ -11,8 +11,17 @@
 #define PIT_PORT_CONTROL          0x43                /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
+/* 8254 read-back command and status bits. */
+#define PIT_READ_BACK(CHANNEL) (0xc0 | (2 << (CHANNEL))) /* Latch count, status. */
+#define PIT_STATUS_OUTPUT   0x80    /* Output pin is high. */
+#define PIT_STATUS_NULL     0x40    /* New count not yet loaded. */
+
+/* Counter value loaded into each channel, with 0 meaning
+   65536. */
+static uint16_t channel_counts[3];
+
+/* Count of each channel's current one-shot countdown. */
+static unsigned oneshot_counts[3];
 
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
@@ -76,8 +85,93 @@ pit_configure_channel (int channel, int mode, int frequency)
 
   /* Configure the PIT mode and load its counters. */
   old_level = intr_disable ();
+  channel_counts[channel] = count;
   outb (PIT_PORT_CONTROL, (channel << 6) | 0x30 | (mode << 1));
   outb (PIT_PORT_COUNTER (channel), count);
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/* Makes CHANNEL count down CYCLES PIT cycles once, in mode 0
+   ("interrupt on terminal count"): the channel's output goes
+   high when the count reaches 0, which on channel 0 raises
+   interrupt line 0, and stays high until the channel is
+   configured again.  CYCLES must be between 1 and 65536.
+
+   pit_channel_period() keeps returning the period that
+   pit_configure_channel() last set. */
+void
+pit_start_oneshot (int channel, unsigned cycles)
+{
+  enum intr_level old_level;
+
+  ASSERT (channel == 0 || channel == 2);
+  ASSERT (cycles >= 1 && cycles <= 65536);
+
+  old_level = intr_disable ();
+  oneshot_counts[channel] = cycles;
+  outb (PIT_PORT_CONTROL, (channel << 6) | 0x30);
+  outb (PIT_PORT_COUNTER (channel), cycles & 0xff);
+  outb (PIT_PORT_COUNTER (channel), (cycles >> 8) & 0xff);
+  intr_set_level (old_level);
+}
+
+/* Checks on the countdown that pit_start_oneshot() started on
+   CHANNEL.  Returns true if it has reached 0.  Otherwise, stores
+   the number of PIT cycles left in *LEFT and returns false.
+
+   The read-back command latches the channel's status and count
+   at the same instant, so the two always agree. */
+bool
+pit_read_oneshot (int channel, unsigned *left)
+{
+  enum intr_level old_level;
+  uint8_t status, lo, hi;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, PIT_READ_BACK (channel));
+  status = inb (PIT_PORT_COUNTER (channel));
+  lo = inb (PIT_PORT_COUNTER (channel));
+  hi = inb (PIT_PORT_COUNTER (channel));
+  intr_set_level (old_level);
+
+  if (status & PIT_STATUS_OUTPUT)
+    return true;
+  else if (status & PIT_STATUS_NULL)
+    *left = oneshot_counts[channel];
+  else
+    *left = lo | (hi << 8);
+  return false;
+}
+
+/* Returns the number of PIT cycles in one period of CHANNEL, as
+   set by pit_configure_channel(). */
+unsigned
+pit_channel_period (int channel)
+{
+  ASSERT (channel == 0 || channel == 2);
+  return channel_counts[channel] != 0 ? channel_counts[channel] : 65536;
+}
+
+/* Returns the number of PIT cycles left before CHANNEL's
+   current period ends.  The count runs down from
+   pit_channel_period() toward 0. */
+unsigned
+pit_read_counter (int channel)
+{
+  enum intr_level old_level;
+  uint8_t lo, hi;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  /* Latch the count, then read it low byte first. */
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, channel << 6);
+  lo = inb (PIT_PORT_COUNTER (channel));
+  hi = inb (PIT_PORT_COUNTER (channel));
+  intr_set_level (old_level);
+
+  return lo | (hi << 8);
+}
@@ -1,8 +1,16 @@
 #ifndef DEVICES_PIT_H
 #define DEVICES_PIT_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+/* PIT cycles per second. */
+#define PIT_HZ 1193180
+
 void pit_configure_channel (int channel, int mode, int frequency);
+unsigned pit_channel_period (int channel);
+unsigned pit_read_counter (int channel);
+void pit_start_oneshot (int channel, unsigned cycles);
+bool pit_read_oneshot (int channel, unsigned *left);
 
 #endif /* devices/pit.h */
@@ -0,0 +1,253 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "devices/block.h"
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* RAM disks: block devices backed by memory, with an optional
+   model of disk latency.  They take the disk's mechanics out of
+   file system measurements (no latency), or replace QEMU's
+   variable ones by a known, repeatable cost (fixed latency), or
+   make seeks cost what they would on a real drive (HDD model).
+
+   A RAM disk is requested on the kernel command line with
+   -ramdisk=ROLE:MB[:LATENCY], e.g. "-ramdisk=filesys:16:hdd".
+   It is registered with ROLE as its type ahead of the IDE disks,
+   so it is the one chosen for ROLE unless another device is
+   named explicitly.  Its contents start out zeroed, so a file
+   system RAM disk must be formatted with -f. */
+
+/* Most RAM disks that may be configured. */
+#define RAMDISK_CNT 4
+
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* HDD model geometry and timing, roughly a 7,200 RPM drive. */
+#define HDD_SECTORS_PER_TRACK 128       /* Sectors in one track. */
+#define HDD_REVOLUTION_US 8333          /* One revolution. */
+#define HDD_TRACK_SEEK_US 800           /* Seek to an adjacent track. */
+#define HDD_FULL_SEEK_US 16000          /* Seek across whole disk. */
+
+/* How a RAM disk models latency. */
+enum ramdisk_latency
+  {
+    LATENCY_NONE,               /* Memory speed. */
+    LATENCY_FIXED,              /* Constant time per request. */
+    LATENCY_HDD                 /* Seek and rotation. */
+  };
+
+/* A RAM disk. */
+struct ramdisk
+  {
+    char name[8];               /* Name, e.g. "ram0". */
+    enum block_type role;       /* Role it is registered for. */
+    block_sector_t size;        /* Size in sectors. */
+    uint8_t **pages;            /* One page per SECTORS_PER_PAGE sectors. */
+
+    enum ramdisk_latency latency;   /* Latency model. */
+    int64_t fixed_us;           /* Per-request time for LATENCY_FIXED. */
+    unsigned head_track;        /* Track under the head, for LATENCY_HDD. */
+  };
+
+static struct ramdisk ramdisks[RAMDISK_CNT];
+static size_t ramdisk_cnt;
+
+static struct block_operations ramdisk_operations;
+
+/* Records a RAM disk described by SPEC, the value of a -ramdisk
+   option, to be created by ramdisk_init().  Panics if SPEC is
+   malformed.  Called before memory allocation is available. */
+void
+ramdisk_configure (char *spec)
+{
+  struct ramdisk *rd;
+  char *role, *mb, *latency, *save_ptr;
+  int i;
+
+  if (ramdisk_cnt >= RAMDISK_CNT)
+    PANIC ("too many RAM disks (at most %d)", RAMDISK_CNT);
+  rd = &ramdisks[ramdisk_cnt];
+
+  role = spec != NULL ? strtok_r (spec, ":", &save_ptr) : NULL;
+  mb = role != NULL ? strtok_r (NULL, ":", &save_ptr) : NULL;
+  latency = mb != NULL ? strtok_r (NULL, "", &save_ptr) : NULL;
+  if (mb == NULL || atoi (mb) <= 0)
+    PANIC ("-ramdisk requires ROLE:MB[:LATENCY]");
+
+  rd->role = BLOCK_ROLE_CNT;
+  for (i = BLOCK_FILESYS; i < BLOCK_ROLE_CNT; i++)
+    if (!strcmp (role, block_type_name (i)))
+      rd->role = i;
+  if (rd->role == BLOCK_ROLE_CNT)
+    PANIC ("unknown RAM disk role `%s'", role);
+  rd->size = atoi (mb) * (1024 * 1024 / BLOCK_SECTOR_SIZE);
+
+  rd->latency = LATENCY_NONE;
+  rd->fixed_us = 0;
+  if (latency == NULL || !strcmp (latency, "none"))
+    ;
+  else if (!strcmp (latency, "hdd"))
+    rd->latency = LATENCY_HDD;
+  else if (!memcmp (latency, "fixed=", 6) && atoi (latency + 6) > 0)
+    {
+      rd->latency = LATENCY_FIXED;
+      rd->fixed_us = atoi (latency + 6);
+    }
+  else
+    PANIC ("unknown RAM disk latency `%s' "
+           "(use none, fixed=US, or hdd)", latency);
+
+  snprintf (rd->name, sizeof rd->name, "ram%zu", ramdisk_cnt);
+  ramdisk_cnt++;
+}
+
+/* Allocates and registers the RAM disks requested with
+   ramdisk_configure(). */
+void
+ramdisk_init (void)
+{
+  size_t i;
+
+  for (i = 0; i < ramdisk_cnt; i++)
+    {
+      struct ramdisk *rd = &ramdisks[i];
+      size_t page_cnt = DIV_ROUND_UP (rd->size, SECTORS_PER_PAGE);
+      char extra_info[64];
+      size_t j;
+
+      /* Memory comes from the user pool when possible, since the
+         kernel pool is small and needed for threads and malloc. */
+      rd->pages = calloc (page_cnt, sizeof *rd->pages);
+      if (rd->pages == NULL)
+        PANIC ("%s: out of memory", rd->name);
+      for (j = 0; j < page_cnt; j++)
+        {
+          rd->pages[j] = palloc_get_page (PAL_USER | PAL_ZERO);
+          if (rd->pages[j] == NULL)
+            rd->pages[j] = palloc_get_page (PAL_ZERO);
+          if (rd->pages[j] == NULL)
+            PANIC ("%s: out of memory after %zu kB (try more RAM with -m)",
+                   rd->name, j * PGSIZE / 1024);
+        }
+      rd->head_track = 0;
+
+      if (rd->latency == LATENCY_FIXED)
+        snprintf (extra_info, sizeof extra_info,
+                  "RAM disk, %lld us per request", rd->fixed_us);
+      else
+        snprintf (extra_info, sizeof extra_info, "RAM disk, %s latency",
+                  rd->latency == LATENCY_HDD ? "HDD" : "no");
+      block_register (rd->name, rd->role, extra_info, rd->size,
+                      &ramdisk_operations, rd);
+    }
+}
+
+/* Returns the number of microseconds a drive would take to move
+   CNT sectors starting at SECTOR, following RD's latency model,
+   and updates the model's state. */
+static int64_t
+model_latency (struct ramdisk *rd, block_sector_t sector, size_t cnt)
+{
+  unsigned track, distance, tracks, target, angle;
+  int64_t seek_us, now;
+
+  switch (rd->latency)
+    {
+    case LATENCY_NONE:
+      return 0;
+
+    case LATENCY_FIXED:
+      return rd->fixed_us;
+
+    case LATENCY_HDD:
+      /* Seek time grows linearly with distance, after a fixed
+         settle time for any track change. */
+      track = sector / HDD_SECTORS_PER_TRACK;
+      tracks = DIV_ROUND_UP (rd->size, HDD_SECTORS_PER_TRACK);
+      distance = track > rd->head_track ? track - rd->head_track
+                                        : rd->head_track - track;
+      seek_us = (distance == 0 ? 0
+                 : HDD_TRACK_SEEK_US
+                   + ((int64_t) (HDD_FULL_SEEK_US - HDD_TRACK_SEEK_US)
+                      * distance / tracks));
+
+      /* The platter keeps spinning in real time, so once the
+         seek finishes wait for SECTOR to come around. */
+      now = timer_usec () + seek_us;
+      angle = now % HDD_REVOLUTION_US;
+      target = ((sector % HDD_SECTORS_PER_TRACK) * HDD_REVOLUTION_US
+                / HDD_SECTORS_PER_TRACK);
+
+      rd->head_track = (sector + cnt - 1) / HDD_SECTORS_PER_TRACK;
+      return (seek_us
+              + (target + HDD_REVOLUTION_US - angle) % HDD_REVOLUTION_US
+              + (int64_t) cnt * HDD_REVOLUTION_US / HDD_SECTORS_PER_TRACK);
+    }
+  NOT_REACHED ();
+}
+
+/* Moves CNT sectors starting at SECTOR between RAM disk RD_ and
+   BUFFER, into BUFFER if TO_BUFFER is true and out of it
+   otherwise, after the delay RD_'s latency model calls for. */
+static void
+ramdisk_transfer (void *rd_, block_sector_t sector, size_t cnt,
+                  void *buffer, bool to_buffer)
+{
+  struct ramdisk *rd = rd_;
+  uint8_t *p = buffer;
+  int64_t us = model_latency (rd, sector, cnt);
+
+  if (us > 0)
+    timer_usleep (us);
+
+  for (; cnt > 0; cnt--, sector++, p += BLOCK_SECTOR_SIZE)
+    {
+      uint8_t *s = (rd->pages[sector / SECTORS_PER_PAGE]
+                    + sector % SECTORS_PER_PAGE * BLOCK_SECTOR_SIZE);
+      if (to_buffer)
+        memcpy (p, s, BLOCK_SECTOR_SIZE);
+      else
+        memcpy (s, p, BLOCK_SECTOR_SIZE);
+    }
+}
+
+static void
+ramdisk_read (void *rd, block_sector_t sector, void *buffer)
+{
+  ramdisk_transfer (rd, sector, 1, buffer, true);
+}
+
+static void
+ramdisk_write (void *rd, block_sector_t sector, const void *buffer)
+{
+  ramdisk_transfer (rd, sector, 1, (void *) buffer, false);
+}
+
+static void
+ramdisk_read_multiple (void *rd, block_sector_t sector, size_t cnt,
+                       void *buffer)
+{
+  ramdisk_transfer (rd, sector, cnt, buffer, true);
+}
+
+static void
+ramdisk_write_multiple (void *rd, block_sector_t sector, size_t cnt,
+                        const void *buffer)
+{
+  ramdisk_transfer (rd, sector, cnt, (void *) buffer, false);
+}
+
+static struct block_operations ramdisk_operations =
+  {
+    ramdisk_read,
+    ramdisk_write,
+    ramdisk_read_multiple,
+    ramdisk_write_multiple,
+    NULL                        /* Memory needs no flush. */
+  };
@@ -0,0 +1,216 @@
+#include "devices/stripe.h"
+#include <debug.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/synch.h"
+
+/* A striped (RAID-0) block device, "md0", layered over two or
+   more other block devices, its members.  Its sectors are dealt
+   out to the members round-robin in chunks, so that a large
+   transfer touches every member and, when the members sit on
+   different IDE channels, they all work on it at once.
+
+   Requested on the kernel command line with
+   -stripe=DEV,DEV[,DEV...][:KB], where KB is the chunk size
+   (default 64).  The striped device becomes the file system
+   device unless -filesys names another.  Nothing about the
+   layout is stored on the members, so the same members and
+   chunk size must be given every time. */
+
+/* Most member devices. */
+#define STRIPE_MAX_MEMBERS 4
+
+/* Default chunk size in sectors (64 kB). */
+#define DEFAULT_CHUNK_SECTORS 128
+
+/* Most member requests one transfer keeps in flight at once. */
+#define MAX_INFLIGHT 8
+
+/* The striped device. */
+struct stripe
+  {
+    struct block *members[STRIPE_MAX_MEMBERS];
+    size_t member_cnt;
+    block_sector_t chunk_sectors;   /* Sectors per chunk. */
+  };
+
+static struct stripe stripe;
+
+/* Command-line configuration, saved for stripe_init(). */
+static char *member_names;
+static int chunk_kb;
+
+static struct block_operations stripe_operations;
+
+/* Records the striped device described by SPEC, the value of a
+   -stripe option, to be created by stripe_init(). */
+void
+stripe_configure (char *spec)
+{
+  char *save_ptr;
+
+  if (spec == NULL)
+    PANIC ("-stripe requires DEV,DEV[,DEV...][:KB]");
+  member_names = strtok_r (spec, ":", &save_ptr);
+  spec = strtok_r (NULL, "", &save_ptr);
+  chunk_kb = spec != NULL ? atoi (spec) : 0;
+  if (spec != NULL && chunk_kb <= 0)
+    PANIC ("bad stripe chunk size `%s'", spec);
+}
+
+/* Creates and registers the striped device configured with
+   stripe_configure(), once its members have been registered.
+   Returns the new device, or a null pointer if none was
+   configured. */
+struct block *
+stripe_init (void)
+{
+  block_sector_t member_size = 0;
+  char extra_info[128];
+  char *name, *save_ptr;
+  size_t ofs;
+  size_t i;
+
+  if (member_names == NULL)
+    return NULL;
+
+  stripe.chunk_sectors = (chunk_kb > 0
+                          ? chunk_kb * (1024 / BLOCK_SECTOR_SIZE)
+                          : DEFAULT_CHUNK_SECTORS);
+  ofs = snprintf (extra_info, sizeof extra_info, "RAID-0 of");
+  for (name = strtok_r (member_names, ",", &save_ptr); name != NULL;
+       name = strtok_r (NULL, ",", &save_ptr))
+    {
+      struct block *member = block_get_by_name (name);
+      if (member == NULL)
+        PANIC ("stripe: no such block device \"%s\"", name);
+      if (stripe.member_cnt >= STRIPE_MAX_MEMBERS)
+        PANIC ("stripe: at most %d members", STRIPE_MAX_MEMBERS);
+      for (i = 0; i < stripe.member_cnt; i++)
+        if (stripe.members[i] == member)
+          PANIC ("stripe: %s named twice", name);
+
+      if (stripe.member_cnt == 0 || block_size (member) < member_size)
+        member_size = block_size (member);
+      stripe.members[stripe.member_cnt++] = member;
+      if (ofs < sizeof extra_info)
+        ofs += snprintf (extra_info + ofs, sizeof extra_info - ofs, " %s",
+                         name);
+    }
+  if (stripe.member_cnt < 2)
+    PANIC ("stripe: need at least 2 members");
+  if (ofs < sizeof extra_info)
+    snprintf (extra_info + ofs, sizeof extra_info - ofs,
+              ", %"PRDSNu" kB chunks",
+              stripe.chunk_sectors * BLOCK_SECTOR_SIZE / 1024);
+
+  /* Use the same whole number of chunks from every member, as
+     many as the smallest one holds. */
+  member_size -= member_size % stripe.chunk_sectors;
+  if (member_size == 0)
+    PANIC ("stripe: members smaller than one chunk");
+
+  return block_register ("md0", BLOCK_FILESYS, extra_info,
+                         member_size * stripe.member_cnt,
+                         &stripe_operations, &stripe);
+}
+
+/* Moves CNT sectors starting at SECTOR between striped device
+   S_ and BUFFER, writing if WRITE is true.  The transfer is
+   split at chunk boundaries into requests to the members, which
+   are all queued before waiting for any, up to MAX_INFLIGHT at
+   a time. */
+static void
+stripe_transfer (void *s_, block_sector_t sector, size_t cnt,
+                 void *buffer, bool write)
+{
+  struct stripe *s = s_;
+  struct block_request reqs[MAX_INFLIGHT];
+  struct semaphore done;
+  uint8_t *p = buffer;
+
+  sema_init (&done, 0);
+  while (cnt > 0)
+    {
+      size_t req_cnt, i;
+
+      for (req_cnt = 0; req_cnt < MAX_INFLIGHT && cnt > 0; req_cnt++)
+        {
+          block_sector_t chunk = sector / s->chunk_sectors;
+          block_sector_t chunk_ofs = sector % s->chunk_sectors;
+          struct block *member = s->members[chunk % s->member_cnt];
+          block_sector_t member_sector
+            = chunk / s->member_cnt * s->chunk_sectors + chunk_ofs;
+          size_t n = s->chunk_sectors - chunk_ofs;
+
+          if (n > cnt)
+            n = cnt;
+          block_request_init (&reqs[req_cnt], write, member_sector, n, p,
+                              block_request_sema_up, &done);
+          block_submit (member, &reqs[req_cnt]);
+
+          sector += n;
+          cnt -= n;
+          p += n * BLOCK_SECTOR_SIZE;
+        }
+      for (i = 0; i < req_cnt; i++)
+        sema_down (&done);
+    }
+}
+
+static void
+stripe_read (void *s, block_sector_t sector, void *buffer)
+{
+  stripe_transfer (s, sector, 1, buffer, false);
+}
+
+static void
+stripe_write (void *s, block_sector_t sector, const void *buffer)
+{
+  stripe_transfer (s, sector, 1, (void *) buffer, true);
+}
+
+static void
+stripe_read_multiple (void *s, block_sector_t sector, size_t cnt,
+                      void *buffer)
+{
+  stripe_transfer (s, sector, cnt, buffer, false);
+}
+
+static void
+stripe_write_multiple (void *s, block_sector_t sector, size_t cnt,
+                       const void *buffer)
+{
+  stripe_transfer (s, sector, cnt, (void *) buffer, true);
+}
+
+/* Flushes the write caches of all of striped device S_'s
+   members, in parallel. */
+static void
+stripe_flush (void *s_)
+{
+  struct stripe *s = s_;
+  struct block_request reqs[STRIPE_MAX_MEMBERS];
+  struct semaphore done;
+  size_t i;
+
+  sema_init (&done, 0);
+  for (i = 0; i < s->member_cnt; i++)
+    {
+      block_flush_request_init (&reqs[i], block_request_sema_up, &done);
+      block_submit (s->members[i], &reqs[i]);
+    }
+  for (i = 0; i < s->member_cnt; i++)
+    sema_down (&done);
+}
+
+static struct block_operations stripe_operations =
+  {
+    stripe_read,
+    stripe_write,
+    stripe_read_multiple,
+    stripe_write_multiple,
+    stripe_flush
+  };
@@ -0,0 +1,9 @@
+#ifndef DEVICES_STRIPE_H
+#define DEVICES_STRIPE_H
+
+struct block;
+
+void stripe_configure (char *spec);
+struct block *stripe_init (void);
+
+#endif /* devices/stripe.h */
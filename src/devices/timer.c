@@ -4,6 +4,7 @@
 #include <round.h>
 #include <stdio.h>
 #include "devices/pit.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
@@ -24,17 +25,76 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Hierarchical timer wheel of pending alarms.
+
+   Level 0 has one slot per tick for the next WHEEL_SIZE ticks.
+   Each slot of level L > 0 covers WHEEL_SIZE**L ticks, and when
+   the wheel's time reaches the start of such a slot, the alarms
+   in it are "cascaded" into the finer levels below.  An alarm is
+   thus moved at most WHEEL_LEVELS - 1 times before it fires.
+   Alarms more than WHEEL_SPAN ticks away wait in the last level
+   and are placed again when they cascade. */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 5
+#define WHEEL_SPAN (1LL << (WHEEL_BITS * WHEEL_LEVELS))
+static struct list wheel[WHEEL_LEVELS][WHEEL_SIZE];
+
+/* Next tick whose alarms the wheel will fire. */
+static int64_t wheel_time;
+
+/* Number of alarms fired. */
+static long long alarm_cnt;
+
+/* Tickless idle.
+
+   If true, the idle thread calls timer_idle_enter() before it
+   halts the CPU, which, when no alarm is due at the next tick,
+   switches the PIT from its periodic interrupt to a single one
+   at the tick of the next alarm.  The first interrupt of any
+   kind afterward calls timer_idle_exit(), which catches up on
+   the ticks that went by, each of which still counts and runs
+   thread_tick(), and sets the PIT to interrupt at the next tick
+   boundary, after which it runs periodically again.  So the
+   tick count and time slices come out the same as with the
+   periodic interrupt.
+
+   The PIT counts at most 65536 cycles, about 55 ms, at once, so
+   an idle CPU still takes an interrupt that often.  Only one CPU
+   can use the PIT, so with several CPUs, all keep ticking.
+   Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+static bool oneshot;            /* PIT counting down to an interrupt? */
+static int64_t oneshot_ticks;   /* Tick boundaries before it expires. */
+static unsigned oneshot_first;  /* PIT cycles to the first of them. */
+static unsigned oneshot_cycles; /* PIT cycles it counts in total. */
+static bool oneshot_expired;    /* Ticks counted, interrupt not yet taken? */
+static long long idle_ticks_skipped; /* Ticks without an interrupt. */
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
+static void wheel_insert (struct alarm *);
+static bool wheel_slot_busy (int64_t tick);
+static void run_alarms (void);
+static void tick (void);
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
 void
 timer_init (void) 
 {
+  int level, slot;
+
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    for (slot = 0; slot < WHEEL_SIZE; slot++)
+      list_init (&wheel[level][slot]);
+  wheel_time = 1;
+
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
@@ -76,6 +136,36 @@ timer_ticks (void)
   return t;
 }
 
+/* Returns the number of microseconds since the OS booted.
+   Reads the PIT's counter to resolve time within the current
+   tick, so the result is far finer than timer_ticks(). */
+int64_t
+timer_usec (void)
+{
+  static int64_t last;
+  enum intr_level old_level = intr_disable ();
+  unsigned period = pit_channel_period (0);
+  unsigned left = pit_read_counter (0);
+  int64_t us;
+
+  /* The one-shot countdown that timer_idle_exit() starts ends on
+     a tick boundary, like a period, but once it reaches 0 it
+     wraps around instead of starting over. */
+  if (left > period)
+    left = 0;
+
+  us = (ticks * 1000000 / TIMER_FREQ
+        + (int64_t) (period - left) * 1000000 / PIT_HZ);
+
+  /* The counter may have started a new period whose interrupt
+     we have not yet taken, which would make time go backward. */
+  if (us < last)
+    us = last;
+  last = us;
+  intr_set_level (old_level);
+  return us;
+}
+
 /* Returns the number of timer ticks elapsed since THEN, which
    should be a value once returned by timer_ticks(). */
 int64_t
@@ -84,16 +174,41 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
+/* Alarm function that wakes up T_, a sleeping thread. */
+static void
+wake_thread (void *t_)
+{
+  thread_unblock (t_);
+}
+
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
    be turned on. */
 void
 timer_sleep (int64_t ticks) 
 {
-  int64_t start = timer_ticks ();
+  if (ticks > 0)
+    timer_sleep_until (timer_ticks () + ticks);
+}
+
+/* Sleeps until timer tick WHEN, returning at once if it has
+   passed.  Interrupts must be turned on.  The thread is blocked,
+   off the ready list, until an alarm wakes it. */
+void
+timer_sleep_until (int64_t when)
+{
+  struct alarm alarm;
+  enum intr_level old_level;
 
   ASSERT (intr_get_level () == INTR_ON);
-  while (timer_elapsed (start) < ticks) 
-    thread_yield ();
+
+  alarm_init (&alarm, wake_thread, thread_current ());
+  old_level = intr_disable ();
+  if (when > ticks)
+    {
+      alarm_set (&alarm, when);
+      thread_block ();
+    }
+  intr_set_level (old_level);
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -163,17 +278,253 @@ timer_ndelay (int64_t ns)
 void
 timer_print_stats (void) 
 {
-  printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  printf ("Timer: %"PRId64" ticks, %lld alarms\n", timer_ticks (), alarm_cnt);
+  if (timer_tickless)
+    printf ("Timer: %lld idle ticks without an interrupt\n",
+            idle_ticks_skipped);
+}
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  If tickless idle is on and the next alarm is
+   more than a tick away, sets the PIT to interrupt only at the
+   tick of that alarm, or as near to it as the PIT can count. */
+void
+timer_idle_enter (void)
+{
+  unsigned period = pit_channel_period (0);
+  unsigned left;
+  int64_t n, max_n;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless || oneshot || oneshot_expired || smp_active)
+    return;
+
+  /* Read the cycles left to the next tick, then make sure that
+     tick's interrupt is not already waiting, or we would count
+     the ticks from the wrong boundary. */
+  left = pit_read_counter (0);
+  if (intr_ext_pending (0x20))
+    return;
+
+  /* Interrupt at the Nth tick boundary from now, where N is the
+     first with an alarm due, or a cascade of the timer wheel. */
+  max_n = 1 + (65536 - left) / period;
+  for (n = 1; n < max_n; n++)
+    if (wheel_slot_busy (wheel_time + n - 1))
+      break;
+  if (n <= 1)
+    return;
+
+  oneshot = true;
+  oneshot_ticks = n;
+  oneshot_first = left;
+  oneshot_cycles = left + (n - 1) * period;
+  pit_start_oneshot (0, oneshot_cycles);
+}
+
+/* Called at the start of every external interrupt from the PICs.
+   If the PIT is counting down after timer_idle_enter(), counts
+   the ticks that have gone by since, and returns the PIT to
+   periodic interrupts from the next tick boundary on. */
+void
+timer_idle_exit (void)
+{
+  unsigned period = pit_channel_period (0);
+  unsigned left, elapsed;
+  int64_t n;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!oneshot)
+    return;
+  oneshot = false;
+
+  if (pit_read_oneshot (0, &left))
+    {
+      /* Expired right on a tick boundary.  Start the periodic
+         interrupt over from there.  The one-shot's own
+         interrupt is due, if this is not it already. */
+      n = oneshot_ticks;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+      oneshot_expired = true;
+      idle_ticks_skipped += n - 1;
+    }
+  else
+    {
+      /* Woken early.  Count the boundaries passed, then count
+         down to the next one, which timer_usec() relies on. */
+      elapsed = oneshot_cycles - left;
+      n = elapsed < oneshot_first ? 0 : 1 + (elapsed - oneshot_first) / period;
+      oneshot = true;
+      oneshot_ticks = 1;
+      oneshot_first = oneshot_cycles = oneshot_first + n * period - elapsed;
+      pit_start_oneshot (0, oneshot_cycles);
+      idle_ticks_skipped += n;
+    }
+
+  while (n-- > 0)
+    tick ();
+}
+
+/* Initializes ALARM to call FUNC with AUX when it fires.  The
+   alarm is not set. */
+void
+alarm_init (struct alarm *alarm, alarm_func *func, void *aux)
+{
+  ASSERT (func != NULL);
+
+  alarm->pending = false;
+  alarm->func = func;
+  alarm->aux = aux;
+}
+
+/* Sets ALARM to fire at timer tick WHEN, or at the next tick if
+   WHEN has passed.  If ALARM is already set, it is moved. */
+void
+alarm_set (struct alarm *alarm, int64_t when)
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (alarm->pending)
+    list_remove (&alarm->elem);
+  alarm->when = when;
+  alarm->pending = true;
+  wheel_insert (alarm);
+  intr_set_level (old_level);
+}
+
+/* Cancels ALARM.  Returns true if it was set, false if it had
+   already fired or was never set. */
+bool
+alarm_cancel (struct alarm *alarm)
+{
+  enum intr_level old_level = intr_disable ();
+  bool was_pending = alarm->pending;
+
+  if (was_pending)
+    {
+      list_remove (&alarm->elem);
+      alarm->pending = false;
+    }
+  intr_set_level (old_level);
+  return was_pending;
+}
+
+/* Returns true if ALARM is set and has not yet fired. */
+bool
+alarm_pending (const struct alarm *alarm)
+{
+  return alarm->pending;
+}
+
+/* Puts ALARM in the timer wheel slot that covers its tick, at
+   the finest level that reaches that far.
+   Interrupts must be off. */
+static void
+wheel_insert (struct alarm *alarm)
+{
+  int64_t when = alarm->when;
+  int64_t delta;
+  int level;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (when < wheel_time)
+    when = wheel_time;
+  delta = when - wheel_time;
+  if (delta >= WHEEL_SPAN)
+    {
+      delta = WHEEL_SPAN - 1;
+      when = wheel_time + delta;
+    }
+
+  for (level = 0; level < WHEEL_LEVELS - 1; level++)
+    if (delta < 1LL << (WHEEL_BITS * (level + 1)))
+      break;
+  list_push_back (&wheel[level][(when >> (WHEEL_BITS * level)) & WHEEL_MASK],
+                  &alarm->elem);
+}
+
+/* Returns true if an alarm may be due at TICK, which must not be
+   more than WHEEL_SIZE ticks after wheel_time: if TICK's level-0
+   slot holds an alarm, or TICK cascades a coarser level.
+   Interrupts must be off. */
+static bool
+wheel_slot_busy (int64_t tick)
+{
+  ASSERT (tick >= wheel_time && tick < wheel_time + WHEEL_SIZE);
+
+  return (tick & WHEEL_MASK) == 0 || !list_empty (&wheel[0][tick & WHEEL_MASK]);
+}
+
+/* Fires the alarms due at every tick up to the current one. */
+static void
+run_alarms (void)
+{
+  while (wheel_time <= ticks)
+    {
+      int slot = wheel_time & WHEEL_MASK;
+      struct list due;
+      int level;
+
+      /* At the start of a level-0 round, cascade the next slot of
+         each coarser level whose own round starts now. */
+      for (level = 1; slot == 0 && level < WHEEL_LEVELS; level++)
+        {
+          struct list *l = &wheel[level][(wheel_time >> (WHEEL_BITS * level))
+                                         & WHEEL_MASK];
+          struct list cascade;
+
+          list_init (&cascade);
+          list_splice (list_end (&cascade), list_begin (l), list_end (l));
+          while (!list_empty (&cascade))
+            wheel_insert (list_entry (list_pop_front (&cascade),
+                                      struct alarm, elem));
+          if (((wheel_time >> (WHEEL_BITS * level)) & WHEEL_MASK) != 0)
+            break;
+        }
+
+      /* Advance first, so that an alarm set again for a time that
+         has passed goes in the next slot, not this one. */
+      list_init (&due);
+      list_splice (list_end (&due), list_begin (&wheel[0][slot]),
+                   list_end (&wheel[0][slot]));
+      wheel_time++;
+
+      while (!list_empty (&due))
+        {
+          struct alarm *alarm = list_entry (list_pop_front (&due),
+                                            struct alarm, elem);
+          alarm->pending = false;
+          alarm_cnt++;
+          alarm->func (alarm->aux);
+        }
+    }
 }
 
-/* Timer interrupt handler. */
+/* Counts a timer tick. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+tick (void)
 {
   ticks++;
+  run_alarms ();
   thread_tick ();
 }
 
+/* Timer interrupt handler. */
+static void
+timer_interrupt (struct intr_frame *args UNUSED)
+{
+  /* After tickless idle, timer_idle_exit() has counted the ticks
+     up to this interrupt already, or, if the interrupt is stale,
+     restarted the countdown to the next tick. */
+  if (oneshot_expired)
+    oneshot_expired = false;
+  else if (!oneshot)
+    tick ();
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
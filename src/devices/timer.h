@@ -1,7 +1,9 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -12,9 +14,11 @@ void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_usec (void);
 
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep (int64_t ticks);
+void timer_sleep_until (int64_t when);
 void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
@@ -26,4 +30,33 @@ void timer_ndelay (int64_t nanoseconds);
 
 void timer_print_stats (void);
 
+/* Tickless idle. */
+extern bool timer_tickless;
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
+/* Alarms: calls to a function at a given timer tick.
+
+   The function runs in the timer interrupt handler, with
+   interrupts off, so it must not sleep; it may unblock threads,
+   up semaphores, and set alarms, including the one that fired.
+   An alarm is kept in a hierarchical timer wheel, so setting,
+   cancelling, and expiring one each take constant time however
+   many alarms are pending. */
+typedef void alarm_func (void *aux);
+
+struct alarm
+  {
+    struct list_elem elem;      /* Element in a timer wheel slot. */
+    int64_t when;               /* Timer tick at which to fire. */
+    bool pending;               /* Set and not yet fired? */
+    alarm_func *func;           /* Function to call. */
+    void *aux;                  /* Passed to FUNC. */
+  };
+
+void alarm_init (struct alarm *, alarm_func *, void *aux);
+void alarm_set (struct alarm *, int64_t when);
+bool alarm_cancel (struct alarm *);
+bool alarm_pending (const struct alarm *);
+
 #endif /* devices/timer.h */
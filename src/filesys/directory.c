@@ -2,8 +2,10 @@
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
+#include <round.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
 #include "filesys/inode.h"
 
@@ -14,21 +16,63 @@ struct dir
     off_t pos;                          /* Current position. */
   };
 
-/* A single directory entry. */
+/* A single directory entry of a DIR_FORMAT_FIXED directory. */
 struct dir_entry 
   {
     block_sector_t inode_sector;        /* Sector number of header. */
-    char name[NAME_MAX + 1];            /* Null terminated file name. */
+    char name[DIR_FIXED_NAME_MAX + 1];  /* Null terminated file name. */
     bool in_use;                        /* In use or free? */
   };
 
+/* A single directory record of a DIR_FORMAT_COMPACT directory.
+
+   Records are packed back to back and never straddle a sector
+   boundary.  REC_LEN counts the record's own bytes plus any slack
+   before the next record, so the records of one sector always
+   add up to exactly BLOCK_SECTOR_SIZE bytes.  A record whose
+   INODE_SECTOR is 0 (the free map's inode, never a directory
+   entry) is free. */
+struct dir_record
+  {
+    block_sector_t inode_sector;        /* Sector number of header. */
+    uint16_t rec_len;                   /* Bytes up to the next record. */
+    uint8_t name_len;                   /* Length of NAME. */
+    uint8_t unused;                     /* Padding. */
+    char name[];                        /* File name, not null terminated. */
+  };
+
+/* Number of entries past the one it returns whose inodes
+   dir_readdir() keeps queued for read-ahead, so that a caller
+   that opens each entry in turn (ls -l, recursive removal) finds
+   the inode sector already in the buffer cache. */
+#define STAT_AHEAD_ENTRIES 8
+
+/* Size of the fixed part of a struct dir_record. */
+#define DIR_RECORD_HDR (offsetof (struct dir_record, name))
+
+/* Returns the number of bytes a record for a NAME_LEN-byte name
+   needs.  Records stay word aligned. */
+static inline size_t
+record_size (size_t name_len)
+{
+  return ROUND_UP (DIR_RECORD_HDR + name_len, sizeof (block_sector_t));
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
-   given SECTOR.  Returns true if successful, false on failure. */
+   given SECTOR, laid out according to FORMAT.  Returns true if
+   successful, false on failure.
+
+   A compact directory always starts out empty and grows one
+   sector at a time in dir_add(), because a zero-filled sector is
+   not a valid run of records. */
 bool
-dir_create (block_sector_t sector, size_t entry_cnt)
+dir_create (block_sector_t sector, size_t entry_cnt, enum dir_format format)
 {
   // entry_cnt 갯수만큼 SECTOR에 directory를 만듬
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry), 1);
+  if (format == DIR_FORMAT_COMPACT)
+    return inode_create_dir (sector, 0, format);
+  return inode_create_dir (sector, entry_cnt * sizeof (struct dir_entry),
+                           format);
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -86,29 +130,281 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
+/* Returns the entry format of DIR.  The format lives in the
+   inode rather than in struct dir, because the readdir system
+   call hands us a struct file in place of a struct dir. */
+enum dir_format
+dir_get_format (struct dir *dir)
+{
+  return inode_dir_format (dir->inode);
+}
+
+/* Returns DIR's position, for a later dir_seek(), as dir_readdir()
+   has left it. */
+off_t
+dir_tell (struct dir *dir)
+{
+  return dir->pos;
+}
+
+/* Returns DIR to position POS, which dir_tell() returned, so that
+   dir_readdir() reads the same entries again. */
+void
+dir_seek (struct dir *dir, off_t pos)
+{
+  ASSERT (pos >= 0);
+  dir->pos = pos;
+}
+
+/* Reads the BLOCK_SECTOR_SIZE bytes of compact directory DIR
+   starting at byte offset OFS into BUF.  Returns false at the
+   end of the directory. */
+static bool
+read_record_sector (const struct dir *dir, off_t ofs, uint8_t *buf)
+{
+  return inode_read_at (dir->inode, buf, BLOCK_SECTOR_SIZE, ofs)
+         == BLOCK_SECTOR_SIZE;
+}
+
+/* Returns the record at byte REC_OFS of the directory sector in
+   BUF, or a null pointer if the record is malformed. */
+static struct dir_record *
+record_at (uint8_t *buf, size_t rec_ofs)
+{
+  struct dir_record *r = (struct dir_record *) (buf + rec_ofs);
+
+  if (rec_ofs + DIR_RECORD_HDR > BLOCK_SECTOR_SIZE
+      || r->rec_len < DIR_RECORD_HDR
+      || r->rec_len % sizeof (block_sector_t) != 0
+      || rec_ofs + r->rec_len > BLOCK_SECTOR_SIZE
+      || (r->inode_sector != 0 && record_size (r->name_len) > r->rec_len))
+    return NULL;
+  return r;
+}
+
+/* lookup() for a compact directory. */
+static bool
+lookup_compact (const struct dir *dir, const char *name,
+                block_sector_t *sectorp, off_t *ofsp)
+{
+  size_t name_len = strlen (name);
+  off_t sector_ofs;
+  uint8_t *buf;
+  bool found = false;
+
+  buf = malloc (BLOCK_SECTOR_SIZE);
+  if (buf == NULL)
+    return false;
+
+  for (sector_ofs = 0; !found && read_record_sector (dir, sector_ofs, buf);
+       sector_ofs += BLOCK_SECTOR_SIZE)
+    {
+      struct dir_record *r;
+      size_t rec_ofs;
+
+      for (rec_ofs = 0; rec_ofs < BLOCK_SECTOR_SIZE
+                        && (r = record_at (buf, rec_ofs)) != NULL;
+           rec_ofs += r->rec_len)
+        if (r->inode_sector != 0 && r->name_len == name_len
+            && !memcmp (r->name, name, name_len))
+          {
+            if (sectorp != NULL)
+              *sectorp = r->inode_sector;
+            if (ofsp != NULL)
+              *ofsp = sector_ofs + rec_ofs;
+            found = true;
+            break;
+          }
+    }
+  free (buf);
+  return found;
+}
+
+/* dir_add() for a compact directory.  Places the new record in
+   the first record's slack that can hold it, and otherwise
+   appends a sector to DIR. */
+static bool
+add_compact (struct dir *dir, const char *name, block_sector_t inode_sector)
+{
+  size_t name_len = strlen (name);
+  size_t need = record_size (name_len);
+  struct dir_record *r;
+  off_t sector_ofs;
+  uint8_t *buf;
+  bool success;
+
+  buf = malloc (BLOCK_SECTOR_SIZE);
+  if (buf == NULL)
+    return false;
+
+  for (sector_ofs = 0; read_record_sector (dir, sector_ofs, buf);
+       sector_ofs += BLOCK_SECTOR_SIZE)
+    {
+      size_t rec_ofs;
+
+      for (rec_ofs = 0; rec_ofs < BLOCK_SECTOR_SIZE
+                        && (r = record_at (buf, rec_ofs)) != NULL;
+           rec_ofs += r->rec_len)
+        {
+          size_t used = r->inode_sector != 0 ? record_size (r->name_len) : 0;
+          if (r->rec_len - used >= need)
+            {
+              if (used > 0)
+                {
+                  /* Split R, handing its slack to the new record. */
+                  struct dir_record *n;
+                  n = (struct dir_record *) ((uint8_t *) r + used);
+                  n->rec_len = r->rec_len - used;
+                  r->rec_len = used;
+                  r = n;
+                }
+              goto found;
+            }
+        }
+    }
+
+  /* No room anywhere: start a new sector with a single record
+     that spans all of it. */
+  memset (buf, 0, BLOCK_SECTOR_SIZE);
+  r = (struct dir_record *) buf;
+  r->rec_len = BLOCK_SECTOR_SIZE;
+
+ found:
+  r->inode_sector = inode_sector;
+  r->name_len = name_len;
+  r->unused = 0;
+  memcpy (r->name, name, name_len);
+  success = (inode_write_at (dir->inode, buf, BLOCK_SECTOR_SIZE, sector_ofs)
+             == BLOCK_SECTOR_SIZE);
+  free (buf);
+  return success;
+}
+
+/* Erases the compact directory record at byte offset OFS in DIR.
+   The record is folded into its predecessor in the same sector so
+   that the space can later hold a longer name; the first record
+   of a sector is just marked free. */
+static bool
+erase_compact (struct dir *dir, off_t ofs)
+{
+  off_t sector_ofs = ROUND_DOWN (ofs, BLOCK_SECTOR_SIZE);
+  size_t target = ofs % BLOCK_SECTOR_SIZE;
+  struct dir_record *prev = NULL, *r = NULL;
+  size_t rec_ofs = 0;
+  uint8_t *buf;
+  bool success = false;
+
+  buf = malloc (BLOCK_SECTOR_SIZE);
+  if (buf == NULL)
+    return false;
+
+  if (read_record_sector (dir, sector_ofs, buf))
+    {
+      while (rec_ofs < target && (r = record_at (buf, rec_ofs)) != NULL)
+        {
+          prev = r;
+          rec_ofs += r->rec_len;
+        }
+      r = rec_ofs == target ? record_at (buf, rec_ofs) : NULL;
+      if (r != NULL)
+        {
+          if (prev != NULL)
+            prev->rec_len += r->rec_len;
+          else
+            r->inode_sector = 0;
+          success = (inode_write_at (dir->inode, buf, BLOCK_SECTOR_SIZE,
+                                     sector_ofs) == BLOCK_SECTOR_SIZE);
+        }
+    }
+  free (buf);
+  return success;
+}
+
+/* Queues read-ahead of the inode of every record in use in the
+   compact directory sector in BUF. */
+static void
+stat_ahead_compact (uint8_t *buf)
+{
+  struct dir_record *r;
+  size_t rec_ofs;
+
+  for (rec_ofs = 0; rec_ofs < BLOCK_SECTOR_SIZE
+                    && (r = record_at (buf, rec_ofs)) != NULL;
+       rec_ofs += r->rec_len)
+    if (r->inode_sector != 0)
+      add_cache_read_ahead (r->inode_sector);
+}
+
+/* dir_readdir() for a compact directory.  Walks every record of a
+   sector from one read, instead of one read per entry.  On
+   entering a sector, queues read-ahead of the inodes of all the
+   entries it is about to return. */
+static bool
+readdir_compact (struct dir *dir, char name[NAME_MAX + 1])
+{
+  struct dir_record *r;
+  uint8_t *buf;
+  bool found = false;
+
+  buf = malloc (BLOCK_SECTOR_SIZE);
+  if (buf == NULL)
+    return false;
+
+  while (!found
+         && read_record_sector (dir, ROUND_DOWN (dir->pos, BLOCK_SECTOR_SIZE),
+                                buf))
+    do
+      {
+        if (dir->pos % BLOCK_SECTOR_SIZE == 0)
+          stat_ahead_compact (buf);
+
+        r = record_at (buf, dir->pos % BLOCK_SECTOR_SIZE);
+        if (r == NULL)
+          {
+            /* Malformed record: skip the rest of the sector. */
+            dir->pos = ROUND_UP (dir->pos + 1, BLOCK_SECTOR_SIZE);
+            break;
+          }
+        dir->pos += r->rec_len;
+        if (r->inode_sector != 0)
+          {
+            memcpy (name, r->name, r->name_len);
+            name[r->name_len] = '\0';
+            found = true;
+          }
+      }
+    while (!found && dir->pos % BLOCK_SECTOR_SIZE != 0);
+
+  free (buf);
+  return found;
+}
+
 /* Searches DIR for a file with the given NAME.
-   If successful, returns true, sets *EP to the directory entry
-   if EP is non-null, and sets *OFSP to the byte offset of the
-   directory entry if OFSP is non-null.
-   otherwise, returns false and ignores EP and OFSP. */
+   If successful, returns true, sets *SECTORP to the sector of the
+   file's inode if SECTORP is non-null, and sets *OFSP to the byte
+   offset of the directory entry if OFSP is non-null.
+   otherwise, returns false and ignores SECTORP and OFSP. */
 static bool
 lookup (const struct dir *dir, const char *name,
-        struct dir_entry *ep, off_t *ofsp) 
+        block_sector_t *sectorp, off_t *ofsp) 
 {
   // dir에 주어진 name을 검색
-  // 검색된 dir entry주소를 ep 인자로 반환
+  // 검색된 dir entry의 inode sector를 sectorp 인자로 반환
   struct dir_entry e;
   size_t ofs;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  if (inode_dir_format (dir->inode) == DIR_FORMAT_COMPACT)
+    return lookup_compact (dir, name, sectorp, ofsp);
+
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e) 
     if (e.in_use && !strcmp (name, e.name)) 
       {
-        if (ep != NULL)
-          *ep = e;
+        if (sectorp != NULL)
+          *sectorp = e.inode_sector;
         if (ofsp != NULL)
           *ofsp = ofs;
         return true;
@@ -125,14 +421,14 @@ dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
   // directory entry에서 file을 검색하여, inode를 open하고 성공 여부 return
-  struct dir_entry e;
+  block_sector_t inode_sector;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  // dir entry를 disk에서 읽어 name을 검색 후, 해당 entry를 e에 저장
-  if (lookup (dir, name, &e, NULL)) 
-    *inode = inode_open (e.inode_sector); // dir에 주어진 파일명이 존재한 sector
+  // dir entry를 disk에서 읽어 name을 검색 후, 해당 entry의 inode sector를 저장
+  if (lookup (dir, name, &inode_sector, NULL)) 
+    *inode = inode_open (inode_sector); // dir에 주어진 파일명이 존재한 sector
   else
     *inode = NULL;
 
@@ -151,18 +447,28 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   struct dir_entry e;
   off_t ofs;
   bool success = false;
+  bool compact;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
   /* Check NAME for validity. */
-  if (*name == '\0' || strlen (name) > NAME_MAX)
+  compact = inode_dir_format (dir->inode) == DIR_FORMAT_COMPACT;
+  if (*name == '\0'
+      || strlen (name) > (compact ? NAME_MAX : DIR_FIXED_NAME_MAX))
     return false;
 
   /* Check that NAME is not in use. */
+  journal_begin ();
   if (lookup (dir, name, NULL, NULL))
     goto done;
 
+  if (compact)
+    {
+      success = add_compact (dir, name, inode_sector);
+      goto done;
+    }
+
   /* Set OFS to offset of free slot.
      If there are no free slots, then it will be set to the
      current end-of-file.
@@ -183,6 +489,7 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
  done:
+  journal_end ();
   return success;
 }
 
@@ -194,6 +501,7 @@ dir_remove (struct dir *dir, const char *name)
 {
   struct dir_entry e;
   struct inode *inode = NULL;
+  block_sector_t inode_sector;
   bool success = false;
   off_t ofs;
 
@@ -201,18 +509,29 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (name != NULL);
 
   /* Find directory entry. */
-  if (!lookup (dir, name, &e, &ofs))
+  journal_begin ();
+  if (!lookup (dir, name, &inode_sector, &ofs))
     goto done;
 
   /* Open inode. */
-  inode = inode_open (e.inode_sector);
+  inode = inode_open (inode_sector);
   if (inode == NULL)
     goto done;
 
   /* Erase directory entry. */
-  e.in_use = false;
-  if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
-    goto done;
+  if (inode_dir_format (dir->inode) == DIR_FORMAT_COMPACT)
+    {
+      if (!erase_compact (dir, ofs))
+        goto done;
+    }
+  else
+    {
+      if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+        goto done;
+      e.in_use = false;
+      if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
+        goto done;
+    }
 
   /* Remove inode. */
   inode_remove (inode);
@@ -220,23 +539,57 @@ dir_remove (struct dir *dir, const char *name)
 
  done:
   inode_close (inode);
+  journal_end ();
   return success;
 }
 
+/* Queues read-ahead of the inodes of the fixed-format entries in
+   use in DIR from byte offset LO through HI, inclusive. */
+static void
+stat_ahead_fixed (struct dir *dir, off_t lo, off_t hi)
+{
+  struct dir_entry e;
+  off_t ofs;
+
+  for (ofs = lo; ofs <= hi; ofs += sizeof e)
+    {
+      if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+        break;
+      if (e.in_use)
+        add_cache_read_ahead (e.inode_sector);
+    }
+}
+
 /* Reads the next directory entry in DIR and stores the name in
    NAME.  Returns true if successful, false if the directory
-   contains no more entries. */
+   contains no more entries.
+
+   Also keeps the inodes of the next STAT_AHEAD_ENTRIES entries
+   queued for read-ahead.  After returning the entry at offset Q,
+   the slots up to Q + STAT_AHEAD_ENTRIES entries have been
+   queued, so each call only has to queue the slots that its own
+   advance brought into that window. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  off_t start = dir->pos;
+  off_t ofs;
+
+  if (inode_dir_format (dir->inode) == DIR_FORMAT_COMPACT)
+    return readdir_compact (dir, name);
 
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
     {
+      ofs = dir->pos;
       dir->pos += sizeof e;
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
+          stat_ahead_fixed (dir,
+                            (start == 0 ? ofs + (off_t) sizeof e
+                             : start + STAT_AHEAD_ENTRIES * (off_t) sizeof e),
+                            ofs + STAT_AHEAD_ENTRIES * (off_t) sizeof e);
           return true;
         } 
     }
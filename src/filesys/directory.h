@@ -4,27 +4,43 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include "devices/block.h"
+#include "filesys/off_t.h"
 
-/* Maximum length of a file name component.
-   This is the traditional UNIX maximum length.
-   After directories are implemented, this maximum length may be
-   retained, but much longer full path names must be allowed. */
-#define NAME_MAX 14
+/* Maximum length of a file name component in a fixed-format
+   directory.  This is the traditional UNIX maximum length. */
+#define DIR_FIXED_NAME_MAX 14
+
+/* Maximum length of a file name component in any directory.
+   Only compact-format directories can hold names longer than
+   DIR_FIXED_NAME_MAX. */
+#define NAME_MAX 255
+
+/* On-disk layout of a directory's entries.  Recorded in the
+   directory's inode; new directories inherit their parent's
+   format, and do_format() picks the root directory's. */
+enum dir_format
+  {
+    DIR_FORMAT_FIXED,           /* Array of fixed-size entries. */
+    DIR_FORMAT_COMPACT          /* Length-prefixed variable records. */
+  };
 
 struct inode;
 
 /* Opening and closing directories. */
-bool dir_create (block_sector_t sector, size_t entry_cnt);
+bool dir_create (block_sector_t sector, size_t entry_cnt, enum dir_format);
 struct dir *dir_open (struct inode *);
 struct dir *dir_open_root (void);
 struct dir *dir_reopen (struct dir *);
 void dir_close (struct dir *);
 struct inode *dir_get_inode (struct dir *);
+enum dir_format dir_get_format (struct dir *);
 
 /* Reading and writing. */
 bool dir_lookup (const struct dir *, const char *name, struct inode **);
 bool dir_add (struct dir *, const char *name, block_sector_t);
 bool dir_remove (struct dir *, const char *name);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
+off_t dir_tell (struct dir *);
+void dir_seek (struct dir *, off_t);
 
 #endif /* filesys/directory.h */
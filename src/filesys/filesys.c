@@ -6,12 +6,18 @@
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/journal.h"
+#include "devices/timer.h"
 #include "threads/thread.h"
 #include "filesys/inode.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device; // filesystem device를 포인팅
 
+/* Entry format of the root directory created by do_format().
+   Subdirectories inherit the format of their parent. */
+enum dir_format filesys_dir_format = DIR_FORMAT_FIXED;
+
 static void do_format (void);
 
 /* Initializes the file system module.
@@ -34,6 +40,9 @@ filesys_init (bool format)
 
   if (format) 
     do_format ();  // bitmap의 inode 생성 및 disk에 기록, Root dir의 inode 생성
+
+  // 4. journal에 commit된 transaction을 replay (cache로 metadata를 읽기 전에)
+  journal_init ();
   free_map_open ();
   
   // filesystem 초기화 후, 현재 thread의 dir필드에 root dir로 설정
@@ -47,8 +56,12 @@ filesys_done (void)
 {
   // buffer cache 종료
   bc_term();
+  // 남은 transaction을 commit하고 journal의 모든 sector를 제자리에 기록
+  journal_done ();
   // bitmap 기록용 file의 닫기. in-memory inode를 해지 및 open_inodes list에서 제거
   free_map_close ();
+  // disk의 write cache에 남은 내용까지 기록
+  block_flush (fs_device);
 }
  
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -78,6 +91,7 @@ filesys_create (const char *name, off_t initial_size)
     return false;
   
   block_sector_t inode_sector = 0;
+  journal_begin ();
   bool success = (dir != NULL
                   && free_map_allocate (1, &inode_sector) // free-map에서 inode의 block 할당
                   && inode_create (inode_sector, initial_size, 0) // free-map의 on-disk inode 생성시 is_dir 값을 0으로 설정
@@ -85,6 +99,7 @@ filesys_create (const char *name, off_t initial_size)
   
   if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1); // root directory inode 메모리 해지
+  journal_end ();
   
   // directory close
   dir_close (dir); 
@@ -317,10 +332,13 @@ parse_path (char* path_name, char** file_name)
 static void
 do_format (void)
 {
+  int64_t start = timer_ticks ();
+
   printf ("Formatting file system...");
   free_map_create ();
+  journal_create ();
   // 1번 디스크 블록에 root directory의 inode를 16개 생성
-  if (!dir_create (ROOT_DIR_SECTOR, 16))
+  if (!dir_create (ROOT_DIR_SECTOR, 16, filesys_dir_format))
     PANIC ("root directory creation failed");
 
   struct dir* root_dir = dir_open_root(); // root dir의 inode 생성
@@ -331,5 +349,6 @@ do_format (void)
   dir_close(root_dir);
 
   free_map_close (); // bitmap 기록용 file의 닫기
-  printf ("done.\n");
+  printf ("done in %lld ms.\n",
+          timer_elapsed (start) * 1000 / TIMER_FREQ);
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include "filesys/off_t.h"
+#include "filesys/directory.h"
 
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
@@ -16,6 +17,10 @@
 /* Block device that contains the file system. */
 extern struct block *fs_device;
 
+/* Entry format of the root directory created by do_format().
+   Controlled by kernel command-line option "-dirfmt". */
+extern enum dir_format filesys_dir_format;
+
 void filesys_init (bool format);
 void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size);
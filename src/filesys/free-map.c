@@ -1,12 +1,76 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+
+/* On disk, the free map file is a header sector followed by the
+   bitmap.  The bitmap is divided into allocation groups of one
+   sector each, so that each group covers GROUP_SECTORS sectors of
+   the device.  Groups at or beyond the header's init_cnt have
+   never been written and are implicitly all free, so formatting
+   writes only the groups in use instead of the whole bitmap. */
+#define FREE_MAP_MAGIC 0x46524545       /* "FREE" */
+#define GROUP_BYTES BLOCK_SECTOR_SIZE
+#define GROUP_SECTORS (GROUP_BYTES * 8)
+#define BITMAP_OFS BLOCK_SECTOR_SIZE    /* Offset of bitmap in file. */
+
+/* Free map file header.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct free_map_header
+  {
+    unsigned magic;                     /* FREE_MAP_MAGIC. */
+    uint32_t init_cnt;                  /* Number of groups written. */
+    uint8_t unused[BLOCK_SECTOR_SIZE - 8];
+  };
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static uint32_t init_cnt;            /* Copy of header's init_cnt. */
+
+/* Writes the free map header to disk.
+   Returns true if successful, false otherwise. */
+static bool
+write_header (void)
+{
+  struct free_map_header h;
+
+  memset (&h, 0, sizeof h);
+  h.magic = FREE_MAP_MAGIC;
+  h.init_cnt = init_cnt;
+  return file_write_at (free_map_file, &h, sizeof h, 0) == sizeof h;
+}
+
+/* Writes to disk the allocation groups that cover sectors
+   SECTOR through SECTOR + CNT, along with any never-written
+   groups below them.  Returns true if successful, false
+   otherwise. */
+static bool
+write_groups (block_sector_t sector, size_t cnt)
+{
+  size_t first = sector / GROUP_SECTORS;
+  size_t last = (sector + cnt - 1) / GROUP_SECTORS;
+
+  ASSERT (cnt > 0);
+
+  if (first > init_cnt)
+    first = init_cnt;
+  if (!bitmap_write_part (free_map, free_map_file, BITMAP_OFS,
+                          first * GROUP_BYTES,
+                          (last - first + 1) * GROUP_BYTES))
+    return false;
+  if (last >= init_cnt)
+    {
+      init_cnt = last + 1;
+      return write_header ();
+    }
+  return true;
+}
 
 /* Initializes the free map. */
 void
@@ -19,6 +83,7 @@ free_map_init (void)
   /* FREE_MAP_SECTOR = 0, ROOT_DIR_SECTOR = 1*/
   bitmap_mark (free_map, FREE_MAP_SECTOR); // 전달받은 disk block 번호의 bit를 true
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_mark (free_map, JOURNAL_SECTOR);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -33,7 +98,7 @@ free_map_allocate (size_t cnt, block_sector_t *sectorp)
   block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
   if (sector != BITMAP_ERROR
       && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+      && !write_groups (sector, cnt))
     {
       bitmap_set_multiple (free_map, sector, cnt, false); 
       sector = BITMAP_ERROR;
@@ -49,18 +114,30 @@ free_map_release (block_sector_t sector, size_t cnt)
 {
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  write_groups (sector, cnt);
+  journal_revoke (sector, cnt);
 }
 
 /* Opens the free map file and reads it from disk. */
 void // disk에 저장되어 있는 bitmap 정보 읽기
 free_map_open (void) 
 {
+  struct free_map_header h;
+
   // 메모리에 file 자료구조 할당 후, target file의 inode 포인팅 및 초기화
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
-  if (!bitmap_read (free_map, free_map_file)) // disk에 기록된 bitmap의 data 읽기
+  if (file_read_at (free_map_file, &h, sizeof h, 0) != sizeof h
+      || h.magic != FREE_MAP_MAGIC
+      || h.init_cnt > DIV_ROUND_UP (bitmap_file_size (free_map), GROUP_BYTES))
+    PANIC ("free map is corrupt");
+
+  /* Groups that were never written stay all free, as
+     free_map_init() left them. */
+  init_cnt = h.init_cnt;
+  if (!bitmap_read_part (free_map, free_map_file, BITMAP_OFS, 0,
+                         init_cnt * GROUP_BYTES)) // disk에 기록된 bitmap의 data 읽기
     PANIC ("can't read free map");
 }
 
@@ -73,20 +150,31 @@ free_map_close (void)
 }
 
 /* Creates a new free map file on disk and writes the free map to
-   it. */
+   it.  The file's data sectors are not zeroed; only the groups
+   that are already in use are written, in a single pass, and the
+   rest are left for write_groups() to initialize on demand. */
 void // bitmap의 inode 생성, bitmap의 data를 disk에 기록
 free_map_create (void) 
 {
+  size_t used;
+
   /* Create inode. */
   // bitmap의 inode를 0번 block에 생성
-  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map),0))
+  if (!inode_create_unzeroed (FREE_MAP_SECTOR,
+                              BITMAP_OFS + bitmap_file_size (free_map)))
     PANIC ("free map creation failed");
   /* Write bitmap to file. */
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
-  // bitmap의 data를 disk에 기록
+
+  /* Everything allocated so far came first-fit from sector 0,
+     so the sectors in use form a prefix of the device. */
+  used = bitmap_scan (free_map, 0, 1, false);
+  if (used == BITMAP_ERROR)
+    used = bitmap_size (free_map);
+  init_cnt = 0;
   // write bitmap to file
-  if (!bitmap_write (free_map, free_map_file))
+  if (!write_groups (0, used))
     PANIC ("can't write free map");
 }
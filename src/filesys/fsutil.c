@@ -1,16 +1,35 @@
 #include "filesys/fsutil.h"
 #include <debug.h>
+#include <inttypes.h>
+#include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ustar.h>
+#include "devices/ide.h"
+#include "devices/timer.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "threads/bench.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
+/* Sectors fsutil_extract() and fsutil_append() move to or from
+   the scratch device per command (64 kB). */
+#define EXTRACT_CHUNK_SECTORS 128
+#define CHUNK_BYTES (EXTRACT_CHUNK_SECTORS * BLOCK_SECTOR_SIZE)
+
+/* Pages fsutil_iobench() reads per file_read() call (64 kB). */
+#define IOBENCH_CHUNK_PAGES 16
+
+/* Ticks fsutil_iobench() lets its compute thread run with the
+   disk idle, to learn how fast it spins with the whole CPU. */
+#define IOBENCH_IDLE_TICKS 100
+
 /* List files in the root directory. */
 void
 fsutil_ls (char **argv UNUSED) 
@@ -67,21 +86,42 @@ fsutil_rm (char **argv)
     PANIC ("%s: delete failed\n", file_name);
 }
 
+/* Queues request R to move the SIZE bytes (rounded up to whole
+   sectors) at SECTOR on BLOCK to or from BUFFER, upping DONE on
+   completion. */
+static void
+submit_chunk (struct block *block, struct block_request *r, bool write,
+              block_sector_t sector, int size, void *buffer,
+              struct semaphore *done)
+{
+  block_request_init (r, write, sector, DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE),
+                      buffer, block_request_sema_up, done);
+  block_submit (block, r);
+}
+
 /* Extracts a ustar-format tar archive from the scratch block
-   device into the Pintos file system. */
+   device into the Pintos file system.  Each file is copied with
+   two buffers, so that the next chunk is read from the scratch
+   device while the current one is written to the file system,
+   usually on the other IDE channel. */
 void
 fsutil_extract (char **argv UNUSED) 
 {
   static block_sector_t sector = 0;
 
   struct block *src;
-  void *header, *data;
+  void *header, *data[2];
+  struct block_request reqs[2];
+  struct semaphore done[2];
 
   /* Allocate buffers. */
   header = malloc (BLOCK_SECTOR_SIZE);
-  data = malloc (BLOCK_SECTOR_SIZE);
-  if (header == NULL || data == NULL)
+  data[0] = malloc (CHUNK_BYTES);
+  data[1] = malloc (CHUNK_BYTES);
+  if (header == NULL || data[0] == NULL || data[1] == NULL)
     PANIC ("couldn't allocate buffers");
+  sema_init (&done[0], 0);
+  sema_init (&done[1], 0);
 
   /* Open source block device. */
   src = block_get_role (BLOCK_SCRATCH);
@@ -97,6 +137,7 @@ fsutil_extract (char **argv UNUSED)
       const char *error;
       enum ustar_type type;
       int size;
+      int cur;
 
       /* Read and parse ustar header. */
       block_read (src, sector++, header);
@@ -124,14 +165,25 @@ fsutil_extract (char **argv UNUSED)
           if (dst == NULL)
             PANIC ("%s: open failed", file_name);
 
-          /* Do copy. */
-          while (size > 0)
+          /* Do copy, EXTRACT_CHUNK_SECTORS at a time, with the
+             read of each chunk after the first overlapping the
+             write of the one before it. */
+          if (size > 0)
+            submit_chunk (src, &reqs[0], false, sector,
+                          size < CHUNK_BYTES ? size : CHUNK_BYTES,
+                          data[0], &done[0]);
+          for (cur = 0; size > 0; cur = !cur)
             {
-              int chunk_size = (size > BLOCK_SECTOR_SIZE
-                                ? BLOCK_SECTOR_SIZE
-                                : size);
-              block_read (src, sector++, data);
-              if (file_write (dst, data, chunk_size) != chunk_size)
+              int chunk_size = size < CHUNK_BYTES ? size : CHUNK_BYTES;
+              int next_size = size - chunk_size;
+
+              sema_down (&done[cur]);
+              sector += DIV_ROUND_UP (chunk_size, BLOCK_SECTOR_SIZE);
+              if (next_size > 0)
+                submit_chunk (src, &reqs[!cur], false, sector,
+                              next_size < CHUNK_BYTES ? next_size : CHUNK_BYTES,
+                              data[!cur], &done[!cur]);
+              if (file_write (dst, data[cur], chunk_size) != chunk_size)
                 PANIC ("%s: write failed with %d bytes unwritten",
                        file_name, size);
               size -= chunk_size;
@@ -151,12 +203,15 @@ fsutil_extract (char **argv UNUSED)
   block_write (src, 0, header);
   block_write (src, 1, header);
 
-  free (data);
+  free (data[1]);
+  free (data[0]);
   free (header);
 }
 
 /* Copies file FILE_NAME from the file system to the scratch
-   device, in ustar format.
+   device, in ustar format.  As in fsutil_extract(), two buffers
+   let the write of each chunk to the scratch device overlap the
+   read of the next one from the file system.
 
    The first call to this function will write starting at the
    beginning of the scratch device.  Later calls advance across
@@ -169,17 +224,25 @@ fsutil_append (char **argv)
   static block_sector_t sector = 0;
 
   const char *file_name = argv[1];
-  void *buffer;
+  void *buffer, *data[2];
+  struct block_request reqs[2];
+  struct semaphore done[2];
+  bool pending[2] = {false, false};
   struct file *src;
   struct block *dst;
   off_t size;
+  int cur;
 
   printf ("Appending '%s' to ustar archive on scratch device...\n", file_name);
 
-  /* Allocate buffer. */
+  /* Allocate buffers. */
   buffer = malloc (BLOCK_SECTOR_SIZE);
-  if (buffer == NULL)
-    PANIC ("couldn't allocate buffer");
+  data[0] = malloc (CHUNK_BYTES);
+  data[1] = malloc (CHUNK_BYTES);
+  if (buffer == NULL || data[0] == NULL || data[1] == NULL)
+    PANIC ("couldn't allocate buffers");
+  sema_init (&done[0], 0);
+  sema_init (&done[1], 0);
 
   /* Open source file. */
   src = filesys_open (file_name);
@@ -198,17 +261,28 @@ fsutil_append (char **argv)
   block_write (dst, sector++, buffer);
 
   /* Do copy. */
-  while (size > 0) 
+  for (cur = 0; size > 0; cur = !cur)
     {
-      int chunk_size = size > BLOCK_SECTOR_SIZE ? BLOCK_SECTOR_SIZE : size;
-      if (sector >= block_size (dst))
+      int chunk_size = size > CHUNK_BYTES ? CHUNK_BYTES : size;
+      size_t chunk_sectors = DIV_ROUND_UP (chunk_size, BLOCK_SECTOR_SIZE);
+
+      if (sector + chunk_sectors > block_size (dst))
         PANIC ("%s: out of space on scratch device", file_name);
-      if (file_read (src, buffer, chunk_size) != chunk_size)
+      if (pending[cur])
+        sema_down (&done[cur]);
+      if (file_read (src, data[cur], chunk_size) != chunk_size)
         PANIC ("%s: read failed with %"PROTd" bytes unread", file_name, size);
-      memset (buffer + chunk_size, 0, BLOCK_SECTOR_SIZE - chunk_size);
-      block_write (dst, sector++, buffer);
+      memset ((uint8_t *) data[cur] + chunk_size, 0,
+              chunk_sectors * BLOCK_SECTOR_SIZE - chunk_size);
+      submit_chunk (dst, &reqs[cur], true, sector, chunk_size, data[cur],
+                    &done[cur]);
+      pending[cur] = true;
+      sector += chunk_sectors;
       size -= chunk_size;
     }
+  for (cur = 0; cur < 2; cur++)
+    if (pending[cur])
+      sema_down (&done[cur]);
 
   /* Write ustar end-of-archive marker, which is two consecutive
      sectors full of zeros.  Don't advance our position past
@@ -219,5 +293,80 @@ fsutil_append (char **argv)
 
   /* Finish up. */
   file_close (src);
+  free (data[1]);
+  free (data[0]);
   free (buffer);
 }
+
+/* Reads all of FILE into BUFFER with transfers of type MODE
+   while S spins, and reports the read rate and the share of
+   the CPU that S got, relative to IDLE_SPINS per
+   IOBENCH_IDLE_TICKS ticks with the disk idle. */
+static void
+iobench_pass (const char *mode, struct file *file, void *buffer,
+              struct spinner *s, int64_t idle_spins)
+{
+  int64_t start, ticks, spins;
+  off_t bytes = 0, n;
+
+  file_seek (file, 0);
+  spins = spinner_count (s);
+  start = timer_ticks ();
+  while ((n = file_read (file, buffer, IOBENCH_CHUNK_PAGES * PGSIZE)) > 0)
+    bytes += n;
+  ticks = timer_elapsed (start);
+  spins = spinner_count (s) - spins;
+  if (ticks == 0)
+    ticks = 1;
+
+  printf ("%s: %"PRId64" ms, %"PRId64" kB/s, "
+          "compute thread got %"PRId64"%% of the CPU\n",
+          mode, ticks * 1000 / TIMER_FREQ,
+          (int64_t) bytes * TIMER_FREQ / 1024 / ticks,
+          idle_spins > 0
+          ? spins * IOBENCH_IDLE_TICKS * 100 / (idle_spins * ticks) : 0);
+}
+
+/* Reads file ARGV[1] once by PIO and, if the disk supports it,
+   once by bus-master DMA, while a compute thread spins at the
+   same priority, and prints how much CPU time each transfer
+   mode leaves for the compute thread. */
+void
+fsutil_iobench (char **argv)
+{
+  const char *file_name = argv[1];
+  bool use_dma = ide_use_dma;
+  struct spinner s;
+  struct file *file;
+  int64_t idle_spins;
+  void *buffer;
+
+  file = filesys_open (file_name);
+  if (file == NULL)
+    PANIC ("%s: open failed", file_name);
+  buffer = palloc_get_multiple (PAL_ASSERT, IOBENCH_CHUNK_PAGES);
+  printf ("Reading '%s' (%"PROTd" bytes) with a compute thread...\n",
+          file_name, file_length (file));
+
+  if (!spinner_start (&s, PRI_DEFAULT))
+    PANIC ("iobench: thread creation failed");
+
+  idle_spins = spinner_count (&s);
+  timer_sleep (IOBENCH_IDLE_TICKS);
+  idle_spins = spinner_count (&s) - idle_spins;
+
+  ide_use_dma = false;
+  iobench_pass ("pio", file, buffer, &s, idle_spins);
+  if (ide_dma_available ())
+    {
+      ide_use_dma = true;
+      iobench_pass ("dma", file, buffer, &s, idle_spins);
+    }
+  else
+    printf ("dma: no bus-master IDE controller\n");
+  ide_use_dma = use_dma;
+
+  spinner_stop (&s);
+  palloc_free_multiple (buffer, IOBENCH_CHUNK_PAGES);
+  file_close (file);
+}
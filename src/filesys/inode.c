@@ -5,9 +5,13 @@
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
 #include "threads/thread.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "threads/workqueue.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -21,6 +25,19 @@
 
 #define BUFFER_CACHE_ENTRY_NB 64
 
+/* Most sectors inode_read_at() reads past the buffer cache with
+   a single multi-sector command (64 kB). */
+#define DIRECT_READ_SECTORS 128
+
+/* Most sectors one read-ahead request brings into the buffer
+   cache with a single command.  Kept to a quarter of the cache so
+   that read-ahead cannot flush out everything else. */
+#define READ_AHEAD_SECTORS (BUFFER_CACHE_ENTRY_NB / 4)
+
+/* Most sectors of read-ahead that may be queued on the disk at
+   once. */
+#define READ_AHEAD_MAX_PENDING (BUFFER_CACHE_ENTRY_NB / 2)
+
 ////////     Project 4.1 Buffer Cache    ////////
 // data를 제외한, cache 스스로에 대한 정보 buffer head table
 static struct buffer_head bh_table[BUFFER_CACHE_ENTRY_NB];
@@ -35,21 +52,30 @@ int clock_hand;
 // 중간과정을 보이지 않게 하는 lock
 static struct lock buffer_head_lock;
 
+// sector가 disk에 write-back되거나 journal이 가져갈 때마다 bc_note_write_back()이 증가
+// read-ahead가 진행되는 동안 write-back이 있었다면 읽은 data가 낡았을 수 있음
+static unsigned bc_writeback_gen;
+
 /////////////////////////////////////////////////
 
 struct lock extend_lock;
 
 
 ///////////// READ_AHEAD /////////////
-struct list read_ahead_list;
 struct read_ahead
 {
-  block_sector_t sector;
-  struct list_elem elem;
+  struct block_request req;  // disk에 보낸 비동기 read 요청
+  unsigned gen;              // 요청 시점의 bc_writeback_gen
+  struct work work;          // 읽기가 끝나면 system_wq에서 cache에 넣음
+  uint8_t data[];            // req.cnt개 sector
 };
 struct lock read_ahead_lock;
-struct semaphore read_ahead_sema;
+static size_t read_ahead_pending;  // disk에 요청 중이거나 cache에 넣기 전인 sector 수
+
 
+static bool cache_write (block_sector_t, const void *, off_t, int, int,
+                         bool journaled, block_sector_t owner);
+static void zero_sector (block_sector_t, block_sector_t owner);
 
 /* On-disk inode.
    Must be exactly BLOCK_SECTOR_SIZE bytes long. */
@@ -59,6 +85,7 @@ struct inode_disk
     off_t length;     // File size in bytes. 할당 된 블록길이(byte) 파일 생성 시, 디스크 상에 연속된 block을 할당 받음
     unsigned magic;    // Magic number. 
     bool is_dir; // dir(=true), file(=1) 
+    uint8_t dir_format; // directory entry format (enum dir_format), dir only
 
     // 아래 순서대로 table을 사용
     // 1. 접근할 disk 블록의 번호들이 저장 -> direct 방식
@@ -93,6 +120,9 @@ struct inode
     
     // inode에 관련된 data 접근시 사용하는 lock
     struct lock extend_lock;
+
+    // 마지막 inode_sync() 이후 파일이 커졌는지 (extend_lock으로 보호)
+    bool grown;
     
     // struct inode_disk data;             /* Inode content. */
   };
@@ -175,13 +205,15 @@ inode_init (void)
   clock_hand = 0;
 }
 
-/* Initializes an inode with LENGTH bytes of data and
-   writes the new inode to sector SECTOR on the file system
-   device.
+/* Initializes an inode with LENGTH bytes of data and writes
+   the new inode to sector SECTOR on the file system device.  If
+   ZERO is false, the data sectors are allocated but left with
+   whatever they held before; index blocks are always zeroed.
    Returns true if successful.
    Returns false if memory or disk allocation fails. */
-bool
-inode_create (block_sector_t sector, off_t length, uint32_t is_dir)
+static bool
+create_inode (block_sector_t sector, off_t length, uint32_t is_dir,
+              bool zero)
 {
   struct inode_disk *disk_inode = NULL;
   bool success = false;
@@ -213,7 +245,8 @@ inode_create (block_sector_t sector, off_t length, uint32_t is_dir)
           // 1 크기의 data를 저장할 연속된 block을 찾고, 할당 받은 disk 블록의 시작 번호를 disk_inode에 저장
           if (free_map_allocate (1, &disk_inode->direct_map_table[i])){ // block 할당
             // disk_inode에서 direct_map_table의 i번째에 저장된 sector 번호에 0으로 채워진 block을 작성
-            bc_write(disk_inode->direct_map_table[i], zeros, 0, 0, BLOCK_SECTOR_SIZE);
+            if (zero)
+              zero_sector (disk_inode->direct_map_table[i], sector);
           }
           else
             return false;
@@ -245,7 +278,8 @@ inode_create (block_sector_t sector, off_t length, uint32_t is_dir)
             
             // indirect_block_sec에서 sector ofs만큼 이동시킨 cache에다가 block_sec 값을 저장
             bc_write(indirect_block_sector, &block_sector, 0, sector_ofs, sizeof(block_sector_t));
-            bc_write(block_sector, zeros, 0, 0, BLOCK_SECTOR_SIZE);
+            if (zero)
+              zero_sector (block_sector, sector);
           }
           else 
             return false;
@@ -289,7 +323,8 @@ inode_create (block_sector_t sector, off_t length, uint32_t is_dir)
           block_sector_t block_sector;
 
           if (free_map_allocate (1, &block_sector)){ // block sector 할당
-            bc_write(block_sector, zeros, 0, 0, BLOCK_SECTOR_SIZE);
+            if (zero)
+              zero_sector (block_sector, sector);
             bc_write(indirect_block_sector, &block_sector, 0, sector_ofs_, sizeof(block_sector_t));
           }
           else 
@@ -308,9 +343,44 @@ inode_create (block_sector_t sector, off_t length, uint32_t is_dir)
   return success;
 }
 
+/* Initializes an inode with LENGTH bytes of zeroed data and
+   writes the new inode to sector SECTOR on the file system
+   device.
+   Returns true if successful.
+   Returns false if memory or disk allocation fails. */
+bool
+inode_create (block_sector_t sector, off_t length, uint32_t is_dir)
+{
+  return create_inode (sector, length, is_dir, true);
+}
+
+/* Like inode_create(), but creates a regular file whose data
+   sectors are not zeroed.  For callers such as the free map that
+   track for themselves which parts of the file hold valid data,
+   so that creating a large file costs only its metadata. */
+bool
+inode_create_unzeroed (block_sector_t sector, off_t length)
+{
+  return create_inode (sector, length, 0, false);
+}
+
+/* Returns true if SECTOR lies on the file system device and
+   holds an on-disk inode, as judged by its magic number. */
+static bool
+inode_sector_valid (block_sector_t sector)
+{
+  struct inode_disk disk_inode;
+
+  if (sector >= block_size (fs_device))
+    return false;
+  bc_read (sector, &disk_inode, 0, 0, sizeof disk_inode);
+  return disk_inode.magic == INODE_MAGIC;
+}
+
 /* Reads an inode from SECTOR
    and returns a `struct inode' that contains it.
-   Returns a null pointer if memory allocation fails. */
+   Returns a null pointer if memory allocation fails or SECTOR
+   does not hold an inode. */
 struct inode *
 inode_open (block_sector_t sector)
 {
@@ -328,6 +398,13 @@ inode_open (block_sector_t sector)
           return inode; 
         }
     }
+
+  /* Refuse sectors past the end of the device and sectors that
+     do not hold an inode, rather than treating arbitrary data
+     as one later. */
+  if (!inode_sector_valid (sector))
+    return NULL;
+
   // inode 자료구조 할당
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
@@ -341,6 +418,7 @@ inode_open (block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
+  inode->grown = false;
 
   // inode 자료구조 초기화 시, lock 변수 초기화 부분 추가
   lock_init(&inode->extend_lock);
@@ -385,6 +463,8 @@ inode_close (struct inode *inode)
         {
           struct inode_disk disk_inode; // on_disk inode
 
+          journal_begin ();
+
           // 1. inode의 on-disk inode 획득
           bc_read(inode->sector, &disk_inode, 0, 0, sizeof (struct inode_disk));
 
@@ -422,6 +502,7 @@ inode_close (struct inode *inode)
               free_map_release(block_sec, 1);
             }
           }        
+          journal_end ();
         }
 
       free (inode); 
@@ -443,6 +524,182 @@ is_removed (struct inode *inode)
   return inode->removed;
 }
 
+/* Returns true if SECTOR is in the buffer cache.
+   The caller must hold buffer_head_lock. */
+static bool
+bc_cached (block_sector_t sector)
+{
+  int i;
+
+  ASSERT (lock_held_by_current_thread (&buffer_head_lock));
+  for (i = 0; i < BUFFER_CACHE_ENTRY_NB; i++)
+    if (bh_table[i].sector == sector)
+      return true;
+  return false;
+}
+
+/* Returns true if memory holds a copy of SECTOR that may be
+   newer than the one on disk, either in the buffer cache or in
+   the journal.  The caller must hold buffer_head_lock. */
+static bool
+bc_in_memory (block_sector_t sector)
+{
+  return bc_cached (sector) || journal_holds (sector);
+}
+
+/* Advances bc_writeback_gen, so that read-aheads and direct reads
+   in flight, which the disk may have served before the write, are
+   dropped.  Called whenever a sector is written home or the
+   journal takes an evicted entry, including by the journal with
+   journal_lock held, when buffer_head_lock cannot be taken, so
+   the counter is bumped with interrupts off instead.
+
+   The journal calls this before it drops a copy it wrote home.
+   Readers therefore check bc_writeback_gen after bc_in_memory():
+   a sector the journal no longer holds has had its write counted
+   by then. */
+void
+bc_note_write_back (void)
+{
+  enum intr_level old_level = intr_disable ();
+  bc_writeback_gen++;
+  intr_set_level (old_level);
+}
+
+/* Writes buffer cache entry HEAD back to disk if it is dirty,
+   unless the journal takes it instead because its sector has
+   changed since the last checkpoint.  Returns true if HEAD was
+   dirty, in which case bc_writeback_gen has advanced.  The caller
+   must hold buffer_head_lock. */
+static bool
+bc_write_back (struct buffer_head *head)
+{
+  if (!head->dirty)
+    return false;
+  if (!journal_absorb (head->sector, head->data))
+    {
+      block_write (fs_device, head->sector, head->data);
+      bc_note_write_back ();
+    }
+  return true;
+}
+
+/* Returns the number of sectors, up to MAX, of the file with
+   on-disk inode INODE_DISK that starting at byte OFFSET (which
+   holds SECTOR) lie in consecutive sectors on disk. */
+static size_t
+contiguous_sectors (const struct inode_disk *inode_disk,
+                    block_sector_t sector, off_t offset, size_t max)
+{
+  size_t cnt;
+
+  for (cnt = 1; cnt < max; cnt++)
+    if (byte_to_sector (inode_disk, offset + cnt * BLOCK_SECTOR_SIZE)
+        != sector + cnt)
+      break;
+  return cnt;
+}
+
+/* Reads whole sectors of the file with on-disk inode INODE_DISK,
+   starting at sector-aligned byte OFFSET (which holds SECTOR),
+   straight from disk into BUFFER with one multi-sector read.
+   Stops before SIZE bytes, end of file, DIRECT_READ_SECTORS,
+   the first sector that is cached (its cached copy may be newer
+   than the disk), or the first break in the on-disk layout.
+
+   The read runs without buffer_head_lock, so afterward the
+   sectors are checked again the way bc_install_read_ahead()
+   does: if a dirty entry was written back meanwhile, the disk
+   may have served the read before that write, and a sector
+   cached meanwhile may be newer than what was read, so neither
+   is returned.  A BUFFER in user memory is filled through a
+   kernel bounce buffer, because the disk's I/O thread cannot
+   reach user addresses, and only once the data has passed that
+   check.
+
+   Returns the number of bytes read, or 0 if fewer than two
+   sectors qualify or none survive the check, in which case the
+   caller should go through the buffer cache.  BUFFER may be
+   overwritten beyond the bytes returned. */
+static off_t
+read_direct (const struct inode_disk *inode_disk, block_sector_t sector,
+             off_t offset, off_t size, uint8_t *buffer)
+{
+  off_t left = inode_disk->length - offset;
+  size_t max = (size < left ? size : left) / BLOCK_SECTOR_SIZE;
+  uint8_t *bounce = NULL;
+  unsigned gen;
+  size_t cnt, i;
+
+  if (max < 2)
+    return 0;
+  if (max > DIRECT_READ_SECTORS)
+    max = DIRECT_READ_SECTORS;
+  cnt = contiguous_sectors (inode_disk, sector, offset, max);
+
+  lock_acquire (&buffer_head_lock);
+  gen = bc_writeback_gen;
+  for (i = 0; i < cnt; i++)
+    if (bc_in_memory (sector + i))
+      break;
+  cnt = i;
+  lock_release (&buffer_head_lock);
+  if (cnt < 2)
+    return 0;
+
+  if (is_user_vaddr (buffer))
+    {
+      bounce = malloc (cnt * BLOCK_SECTOR_SIZE);
+      if (bounce == NULL)
+        return 0;
+    }
+  block_read_multiple (fs_device, sector, cnt,
+                       bounce != NULL ? bounce : buffer);
+
+  lock_acquire (&buffer_head_lock);
+  for (i = 0; i < cnt; i++)
+    if (bc_in_memory (sector + i))
+      break;
+  cnt = gen == bc_writeback_gen ? i : 0;
+  lock_release (&buffer_head_lock);
+
+  if (bounce != NULL)
+    {
+      memcpy (buffer, bounce, cnt * BLOCK_SECTOR_SIZE);
+      free (bounce);
+    }
+  return (off_t) cnt * BLOCK_SECTOR_SIZE;
+}
+
+/* Queues read-ahead of the sectors of the file with on-disk inode
+   INODE_DISK that follow byte OFFSET, as one run of consecutive
+   sectors.  Does nothing at end of file or if the next sector is
+   already cached. */
+static void
+read_ahead_after (const struct inode_disk *inode_disk, off_t offset)
+{
+  block_sector_t sector = byte_to_sector (inode_disk, offset);
+  off_t left = inode_disk->length - ROUND_DOWN (offset, BLOCK_SECTOR_SIZE);
+  size_t max = DIV_ROUND_UP (left, BLOCK_SECTOR_SIZE);
+  bool cached;
+
+  if (sector == (block_sector_t) -1 || left <= 0)
+    return;
+  lock_acquire (&buffer_head_lock);
+  cached = bc_in_memory (sector);
+  lock_release (&buffer_head_lock);
+  if (cached)
+    return;
+
+  if (max > READ_AHEAD_SECTORS)
+    max = READ_AHEAD_SECTORS;
+  add_cache_read_ahead_run (sector,
+                            contiguous_sectors (inode_disk, sector,
+                                                ROUND_DOWN (offset,
+                                                            BLOCK_SECTOR_SIZE),
+                                                max));
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
@@ -453,19 +710,36 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   off_t bytes_read = 0;
   struct inode_disk inode_disk; // on_disk inode
 
-  if (inode->sector > 4096)
-    return -1;
-
   // 먼저 락을 취득
   lock_acquire(&inode->extend_lock);
   
   // disk inode를 buffer cache에서 읽음
   bc_read(inode->sector, &inode_disk, 0, 0, sizeof (struct inode_disk));
+  if (inode_disk.magic != INODE_MAGIC)
+    {
+      lock_release (&inode->extend_lock);
+      return 0;
+    }
   while (size > 0){
     /* Disk sector to read, starting byte offset within sector. */
     block_sector_t sector_idx = byte_to_sector (&inode_disk, offset);
     int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
+    /* Whole sectors that are not cached go straight from disk to
+       BUFFER, as many per command as are laid out back to back. */
+    if (sector_ofs == 0)
+      {
+        off_t run = read_direct (&inode_disk, sector_idx, offset, size,
+                                 buffer + bytes_read);
+        if (run > 0)
+          {
+            size -= run;
+            offset += run;
+            bytes_read += run;
+            continue;
+          }
+      }
+
     /* Bytes left in inode, bytes left in sector, lesser of the two. */
     off_t inode_left = inode_disk.length - offset;
     int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
@@ -478,10 +752,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
     
     // sector_idx이 정해진 이후, 데이터 읽기 작업은 lock을 해제한 상태에서 수행
     bc_read(sector_idx, buffer, bytes_read, sector_ofs, chunk_size); 
-    block_sector_t next_sector = byte_to_sector (&inode_disk, offset + chunk_size);
-    
-    if (next_sector >= 0) 
-      add_cache_read_ahead(next_sector);
+    read_ahead_after (&inode_disk, offset + chunk_size);
     
     /* Advance. */
     size -= chunk_size;
@@ -505,23 +776,26 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
   
-  if (inode->sector > 4096)
-    return -1;
-  
   // write 금지
   if (inode->deny_write_cnt)
     return 0;
   struct inode_disk inode_disk; // on_disk inode
   bc_read(inode->sector, &inode_disk, 0, 0, sizeof (struct inode_disk));
+  if (inode_disk.magic != INODE_MAGIC)
+    return 0;
 
   int old_length = inode_disk.length;
   int write_end = offset + size - 1;
+  bool grow = write_end > old_length - 1;
   
+  // 파일 확장은 하나의 transaction으로 journal에 기록.
+  // journal_begin()은 commit을 기다릴 수 있으므로 extend_lock보다 먼저
+  if (grow)
+    journal_begin ();
   lock_acquire(&inode->extend_lock);
-  if (write_end > old_length - 1){
+  if (grow){
     int length = write_end - (old_length - 1);
     if (length > 0){
-
       inode_disk.length = write_end + 1;
       static char zeros[BLOCK_SECTOR_SIZE];
       
@@ -529,10 +803,10 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
         
         if (i < DIRECT_BLOCK_ENTRIES){
           if (free_map_allocate (1, &inode_disk.direct_map_table[i])){
-            bc_write(inode_disk.direct_map_table[i], zeros, 0, 0, BLOCK_SECTOR_SIZE);
+            zero_sector (inode_disk.direct_map_table[i], inode->sector);
           }
           else 
-            return false;
+            goto fail;
         }
         
         else if (i < DIRECT_BLOCK_ENTRIES + INDIRECT_BLOCK_ENTRIES){
@@ -548,11 +822,11 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
           if (free_map_allocate (1, &block_sec)){
             int sector_ofs = (i - DIRECT_BLOCK_ENTRIES) * sizeof(block_sector_t);
             bc_write(indirect_block_sec, &block_sec, 0, sector_ofs, sizeof(block_sector_t));
-            bc_write(block_sec, zeros, 0, 0, BLOCK_SECTOR_SIZE);
+            zero_sector (block_sec, inode->sector);
           }
 
           else 
-            return false;
+            goto fail;
         }
 
         else if (i < DIRECT_BLOCK_ENTRIES + INDIRECT_BLOCK_ENTRIES*(INDIRECT_BLOCK_ENTRIES+1)){
@@ -580,16 +854,18 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
             int sector_ofs_ = ((i - DIRECT_BLOCK_ENTRIES - INDIRECT_BLOCK_ENTRIES) - (sector_ofs/sizeof(block_sector_t)) * INDIRECT_BLOCK_ENTRIES) * sizeof(block_sector_t);
             
             bc_write(indirect_block_sec, &block_sec, 0, sector_ofs_, sizeof(block_sector_t));
-            bc_write(block_sec, zeros, 0, 0, BLOCK_SECTOR_SIZE);              
+            zero_sector (block_sec, inode->sector);
           }
           else 
-            return -1;
+            goto fail;
         }
 
         else 
-          return -1;
+          goto fail;
       }
       bc_write(inode->sector, &inode_disk, 0, 0, sizeof (struct inode_disk));      
+      inode->grown = true;
+      journal_end ();
     }
   }
   
@@ -609,7 +885,9 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (chunk_size <= 0)
         break;
 
-      bc_write(sector_idx, buffer, bytes_written, sector_ofs, chunk_size); 
+      // 이 file의 data로 표시해 inode_sync()가 찾을 수 있도록 함
+      cache_write (sector_idx, buffer, bytes_written, sector_ofs, chunk_size,
+                   true, inode->sector);
       block_sector_t next_sector = byte_to_sector (&inode_disk, offset + chunk_size);
       
       if (next_sector >= 0) 
@@ -623,6 +901,11 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
   lock_release(&inode->extend_lock);
   return bytes_written;
+
+ fail:
+  journal_end ();
+  lock_release(&inode->extend_lock);
+  return 0;
 }
 
 /* Disables writes to INODE.
@@ -656,6 +939,36 @@ inode_length (const struct inode *inode)
 }
 
 
+static void bc_flush (block_sector_t owner);
+
+/* Makes INODE's data durable.  Writes back the dirty sectors of
+   its data that are in the buffer cache, then commits the
+   journal so that the metadata that finds them is durable too,
+   and flushes the disk's write cache.  Commits and flushes of
+   concurrent callers are grouped.  If DATA_ONLY is true
+   (fdatasync), the commit is skipped unless INODE has grown
+   since it was last synced.  Without a journal, writes back the
+   whole cache instead of committing. */
+void
+inode_sync (struct inode *inode, bool data_only)
+{
+  bool metadata;
+
+  bc_flush (inode->sector);
+
+  lock_acquire (&inode->extend_lock);
+  metadata = !data_only || inode->grown;
+  inode->grown = false;
+  lock_release (&inode->extend_lock);
+
+  if (!journal_sync (metadata))
+    {
+      if (metadata)
+        bc_flush (-1);
+      block_flush (fs_device);
+    }
+}
+
 /* Buffer cache에서 요청 받은 buffer frame을 읽어와서 user buffer에 저장 */
 // buffer를 이용하여 읽기 작업 수행
 bool 
@@ -670,17 +983,19 @@ bc_read(block_sector_t sector_idx, void* buffer, off_t bytes_read, int sector_of
     // read from disk to cache (update buffer)
     struct buffer_head* victim_entry = bc_select_victim();
     // dirty인 경우 victim entry를 disk로 flush하기
-    if (victim_entry->dirty)
-      block_write(fs_device, victim_entry->sector, victim_entry->data);
+    bc_write_back (victim_entry);
     
     head = victim_entry;
     head->dirty = false;
     head->clock_bit = true;
     head->sector = sector_idx;
+    head->owner = -1;
 
     // disk에서 cache로 data를 block_read하기
     // head를 다른 걸로 교체됨
-    block_read(fs_device, sector_idx, head->data); 
+    // journal이 더 새로운 copy를 가지고 있으면 그것을 사용
+    if (!journal_read (sector_idx, head->data))
+      block_read(fs_device, sector_idx, head->data); 
   }
   // 읽혔으니 사용됨
   head->used = true;
@@ -693,9 +1008,13 @@ bc_read(block_sector_t sector_idx, void* buffer, off_t bytes_read, int sector_of
   return true;
 }
 
-/* cache에서 요청 받은 data를 buffer frame에 기록 */
-bool 
-bc_write(block_sector_t sector, void* buffer, off_t bytes_written, int sector_ofs, int chunk_size)
+/* cache에서 요청 받은 data를 buffer frame에 기록.
+   JOURNALED가 true이면 바뀐 sector를 journal에 알림.
+   OWNER는 file data이면 그 file의 inode sector, 아니면 -1 */
+static bool
+cache_write (block_sector_t sector, const void *buffer, off_t bytes_written,
+             int sector_ofs, int chunk_size, bool journaled,
+             block_sector_t owner)
 {
   lock_acquire(&buffer_head_lock);
   // buffer_head를 검색
@@ -706,14 +1025,18 @@ bc_write(block_sector_t sector, void* buffer, off_t bytes_written, int sector_of
     // read from disk to cache (update buffer)
     struct buffer_head* victim_entry = bc_select_victim();
 
-    if (victim_entry->dirty)
-      block_write(fs_device, victim_entry->sector, victim_entry->data);
+    bc_write_back (victim_entry);
     
     head = victim_entry;
     head->dirty = false;
     head->clock_bit = true;
     head->sector = sector;
-    block_read(fs_device, sector, head->data); 
+    head->owner = -1;
+    /* A write that covers the whole sector does not need the
+       old contents, which matters when zeroing new blocks. */
+    if ((sector_ofs != 0 || chunk_size != BLOCK_SECTOR_SIZE)
+        && !journal_read (sector, head->data))
+      block_read(fs_device, sector, head->data); 
   }
   // store in use buffer
   lock_release(&buffer_head_lock);
@@ -721,14 +1044,38 @@ bc_write(block_sector_t sector, void* buffer, off_t bytes_written, int sector_of
   // write 했으니깐
   head->dirty = true;
   head->used = true;
+  if (owner != (block_sector_t) -1)
+    head->owner = owner;
   
   memcpy (head->data + sector_ofs, buffer + bytes_written, chunk_size);
   //  user buffer -> buffer cache data
+  if (journaled)
+    journal_write (sector, head->data);
   lock_release(&head->head_lock); 
   // bc_lookup에서 건 lock을 해제
   return true;
 }
 
+/* cache에서 요청 받은 data를 buffer frame에 기록 */
+bool 
+bc_write(block_sector_t sector, void* buffer, off_t bytes_written, int sector_ofs, int chunk_size)
+{
+  return cache_write (sector, buffer, bytes_written, sector_ofs, chunk_size,
+                      true, -1);
+}
+
+/* Fills SECTOR, newly allocated to hold data of the file whose
+   inode is in sector OWNER, with zeros in the buffer cache.
+   File data is not journaled, so this stays out of the running
+   transaction even inside a handle. */
+static void
+zero_sector (block_sector_t sector, block_sector_t owner)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+
+  cache_write (sector, zeros, 0, 0, BLOCK_SECTOR_SIZE, false, owner);
+}
+
 
 /* Buffer cache를 순회하며 DISK block의 캐싱 여부 검사*/
 // 캐싱 되어있다면, buffer cache entry
@@ -775,31 +1122,119 @@ bc_select_victim(void){
 }
 
 void add_cache_read_ahead (block_sector_t sector){
-  if (sector == -1)
-    return;
-  struct read_ahead *cache = malloc(sizeof(struct read_ahead));
-  cache->sector = sector;
+  add_cache_read_ahead_run (sector, 1);
+}
+
+static void bc_install_read_ahead (struct read_ahead *);
+
+/* Completion function for a read-ahead request: queues the
+   read-ahead RA_ on system_wq, which puts the data in the buffer
+   cache.  Runs in the disk's I/O thread, so it must not wait on
+   buffer_head_lock. */
+static void
+read_ahead_done (struct block_request *req UNUSED, void *ra_)
+{
+  struct read_ahead *ra = ra_;
+
+  work_queue (&system_wq, &ra->work);
+}
+
+/* Work function for read-ahead RA_, whose read has finished:
+   puts its data in the buffer cache and frees it. */
+static void
+read_ahead_install (void *ra_)
+{
+  struct read_ahead *ra = ra_;
 
   lock_acquire(&read_ahead_lock);
-  list_push_back(&read_ahead_list, &cache->elem);
-  sema_up(&read_ahead_sema);
+  read_ahead_pending -= ra->req.cnt;
   lock_release(&read_ahead_lock);
+
+  bc_install_read_ahead(ra);
+  free(ra);
 }
 
-static void cache_read_ahead (void *aux UNUSED)
-{
-  while(1)
-  {
-    sema_down(&read_ahead_sema);
+/* SECTOR부터 연속된 CNT개의 sector 중 cache에 없는 부분을
+   한 번의 비동기 명령으로 disk에 요청.  읽기가 끝나면
+   system_wq의 worker가 cache에 넣음 */
+void add_cache_read_ahead_run (block_sector_t sector, size_t cnt){
+  struct read_ahead *ra;
+  unsigned gen;
+  size_t n;
+
+  if (sector == -1 || cnt == 0)
+    return;
+  if (cnt > READ_AHEAD_SECTORS)
+    cnt = READ_AHEAD_SECTORS;
+
+  // 이미 cache에 있는 앞부분은 건너뛰고, 뒤따르는 cache에 없는 sector만 읽기
+  lock_acquire(&buffer_head_lock);
+  gen = bc_writeback_gen;
+  while (cnt > 0 && bc_in_memory (sector)){
+    sector++;
+    cnt--;
+  }
+  for (n = 0; n < cnt && !bc_in_memory (sector + n); n++)
+    continue;
+  lock_release(&buffer_head_lock);
+  if (n == 0)
+    return;
+
+  // disk에 너무 많은 read-ahead가 쌓이지 않도록 제한
+  lock_acquire(&read_ahead_lock);
+  if (read_ahead_pending + n > READ_AHEAD_MAX_PENDING){
+    lock_release(&read_ahead_lock);
+    return;
+  }
+  read_ahead_pending += n;
+  lock_release(&read_ahead_lock);
+
+  ra = malloc(sizeof *ra + n * BLOCK_SECTOR_SIZE);
+  if (ra == NULL){
     lock_acquire(&read_ahead_lock);
-    if (!list_empty(&read_ahead_list)){
-      struct read_ahead *cache = list_entry(list_pop_front(&read_ahead_list), struct read_ahead, elem);
-      block_sector_t sector = cache->sector;
-      bc_read(sector, NULL, 0, 0, 0);
-      free(cache);
-    }
+    read_ahead_pending -= n;
     lock_release(&read_ahead_lock);
+    return;
   }
+  ra->gen = gen;
+  work_init (&ra->work, read_ahead_install, ra);
+  block_request_init (&ra->req, false, sector, n, ra->data,
+                      read_ahead_done, ra);
+  block_submit (fs_device, &ra->req);
+}
+
+/* Puts the sectors read by read-ahead RA into the buffer cache,
+   skipping any that were cached meanwhile, since the cached copy
+   may be newer.  Drops the rest of them once some sector has
+   been written home since RA was issued, because the disk may
+   have served RA before that write. */
+static void
+bc_install_read_ahead (struct read_ahead *ra)
+{
+  unsigned gen = ra->gen;
+  size_t i;
+
+  lock_acquire(&buffer_head_lock);
+  for (i = 0; i < ra->req.cnt; i++){
+    struct buffer_head *head;
+
+    if (bc_in_memory (ra->req.sector + i))
+      continue;
+    if (gen != bc_writeback_gen)
+      break;
+    head = bc_select_victim();
+    // victim은 RA의 sector가 아니므로 그 write-back은 RA를 낡게 하지 않음
+    if (bc_write_back (head))
+      gen++;
+    head->dirty = false;
+    head->clock_bit = true;
+    head->used = true;
+    head->sector = ra->req.sector + i;
+    head->owner = -1;
+    memcpy (head->data, ra->data + i * BLOCK_SECTOR_SIZE, BLOCK_SECTOR_SIZE);
+    lock_release(&head->head_lock);
+  }
+  lock_release(&buffer_head_lock);
 }
 
 bool inode_is_dir(struct inode* inode) {
@@ -815,6 +1250,31 @@ bool inode_is_dir(struct inode* inode) {
     return false;
 }
 
+/* Creates a directory inode like inode_create(), and records
+   DIR_FORMAT as the layout of its entries. */
+bool
+inode_create_dir (block_sector_t sector, off_t length, uint8_t dir_format)
+{
+  struct inode_disk disk_inode;
+
+  if (!inode_create (sector, length, 1))
+    return false;
+  bc_read (sector, &disk_inode, 0, 0, sizeof (struct inode_disk));
+  disk_inode.dir_format = dir_format;
+  bc_write (sector, &disk_inode, 0, 0, sizeof (struct inode_disk));
+  return true;
+}
+
+/* Returns the directory entry format recorded in directory
+   INODE. */
+uint8_t
+inode_dir_format (struct inode *inode)
+{
+  struct inode_disk disk_inode;
+  bc_read (inode->sector, &disk_inode, 0, 0, sizeof (struct inode_disk));
+  return disk_inode.dir_format;
+}
+
 block_sector_t inode_to_sector(struct inode* inode)
 {
   return inode->sector;
@@ -826,10 +1286,7 @@ void bc_init()
   lock_init(&buffer_head_lock);
 
   lock_init(&read_ahead_lock);
-  sema_init(&read_ahead_sema, 0);
-  list_init(&read_ahead_list);
 
-  thread_create("read_ahead", 63, cache_read_ahead, NULL);
   p_buffer_cache = malloc(BUFFER_CACHE_ENTRY_NB * BLOCK_SECTOR_SIZE);
   
   for (int i = 0; i < BUFFER_CACHE_ENTRY_NB; i ++){
@@ -840,19 +1297,87 @@ void bc_init()
     bh_table[i].data = p_buffer_cache + i*BLOCK_SECTOR_SIZE;
     
     bh_table[i].sector = -1; // trash value
+    bh_table[i].owner = -1;
     
     lock_init(&bh_table[i].head_lock); 
   }
 }
 
-void bc_term()
+/* Writes dirty entries back to disk: every one if OWNER is -1,
+   otherwise only those holding data of the file whose inode is
+   in sector OWNER.  Entries are sorted by sector and runs of
+   consecutive sectors go out as one multi-sector write.  All the
+   runs are queued on the disk at once, so that its I/O scheduler
+   can order them, and then waited for together.  The cache stays
+   locked until they are on disk, so that nothing rereads a
+   sector before its write lands. */
+static void
+bc_flush (block_sector_t owner)
 {
-  for (int i = 0; i < BUFFER_CACHE_ENTRY_NB; i ++){
-    // dirty하고 clock_bit는 다 flush
-    if (bh_table[i].dirty && bh_table[i].clock_bit){
-      block_write(fs_device, bh_table[i].sector, bh_table[i].data);
-    } 
+  struct buffer_head *dirty[BUFFER_CACHE_ENTRY_NB];
+  struct block_request *reqs;
+  struct semaphore done;
+  uint8_t *buf;
+  int cnt = 0, req_cnt = 0;
+  int i, j;
+
+  // dirty하고 clock_bit는 다 flush
+  lock_acquire (&buffer_head_lock);
+  for (i = 0; i < BUFFER_CACHE_ENTRY_NB; i++)
+    if (bh_table[i].dirty && bh_table[i].clock_bit
+        && (owner == (block_sector_t) -1 || bh_table[i].owner == owner)){
+      /* Wait for any write into the entry in progress.  Holding
+         buffer_head_lock keeps new ones from starting. */
+      lock_acquire (&bh_table[i].head_lock);
+      /* The journal writes home the sectors it holds. */
+      if (journal_absorb (bh_table[i].sector, bh_table[i].data)){
+        bh_table[i].dirty = false;
+        lock_release (&bh_table[i].head_lock);
+        continue;
+      }
+      /* Insertion sort by sector. */
+      for (j = cnt++; j > 0 && dirty[j - 1]->sector > bh_table[i].sector; j--)
+        dirty[j] = dirty[j - 1];
+      dirty[j] = &bh_table[i];
+    }
+
+  sema_init (&done, 0);
+  buf = malloc (BUFFER_CACHE_ENTRY_NB * BLOCK_SECTOR_SIZE);
+  reqs = malloc (BUFFER_CACHE_ENTRY_NB * sizeof *reqs);
+  for (i = 0; i < cnt; i = j){
+    for (j = i + 1; j < cnt && dirty[j]->sector == dirty[i]->sector + (j - i); j++)
+      continue;
+    if (buf != NULL && reqs != NULL){
+      uint8_t *run = buf + i * BLOCK_SECTOR_SIZE;
+      int k;
+      for (k = i; k < j; k++)
+        memcpy (run + (k - i) * BLOCK_SECTOR_SIZE, dirty[k]->data, BLOCK_SECTOR_SIZE);
+      block_request_init (&reqs[req_cnt], true, dirty[i]->sector, j - i,
+                          run, block_request_sema_up, &done);
+      block_submit (fs_device, &reqs[req_cnt++]);
+    }
+    else {
+      int k;
+      for (k = i; k < j; k++)
+        block_write (fs_device, dirty[k]->sector, dirty[k]->data);
+    }
+    for (; i < j; i++){
+      dirty[i]->dirty = false;
+      lock_release (&dirty[i]->head_lock);
+    }
   }
+  for (i = 0; i < req_cnt; i++)
+    sema_down (&done);
+  if (cnt > 0)
+    bc_note_write_back ();
+  lock_release (&buffer_head_lock);
+  free (reqs);
+  free (buf);
+}
+
+void bc_term()
+{
+  bc_flush (-1);
   // initialize
   free(p_buffer_cache);
 }
\ No newline at end of file
@@ -30,6 +30,7 @@ struct buffer_head
     bool clock_bit; // clock bit
     
     block_sector_t sector; // cached disk sector address
+    block_sector_t owner;  // dirty data를 쓴 file의 inode sector (metadata이면 -1)
 
     struct lock head_lock; // 해당 cache에 쓰기 작업을 하기 전 이 lock을 획득
 
@@ -40,6 +41,7 @@ struct buffer_head
 
 void inode_init (void);
 bool inode_create (block_sector_t, off_t, uint32_t);
+bool inode_create_unzeroed (block_sector_t, off_t);
 struct inode *inode_open (block_sector_t);
 struct inode *inode_reopen (struct inode *);
 block_sector_t inode_get_inumber (const struct inode *);
@@ -50,6 +52,7 @@ off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+void inode_sync (struct inode *, bool data_only);
 
 
 ///////////////////////////////
@@ -64,6 +67,13 @@ bool bc_read(block_sector_t, void*, off_t, int, int);
 /* Buffer cache에서 buffer frame에 요청 받은 data를 기록 */
 bool bc_write(block_sector_t, void*, off_t, int, int);
 
+/* sector가 disk에 쓰였거나 journal이 가져갔음을 알림 (진행 중인 read-ahead를 버리게 함) */
+void bc_note_write_back (void);
+
+/* SECTOR를 비동기로 buffer cache에 읽어오도록 요청 (system_wq가 cache에 넣음) */
+void add_cache_read_ahead (block_sector_t);
+void add_cache_read_ahead_run (block_sector_t, size_t cnt);
+
 /* Buffer cache를 순회하며 target sector가 있는지 검색 */
 struct buffer_head* bc_lookup(block_sector_t);
 
@@ -74,6 +84,8 @@ struct buffer_head* bc_select_victim(void);
 bool is_removed(struct inode*);
 block_sector_t inode_to_sector(struct inode*);
 bool inode_is_dir(struct inode* inode);
+bool inode_create_dir (block_sector_t, off_t, uint8_t dir_format);
+uint8_t inode_dir_format (struct inode *);
 
 
 #endif /* filesys/inode.h */
@@ -0,0 +1,799 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+
+/* Write-ahead journal of file system metadata.
+
+   Every change to metadata (inodes, index blocks, directories,
+   and the free map) is made between journal_begin() and
+   journal_end(), which bracket one file system operation.  The
+   buffer cache passes each sector written inside such a handle
+   to journal_write(), which keeps a copy of it.  All the
+   operations of a few seconds are grouped into one transaction,
+   which is committed by writing copies of all the sectors it
+   changed to the log, followed by a commit record.  If the
+   system crashes, journal_init() replays the committed
+   transactions at the next mount, so every operation is either
+   entirely on disk or not at all.
+
+   A sector that has been changed since the last checkpoint must
+   not reach its home location before the transaction that
+   changed it commits.  Rather than pinning such sectors in the
+   buffer cache, the journal keeps its own copy of each and the
+   cache hands them to journal_absorb() instead of writing them
+   home when it evicts them, and reads them back with
+   journal_read().  A checkpoint, taken once the log is half
+   full, writes all the copies home in one sorted batch and
+   empties the log.  Whenever the journal takes an evicted sector
+   or writes one home, it tells the cache with
+   bc_note_write_back(), before dropping any copy, so that a
+   read-ahead already in flight for the sector is not installed
+   over the newer data.
+
+   A sector freed by a transaction is revoked, so that replay
+   does not write an older logged copy over data the sector
+   holds after it is reused.
+
+   The disk may keep acknowledged writes in a volatile cache and
+   write them out in any order, so the journal flushes that
+   cache at its ordering points: before a commit record (so the
+   transaction is on disk before the record that vouches for it),
+   after it (so the commit is durable), and around the
+   superblock update that ends a checkpoint or replay.
+
+   Disks formatted without a journal (for example, by
+   pintos-mkfs) are used unjournaled. */
+
+#define JOURNAL_MAGIC 0x4a524e4c        /* "JRNL" */
+#define DESC_MAGIC 0x4a445343           /* "JDSC" */
+#define COMMIT_MAGIC 0x4a434d54         /* "JCMT" */
+
+/* Size of the log, in sectors, as a fraction of the file system
+   device and in absolute bounds. */
+#define JOURNAL_FRACTION 32
+#define JOURNAL_MIN_SECTORS 64
+#define JOURNAL_MAX_SECTORS 512
+
+/* Longest a transaction stays open, in timer ticks. */
+#define COMMIT_INTERVAL (5 * TIMER_FREQ)
+
+/* Most sector copies kept in memory before a checkpoint. */
+#define CHECKPOINT_BLOCKS 128
+
+/* Number of tags in a descriptor. */
+#define DESC_TAGS ((BLOCK_SECTOR_SIZE - 16) / sizeof (block_sector_t))
+
+/* Journal superblock, in sector JOURNAL_SECTOR.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_super
+  {
+    unsigned magic;                     /* JOURNAL_MAGIC. */
+    block_sector_t start;               /* First sector of log. */
+    uint32_t size;                      /* Sectors in log. */
+    uint32_t seq;                       /* First transaction in log. */
+    uint8_t unused[BLOCK_SECTOR_SIZE - 16];
+  };
+
+/* Log record header.  A transaction is one or more descriptors,
+   each followed by copies of the CNT sectors in its first CNT
+   tags, and then a commit record, which is a header with
+   COMMIT_MAGIC and no tags.  The REVOKE_CNT tags after the
+   first CNT name sectors that the transaction freed.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_header
+  {
+    unsigned magic;                     /* DESC_MAGIC or COMMIT_MAGIC. */
+    uint32_t seq;                       /* Transaction sequence number. */
+    uint32_t cnt;                       /* Logged sectors. */
+    uint32_t revoke_cnt;                /* Revoked sectors. */
+    block_sector_t tags[DESC_TAGS];     /* Home sectors. */
+  };
+
+/* In-memory copy of a sector changed since the last checkpoint. */
+struct journal_block
+  {
+    struct hash_elem hash_elem;         /* Element in `blocks'. */
+    struct list_elem list_elem;         /* Element in `running'. */
+    block_sector_t sector;              /* Home sector. */
+    bool logged;                        /* Copy committed to the log? */
+    bool running;                       /* In running transaction? */
+    bool revoked;                       /* Freed by running transaction? */
+    uint8_t data[];                     /* Latest contents, one sector. */
+  };
+
+/* A revoke record found during replay. */
+struct revoke
+  {
+    struct list_elem elem;
+    block_sector_t sector;              /* Revoked sector. */
+    uint32_t seq;                       /* Transaction that revoked it. */
+  };
+
+static bool enabled;                    /* Journal in use? */
+static struct journal_super super;      /* Copy of superblock. */
+static uint32_t head;                   /* Next free log sector. */
+static uint32_t seq;                    /* Running transaction's number. */
+
+static struct lock journal_lock;        /* Protects everything below. */
+static struct condition handles_closed; /* Signaled when handle_cnt hits 0. */
+static struct condition commit_done;    /* Signaled when a commit or a
+                                           flush ends. */
+static int handle_cnt;                  /* Open handles. */
+static bool committing;                 /* Commit in progress? */
+static bool flushing;                   /* journal_sync() flush? */
+static unsigned flush_gen;              /* Device flushes started... */
+static unsigned flushed_gen;            /* ...and latest one finished. */
+static struct hash blocks;              /* All journal_blocks, by sector. */
+static struct list running;             /* Blocks in running transaction. */
+
+static bool sync (bool commit_running, bool flush);
+static void commit (void);
+static void checkpoint (void);
+static void replay (void);
+static void commit_periodically (void *aux);
+
+/* Runs commit_periodically() on system_wq. */
+static struct work commit_work;
+
+/* Returns a hash value for the journal_block in E. */
+static unsigned
+block_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct journal_block *b = hash_entry (e, struct journal_block,
+                                              hash_elem);
+  return hash_int (b->sector);
+}
+
+/* Returns true if journal_block A precedes B. */
+static bool
+block_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct journal_block, hash_elem)->sector
+          < hash_entry (b, struct journal_block, hash_elem)->sector);
+}
+
+/* Frees the journal_block in E. */
+static void
+block_free (struct hash_elem *e, void *aux UNUSED)
+{
+  free (hash_entry (e, struct journal_block, hash_elem));
+}
+
+/* Returns the copy of SECTOR, or a null pointer if there is
+   none.  If CREATE is true, makes a new copy if there is none.
+   The caller must hold journal_lock. */
+static struct journal_block *
+find_block (block_sector_t sector, bool create)
+{
+  struct journal_block key, *b;
+  struct hash_elem *e;
+
+  key.sector = sector;
+  e = hash_find (&blocks, &key.hash_elem);
+  if (e != NULL)
+    return hash_entry (e, struct journal_block, hash_elem);
+  if (!create)
+    return NULL;
+
+  b = malloc (sizeof *b + BLOCK_SECTOR_SIZE);
+  if (b == NULL)
+    PANIC ("journal: out of memory");
+  b->sector = sector;
+  b->logged = b->running = b->revoked = false;
+  hash_insert (&blocks, &b->hash_elem);
+  return b;
+}
+
+/* Adds B to the running transaction.
+   The caller must hold journal_lock. */
+static void
+add_to_running (struct journal_block *b)
+{
+  if (!b->running)
+    {
+      b->running = true;
+      list_push_back (&running, &b->list_elem);
+    }
+}
+
+/* Reserves a journal on a newly formatted file system device.
+   The free map must be open. */
+void
+journal_create (void)
+{
+  static uint8_t zeros[BLOCK_SECTOR_SIZE];
+  struct journal_super s;
+  size_t size = block_size (fs_device) / JOURNAL_FRACTION;
+
+  if (size < JOURNAL_MIN_SECTORS)
+    size = JOURNAL_MIN_SECTORS;
+  if (size > JOURNAL_MAX_SECTORS)
+    size = JOURNAL_MAX_SECTORS;
+
+  memset (&s, 0, sizeof s);
+  s.magic = JOURNAL_MAGIC;
+  s.size = size;
+  s.seq = 1;
+  if (!free_map_allocate (size, &s.start))
+    PANIC ("journal creation failed");
+  block_write (fs_device, s.start, zeros);
+  block_write (fs_device, JOURNAL_SECTOR, &s);
+}
+
+/* Opens the journal of the file system device, if it has one,
+   and replays the transactions committed in it.  Must be called
+   before anything reads metadata through the buffer cache. */
+void
+journal_init (void)
+{
+  ASSERT (sizeof (struct journal_super) == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct journal_header) == BLOCK_SECTOR_SIZE);
+
+  lock_init (&journal_lock);
+  cond_init (&handles_closed);
+  cond_init (&commit_done);
+  hash_init (&blocks, block_hash, block_less, NULL);
+  list_init (&running);
+
+  block_read (fs_device, JOURNAL_SECTOR, &super);
+  if (super.magic != JOURNAL_MAGIC)
+    return;
+  if (super.start >= block_size (fs_device)
+      || super.size > block_size (fs_device) - super.start)
+    PANIC ("journal is corrupt");
+
+  replay ();
+  enabled = true;
+  work_init (&commit_work, commit_periodically, NULL);
+  work_queue_delayed (&system_wq, &commit_work, COMMIT_INTERVAL);
+}
+
+/* Commits the running transaction and checkpoints the log, so
+   that all metadata is in its home location. */
+void
+journal_done (void)
+{
+  if (!enabled)
+    return;
+
+  work_cancel_sync (&commit_work);
+  lock_acquire (&journal_lock);
+  while (committing)
+    cond_wait (&commit_done, &journal_lock);
+  commit ();
+  if (!hash_empty (&blocks))
+    checkpoint ();
+  enabled = false;
+  lock_release (&journal_lock);
+}
+
+/* Begins a file system operation.  The metadata it writes
+   becomes part of the running transaction, which cannot commit
+   until the matching journal_end().  Handles nest. */
+void
+journal_begin (void)
+{
+  struct thread *t = thread_current ();
+
+  if (!enabled || t->journal_depth++ > 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  while (committing)
+    cond_wait (&commit_done, &journal_lock);
+  if (list_size (&running) >= super.size / 8)
+    commit ();
+  handle_cnt++;
+  lock_release (&journal_lock);
+}
+
+/* Ends a file system operation begun with journal_begin(). */
+void
+journal_end (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->journal_depth == 0 || --t->journal_depth > 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  if (--handle_cnt == 0)
+    cond_broadcast (&handles_closed, &journal_lock);
+  lock_release (&journal_lock);
+}
+
+/* Waits until the operations already ended by any thread are
+   committed, committing the running transaction if no commit of
+   it is under way.  Callers that arrive while a commit is in
+   progress share it, so concurrent fsyncs cost one commit.
+   Returns false if the file system has no journal.  Must not be
+   called inside a handle. */
+bool
+journal_commit (void)
+{
+  return sync (true, false);
+}
+
+/* Waits until everything written to the file system device
+   before the call is on stable media and, if COMMIT_RUNNING is
+   true, until the operations already ended are committed, as
+   journal_commit() does.  Concurrent callers share commits and
+   device flushes.  Returns false if the file system has no
+   journal.  Must not be called inside a handle. */
+bool
+journal_sync (bool commit_running)
+{
+  return sync (commit_running, true);
+}
+
+/* Implements journal_commit() and journal_sync(). */
+static bool
+sync (bool commit_running, bool flush)
+{
+  /* Read before waiting for the lock: the running transaction
+     holds the caller's operations, and any flush started from
+     now on covers the caller's writes. */
+  uint32_t target = seq;
+  unsigned need_gen = flush_gen + 1;
+
+  if (!enabled)
+    return false;
+  ASSERT (thread_current ()->journal_depth == 0);
+
+  lock_acquire (&journal_lock);
+  for (;;)
+    {
+      if (committing || flushing)
+        cond_wait (&commit_done, &journal_lock);
+      else if (commit_running && seq == target && !list_empty (&running))
+        commit ();
+      else if (flush && flushed_gen < need_gen)
+        {
+          /* Let operations go on during the flush. */
+          unsigned gen = ++flush_gen;
+
+          flushing = true;
+          lock_release (&journal_lock);
+          block_flush (fs_device);
+          lock_acquire (&journal_lock);
+          flushing = false;
+          if (gen > flushed_gen)
+            flushed_gen = gen;
+          cond_broadcast (&commit_done, &journal_lock);
+        }
+      else
+        break;
+    }
+  lock_release (&journal_lock);
+  return true;
+}
+
+/* Flushes the file system device's write cache.  The caller
+   must hold journal_lock, except during replay. */
+static void
+flush_device (void)
+{
+  unsigned gen = ++flush_gen;
+
+  block_flush (fs_device);
+  if (gen > flushed_gen)
+    flushed_gen = gen;
+}
+
+/* Called by the buffer cache after it changes SECTOR, whose new
+   contents are DATA.  Inside a handle, adds SECTOR to the
+   running transaction.  Outside one, only keeps an existing copy
+   of SECTOR up to date. */
+void
+journal_write (block_sector_t sector, const void *data)
+{
+  bool in_handle = thread_current ()->journal_depth > 0;
+  struct journal_block *b;
+
+  if (!enabled)
+    return;
+
+  lock_acquire (&journal_lock);
+  b = find_block (sector, in_handle);
+  if (b != NULL)
+    {
+      memcpy (b->data, data, BLOCK_SECTOR_SIZE);
+      if (in_handle || !b->revoked)
+        {
+          b->revoked = false;
+          add_to_running (b);
+        }
+    }
+  lock_release (&journal_lock);
+}
+
+/* Records that the running transaction frees the CNT sectors
+   starting at SECTOR. */
+void
+journal_revoke (block_sector_t sector, size_t cnt)
+{
+  if (!enabled)
+    return;
+
+  lock_acquire (&journal_lock);
+  for (; cnt > 0; sector++, cnt--)
+    {
+      struct journal_block *b = find_block (sector, false);
+      if (b != NULL)
+        {
+          b->revoked = true;
+          add_to_running (b);
+        }
+    }
+  lock_release (&journal_lock);
+}
+
+/* Called by the buffer cache when it evicts dirty SECTOR, whose
+   contents are DATA.  Returns true if the journal took DATA, in
+   which case the cache must not write SECTOR home. */
+bool
+journal_absorb (block_sector_t sector, const void *data)
+{
+  struct journal_block *b;
+
+  if (!enabled)
+    return false;
+
+  lock_acquire (&journal_lock);
+  b = find_block (sector, false);
+  if (b != NULL)
+    {
+      memcpy (b->data, data, BLOCK_SECTOR_SIZE);
+      bc_note_write_back ();
+    }
+  lock_release (&journal_lock);
+  return b != NULL;
+}
+
+/* If the journal holds a copy of SECTOR, which is then newer
+   than the one on disk, copies it into DATA and returns true.
+   Otherwise, returns false. */
+bool
+journal_read (block_sector_t sector, void *data)
+{
+  struct journal_block *b;
+
+  if (!enabled)
+    return false;
+
+  lock_acquire (&journal_lock);
+  b = find_block (sector, false);
+  if (b != NULL)
+    memcpy (data, b->data, BLOCK_SECTOR_SIZE);
+  lock_release (&journal_lock);
+  return b != NULL;
+}
+
+/* Returns true if the journal holds a copy of SECTOR. */
+bool
+journal_holds (block_sector_t sector)
+{
+  bool holds;
+
+  if (!enabled)
+    return false;
+
+  lock_acquire (&journal_lock);
+  holds = find_block (sector, false) != NULL;
+  lock_release (&journal_lock);
+  return holds;
+}
+
+/* Appends a descriptor with the first CNT + REVOKE_CNT tags in
+   H to the log, at log sector POS.  The caller must hold
+   journal_lock. */
+static void
+write_descriptor (struct journal_header *h, uint32_t pos)
+{
+  h->magic = DESC_MAGIC;
+  h->seq = seq;
+  block_write (fs_device, super.start + pos, h);
+}
+
+/* Writes the running transaction to the log.  Returns false if
+   it has nothing to record.
+   The caller must hold journal_lock, with no handles open. */
+static bool
+write_transaction (void)
+{
+  struct journal_header h;
+  struct block_request *reqs;
+  struct semaphore done;
+  struct list_elem *e;
+  size_t log_cnt = 0, revoke_cnt = 0, sector_cnt;
+  size_t i, n = 0;
+
+  for (e = list_begin (&running); e != list_end (&running); e = list_next (e))
+    {
+      struct journal_block *b = list_entry (e, struct journal_block,
+                                            list_elem);
+      if (!b->revoked)
+        log_cnt++;
+      else if (b->logged)
+        revoke_cnt++;
+    }
+  if (log_cnt == 0 && revoke_cnt == 0)
+    return false;
+  sector_cnt = (DIV_ROUND_UP (log_cnt, DESC_TAGS) + log_cnt
+                + DIV_ROUND_UP (revoke_cnt, DESC_TAGS) + 1);
+  if (head + sector_cnt > super.size)
+    PANIC ("journal: %zu-sector transaction does not fit in log",
+           sector_cnt);
+
+  /* Descriptors, each followed by copies of the sectors it tags.
+     The copies are all queued before waiting for any. */
+  reqs = malloc (log_cnt * sizeof *reqs);
+  sema_init (&done, 0);
+  e = list_begin (&running);
+  while (n < log_cnt)
+    {
+      uint32_t desc_pos = head++;
+
+      memset (&h, 0, sizeof h);
+      for (; e != list_end (&running) && h.cnt < DESC_TAGS;
+           e = list_next (e))
+        {
+          struct journal_block *b = list_entry (e, struct journal_block,
+                                                list_elem);
+          if (b->revoked)
+            continue;
+          h.tags[h.cnt++] = b->sector;
+          if (reqs != NULL)
+            {
+              block_request_init (&reqs[n], true, super.start + head, 1,
+                                  b->data, block_request_sema_up, &done);
+              block_submit (fs_device, &reqs[n]);
+            }
+          else
+            block_write (fs_device, super.start + head, b->data);
+          head++;
+          n++;
+        }
+      write_descriptor (&h, desc_pos);
+    }
+  for (i = 0; reqs != NULL && i < log_cnt; i++)
+    sema_down (&done);
+  free (reqs);
+
+  /* Revoke records, in descriptors of their own. */
+  e = list_begin (&running);
+  while (revoke_cnt > 0)
+    {
+      memset (&h, 0, sizeof h);
+      for (; e != list_end (&running) && h.revoke_cnt < DESC_TAGS;
+           e = list_next (e))
+        {
+          struct journal_block *b = list_entry (e, struct journal_block,
+                                                list_elem);
+          if (b->revoked && b->logged)
+            h.tags[h.revoke_cnt++] = b->sector;
+        }
+      revoke_cnt -= h.revoke_cnt;
+      write_descriptor (&h, head++);
+    }
+
+  /* The commit record makes the transaction durable. */
+  flush_device ();
+  memset (&h, 0, sizeof h);
+  h.magic = COMMIT_MAGIC;
+  h.seq = seq++;
+  block_write (fs_device, super.start + head++, &h);
+  flush_device ();
+  return true;
+}
+
+/* Commits the running transaction, if it has changed anything,
+   and checkpoints the log if it is getting full.
+   The caller must hold journal_lock and must not be committing. */
+static void
+commit (void)
+{
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+  ASSERT (!committing);
+
+  committing = true;
+  while (handle_cnt > 0)
+    cond_wait (&handles_closed, &journal_lock);
+
+  if (!list_empty (&running))
+    {
+      bool written = write_transaction ();
+
+      /* Freed sectors need no log copy any more.  Their copies
+         may hold data written after they were reused, so write
+         those home. */
+      while (!list_empty (&running))
+        {
+          struct journal_block *b = list_entry (list_pop_front (&running),
+                                                struct journal_block,
+                                                list_elem);
+          b->running = false;
+          if (b->revoked)
+            {
+              block_write (fs_device, b->sector, b->data);
+              bc_note_write_back ();
+              hash_delete (&blocks, &b->hash_elem);
+              free (b);
+            }
+          else
+            b->logged = true;
+        }
+
+      if (written
+          && (head > super.size / 2
+              || hash_size (&blocks) > CHECKPOINT_BLOCKS))
+        checkpoint ();
+    }
+
+  committing = false;
+  cond_broadcast (&commit_done, &journal_lock);
+}
+
+/* Writes every sector copy home, all queued at once so that the
+   disk's I/O scheduler can sort them, then empties the log.
+   The caller must hold journal_lock, with nothing running. */
+static void
+checkpoint (void)
+{
+  struct block_request *reqs;
+  struct semaphore done;
+  struct hash_iterator i;
+  size_t n = 0;
+
+  ASSERT (list_empty (&running));
+
+  reqs = malloc (hash_size (&blocks) * sizeof *reqs);
+  sema_init (&done, 0);
+  hash_first (&i, &blocks);
+  while (hash_next (&i))
+    {
+      struct journal_block *b = hash_entry (hash_cur (&i),
+                                            struct journal_block, hash_elem);
+      if (reqs != NULL)
+        {
+          block_request_init (&reqs[n++], true, b->sector, 1, b->data,
+                              block_request_sema_up, &done);
+          block_submit (fs_device, &reqs[n - 1]);
+        }
+      else
+        block_write (fs_device, b->sector, b->data);
+    }
+  while (n-- > 0)
+    sema_down (&done);
+  free (reqs);
+  bc_note_write_back ();
+
+  /* The log may be reused only once the superblock no longer
+     points into it, and that only once its contents are home. */
+  flush_device ();
+  super.seq = seq;
+  block_write (fs_device, JOURNAL_SECTOR, &super);
+  flush_device ();
+  head = 0;
+  hash_clear (&blocks, block_free);
+}
+
+/* Returns true if a transaction later than SEQ in REVOKES
+   revoked SECTOR. */
+static bool
+revoked_after (struct list *revokes, block_sector_t sector, uint32_t seq)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (revokes); e != list_end (revokes); e = list_next (e))
+    {
+      struct revoke *r = list_entry (e, struct revoke, elem);
+      if (r->sector == sector && r->seq > seq)
+        return true;
+    }
+  return false;
+}
+
+/* Reads the transaction numbered SEQ that starts at log sector
+   POS.  If APPLY is false, adds its revoke records to REVOKES.
+   If APPLY is true, writes home each sector it logged that no
+   later transaction in REVOKES revoked, adding the number
+   written to *APPLIED.  Returns the log sector after its commit
+   record, or 0 if it is not complete. */
+static uint32_t
+scan_transaction (uint32_t pos, uint32_t seq, struct list *revokes,
+                  bool apply, size_t *applied)
+{
+  struct journal_header h;
+  uint8_t data[BLOCK_SECTOR_SIZE];
+  size_t i;
+
+  for (;;)
+    {
+      if (pos >= super.size)
+        return 0;
+      block_read (fs_device, super.start + pos++, &h);
+      if (h.seq != seq)
+        return 0;
+      if (h.magic == COMMIT_MAGIC)
+        return pos;
+      if (h.magic != DESC_MAGIC
+          || h.cnt + h.revoke_cnt > DESC_TAGS
+          || h.cnt > super.size - pos)
+        return 0;
+
+      for (i = 0; i < h.cnt; i++, pos++)
+        if (apply && !revoked_after (revokes, h.tags[i], seq))
+          {
+            block_read (fs_device, super.start + pos, data);
+            block_write (fs_device, h.tags[i], data);
+            (*applied)++;
+          }
+      for (; !apply && i < h.cnt + h.revoke_cnt; i++)
+        {
+          struct revoke *r = malloc (sizeof *r);
+          if (r == NULL)
+            PANIC ("journal: out of memory");
+          r->sector = h.tags[i];
+          r->seq = seq;
+          list_push_back (revokes, &r->elem);
+        }
+    }
+}
+
+/* Writes home the sectors logged by every transaction committed
+   since the last checkpoint, then empties the log. */
+static void
+replay (void)
+{
+  struct list revokes;
+  uint32_t pos, txn_cnt, i;
+  size_t applied = 0;
+
+  /* First find the committed transactions and what they revoked,
+     then apply them in order. */
+  list_init (&revokes);
+  for (pos = 0, txn_cnt = 0;
+       (pos = scan_transaction (pos, super.seq + txn_cnt, &revokes,
+                                false, NULL)) != 0;
+       txn_cnt++)
+    continue;
+  for (pos = 0, i = 0; i < txn_cnt; i++)
+    pos = scan_transaction (pos, super.seq + i, &revokes, true, &applied);
+  while (!list_empty (&revokes))
+    free (list_entry (list_pop_front (&revokes), struct revoke, elem));
+
+  if (txn_cnt > 0)
+    printf ("journal: replayed %"PRIu32" transactions, %zu sectors.\n",
+            txn_cnt, applied);
+  if (txn_cnt > 0)
+    flush_device ();
+  super.seq += txn_cnt;
+  block_write (fs_device, JOURNAL_SECTOR, &super);
+  flush_device ();
+  seq = super.seq;
+  head = 0;
+}
+
+/* Work function that commits the running transaction every
+   COMMIT_INTERVAL ticks, so that no operation waits longer than
+   that to be durable. */
+static void
+commit_periodically (void *aux UNUSED)
+{
+  journal_commit ();
+  work_queue_delayed (&system_wq, &commit_work, COMMIT_INTERVAL);
+}
@@ -0,0 +1,28 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Sector of the journal superblock. */
+#define JOURNAL_SECTOR 2
+
+void journal_create (void);
+void journal_init (void);
+void journal_done (void);
+
+/* Transactions. */
+void journal_begin (void);
+void journal_end (void);
+bool journal_commit (void);
+bool journal_sync (bool commit_running);
+
+/* Hooks for the buffer cache and the free map. */
+void journal_write (block_sector_t, const void *);
+void journal_revoke (block_sector_t, size_t cnt);
+bool journal_absorb (block_sector_t, const void *);
+bool journal_read (block_sector_t, void *);
+bool journal_holds (block_sector_t);
+
+#endif /* filesys/journal.h */
@@ -0,0 +1,35 @@
+#ifndef __LIB_IOSTAT_H
+#define __LIB_IOSTAT_H
+
+/* Block device I/O statistics, as kept by the kernel's block
+   layer and returned to user programs by the iostat system
+   call. */
+
+/* Number of buckets in a latency histogram.  Bucket 0 counts
+   latencies under 2 us; bucket B > 0 counts latencies from
+   2**B us up to 2**(B+1) us, except that the last bucket also
+   counts anything longer. */
+#define IOSTAT_BUCKETS 24
+
+/* Transfer directions. */
+enum iostat_dir
+  {
+    IOSTAT_READ,                /* Device to memory. */
+    IOSTAT_WRITE,               /* Memory to device. */
+    IOSTAT_DIR_CNT
+  };
+
+/* Statistics for one block device or role. */
+struct iostat
+  {
+    unsigned long long requests[IOSTAT_DIR_CNT];  /* Completed requests. */
+    unsigned long long bytes[IOSTAT_DIR_CNT];     /* Bytes transferred. */
+
+    /* Histograms of the time requests spent queued, from
+       submission until the driver was handed them, and then in
+       service, until the driver finished them. */
+    unsigned long long wait[IOSTAT_DIR_CNT][IOSTAT_BUCKETS];
+    unsigned long long service[IOSTAT_DIR_CNT][IOSTAT_BUCKETS];
+  };
+
+#endif /* lib/iostat.h */
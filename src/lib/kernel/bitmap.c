@@ -358,6 +358,46 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Reads bytes OFS through OFS + SIZE of B's file image from
+   FILE, where the image starts at FILE_OFS within FILE.  SIZE is
+   trimmed to the end of the image.  Returns true if successful,
+   false otherwise. */
+bool
+bitmap_read_part (struct bitmap *b, struct file *file, off_t file_ofs,
+                  size_t ofs, size_t size) 
+{
+  size_t total = byte_cnt (b->bit_cnt);
+  bool success;
+
+  if (ofs >= total)
+    return true;
+  if (size > total - ofs)
+    size = total - ofs;
+  success = file_read_at (file, (uint8_t *) b->bits + ofs, size,
+                          file_ofs + ofs) == (off_t) size;
+  if (ofs + size == total)
+    b->bits[elem_cnt (b->bit_cnt) - 1] &= last_mask (b);
+  return success;
+}
+
+/* Writes bytes OFS through OFS + SIZE of B's file image to
+   FILE, where the image starts at FILE_OFS within FILE.  SIZE is
+   trimmed to the end of the image.  Returns true if successful,
+   false otherwise. */
+bool
+bitmap_write_part (const struct bitmap *b, struct file *file,
+                   off_t file_ofs, size_t ofs, size_t size) 
+{
+  size_t total = byte_cnt (b->bit_cnt);
+
+  if (ofs >= total)
+    return true;
+  if (size > total - ofs)
+    size = total - ofs;
+  return file_write_at (file, (const uint8_t *) b->bits + ofs, size,
+                        file_ofs + ofs) == (off_t) size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
@@ -0,0 +1,20 @@
+#ifndef __LIB_SCHEDSTAT_H
+#define __LIB_SCHEDSTAT_H
+
+/* Scheduler statistics for one thread, as kept by the kernel's
+   scheduler and returned to user programs by the schedstat
+   system call.  Times are in microseconds. */
+struct schedstat
+  {
+    long long run_time;                 /* Time spent running. */
+    long long wait_time;                /* Time spent in a run queue. */
+    unsigned long long voluntary;       /* Switches away to block. */
+    unsigned long long involuntary;     /* Switches away while ready. */
+
+    /* Wakeups, and the time from each until the thread ran. */
+    unsigned long long wakeups;
+    long long wakeup_latency;           /* Total over all wakeups. */
+    long long wakeup_latency_max;       /* Longest of them. */
+  };
+
+#endif /* lib/schedstat.h */
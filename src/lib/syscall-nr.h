@@ -31,7 +31,18 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+    SYS_IOSTAT,                 /* Obtain block device I/O statistics. */
+    SYS_FSYNC,                  /* Make a file's data and metadata durable. */
+    SYS_FDATASYNC,              /* Make a file's data durable. */
+
+    /* Real-time scheduling. */
+    SYS_RESERVE,                /* Reserve CPU time in each period. */
+    SYS_NEXT_PERIOD,            /* Wait for the next period. */
+    SYS_SCHEDSTAT,              /* Obtain a process's scheduler statistics. */
+
+    /* Long file names. */
+    SYS_READDIR_NAME            /* Reads a directory entry's full name. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -186,6 +186,12 @@ readdir (int fd, char name[READDIR_MAX_LEN + 1])
   return syscall2 (SYS_READDIR, fd, name);
 }
 
+int
+readdir_name (int fd, char *name, size_t size)
+{
+  return syscall3 (SYS_READDIR_NAME, fd, name, size);
+}
+
 bool
 isdir (int fd) 
 {
@@ -197,3 +203,39 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+bool
+iostat (const char *name, struct iostat *stats)
+{
+  return syscall2 (SYS_IOSTAT, name, stats);
+}
+
+bool
+fsync (int fd)
+{
+  return syscall1 (SYS_FSYNC, fd);
+}
+
+bool
+fdatasync (int fd)
+{
+  return syscall1 (SYS_FDATASYNC, fd);
+}
+
+bool
+reserve (int period, int budget)
+{
+  return syscall2 (SYS_RESERVE, period, budget);
+}
+
+int
+next_period (void)
+{
+  return syscall0 (SYS_NEXT_PERIOD);
+}
+
+bool
+schedstat (pid_t pid, struct schedstat *stats)
+{
+  return syscall2 (SYS_SCHEDSTAT, pid, stats);
+}
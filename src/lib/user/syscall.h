@@ -2,7 +2,10 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <debug.h>
+#include <iostat.h>
+#include <schedstat.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -15,6 +18,10 @@ typedef int mapid_t;
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
+/* Maximum characters in a file name, which readdir_name()
+   returns in full. */
+#define NAME_MAX 255
+
 /* Typical return values from main() and arguments to exit(). */
 #define EXIT_SUCCESS 0          /* Successful execution. */
 #define EXIT_FAILURE 1          /* Unsuccessful execution. */
@@ -48,7 +55,16 @@ void munmap (mapid_t);
 bool chdir (const char *dir);
 bool mkdir (const char *dir);
 bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
+int readdir_name (int fd, char *name, size_t size);
 bool isdir (int fd);
 int inumber (int fd);
+bool iostat (const char *name, struct iostat *);
+bool fsync (int fd);
+bool fdatasync (int fd);
+
+/* Real-time scheduling.  Times are in timer ticks. */
+bool reserve (int period, int budget);
+int next_period (void);
+bool schedstat (pid_t, struct schedstat *);
 
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($fs);
+$fs->{'d'}{"file$_"} = [''] foreach 0...9;
+check_archive ($fs);
+pass;
@@ -0,0 +1,168 @@
+/* Runs with the file system formatted with compact directories
+   (-dirfmt=compact).  Creates enough files with names too long
+   for a fixed-format entry to spread a directory over several
+   sectors, then looks them up, lists them with readdir_name(),
+   and removes them, checking after each step that the directory
+   holds exactly the files it should, under their full names.
+   Also checks that readdir_name() refuses a buffer too small for
+   a name without losing the entry.  Finally refills the freed
+   records with short names, which the persistence check expects
+   to find. */
+
+#include <string.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 40
+#define SHORT_CNT 10
+
+/* Makes each name longer than a fixed-format entry can hold, so
+   that creating the files at all shows the format is compact. */
+#define LONG_SUFFIX "-has-a-name-too-long-for-a-fixed-entry"
+
+/* Stores the full path of long-named file I in NAME. */
+static void
+make_name (char *name, size_t size, int i)
+{
+  snprintf (name, size, "/d/long%02d" LONG_SUFFIX, i);
+}
+
+/* Checks that "/d" holds just the long-named files I for which
+   PRESENT[I] is true, first by opening every file by name and
+   then by listing the directory. */
+static void
+check_dir (const bool present[FILE_CNT])
+{
+  char entry[NAME_MAX + 1];
+  bool seen[FILE_CNT];
+  char name[128];
+  int fd, i, len;
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      make_name (name, sizeof name, i);
+      fd = open (name);
+      if (present[i] && fd < 0)
+        fail ("open \"%s\" failed", name);
+      if (!present[i] && fd >= 0)
+        fail ("open \"%s\" succeeded after remove", name);
+      if (fd >= 0)
+        close (fd);
+      seen[i] = false;
+    }
+
+  fd = open ("/d");
+  if (fd < 0)
+    fail ("open \"/d\" failed");
+  while ((len = readdir_name (fd, entry, sizeof entry)) > 0)
+    {
+      if ((size_t) len != strlen (entry))
+        fail ("readdir_name returned length %d for \"%s\"", len, entry);
+      for (i = 0; i < FILE_CNT; i++)
+        {
+          make_name (name, sizeof name, i);
+          if (!strcmp (entry, name + strlen ("/d/")))
+            break;
+        }
+      if (i == FILE_CNT)
+        fail ("readdir returned unexpected \"%s\"", entry);
+      if (!present[i])
+        fail ("readdir returned removed \"%s\"", entry);
+      if (seen[i])
+        fail ("readdir returned \"%s\" twice", entry);
+      seen[i] = true;
+    }
+  if (len < 0)
+    fail ("readdir_name failed with a %zu-byte buffer", sizeof entry);
+  close (fd);
+
+  for (i = 0; i < FILE_CNT; i++)
+    if (present[i] && !seen[i])
+      {
+        make_name (name, sizeof name, i);
+        fail ("readdir did not return \"%s\"", name);
+      }
+}
+
+/* Checks that readdir_name() fails on a buffer one byte short of
+   the first entry in "/d", which is a long name, and that the
+   entry is then returned in full to a buffer that fits. */
+static void
+check_short_buffer (void)
+{
+  char entry[NAME_MAX + 1];
+  char name[128];
+  int fd, len;
+
+  fd = open ("/d");
+  if (fd < 0)
+    fail ("open \"/d\" failed");
+  len = readdir_name (fd, entry, sizeof entry);
+  if (len <= 0)
+    fail ("readdir_name of \"/d\" failed");
+  close (fd);
+
+  fd = open ("/d");
+  if (readdir_name (fd, name, len) != -1)
+    fail ("readdir_name into %d bytes succeeded for %d-character name",
+          len, len);
+  if (readdir_name (fd, name, sizeof name) != len || strcmp (name, entry))
+    fail ("readdir_name did not return \"%s\" after a short buffer",
+          entry);
+  close (fd);
+  msg ("readdir_name refused a short buffer and kept the entry");
+}
+
+void
+test_main (void)
+{
+  bool present[FILE_CNT];
+  char name[128];
+  int i;
+
+  CHECK (mkdir ("/d"), "mkdir \"/d\"");
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      make_name (name, sizeof name, i);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+      present[i] = true;
+    }
+  msg ("created %d files with %zu-character names",
+       FILE_CNT, strlen (name) - strlen ("/d/"));
+  check_dir (present);
+  msg ("looked up and listed each file");
+  check_short_buffer ();
+
+  for (i = 0; i < FILE_CNT; i += 2)
+    {
+      make_name (name, sizeof name, i);
+      if (!remove (name))
+        fail ("remove \"%s\" failed", name);
+      present[i] = false;
+    }
+  msg ("removed every other file");
+  check_dir (present);
+  msg ("looked up and listed the remaining files");
+
+  for (i = 1; i < FILE_CNT; i += 2)
+    {
+      make_name (name, sizeof name, i);
+      if (!remove (name))
+        fail ("remove \"%s\" failed", name);
+      present[i] = false;
+    }
+  msg ("removed the rest");
+  check_dir (present);
+  msg ("directory is empty");
+
+  for (i = 0; i < SHORT_CNT; i++)
+    {
+      snprintf (name, sizeof name, "/d/file%d", i);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+    }
+  msg ("created %d files with short names", SHORT_CNT);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-compact) begin
+(dir-compact) mkdir "/d"
+(dir-compact) created 40 files with 44-character names
+(dir-compact) looked up and listed each file
+(dir-compact) readdir_name refused a short buffer and kept the entry
+(dir-compact) removed every other file
+(dir-compact) looked up and listed the remaining files
+(dir-compact) removed the rest
+(dir-compact) directory is empty
+(dir-compact) created 10 files with short names
+(dir-compact) end
+EOF
+pass;
@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($fs);
+$fs->{'big'}{"f$_"} = ["\0" x ($_ * 13)] foreach 0...99;
+check_archive ($fs);
+pass;
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-ls-compact) begin
+(dir-ls-compact) mkdir "/big"
+(dir-ls-compact) created 100 files
+(dir-ls-compact) listed and checked 100 files
+(dir-ls-compact) end
+EOF
+pass;
@@ -0,0 +1,7 @@
+/* Lists a directory of 100 files formatted as fixed entries,
+   opening each entry as readdir() returns it, and checks that
+   every file turns up once with the right size and its own
+   inode.  Covers dir_readdir()'s read-ahead of the inodes of
+   the entries that follow the one it returns. */
+
+#include "tests/filesys/extended/dir-ls.inc"
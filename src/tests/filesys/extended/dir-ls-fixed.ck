@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-ls-fixed) begin
+(dir-ls-fixed) mkdir "/big"
+(dir-ls-fixed) created 100 files
+(dir-ls-fixed) listed and checked 100 files
+(dir-ls-fixed) end
+EOF
+pass;
@@ -0,0 +1,49 @@
+/* Appends records to a file as a logging workload would,
+   calling fsync() or fdatasync() after each one, and checks that
+   every call returns true and writes to the file system device.
+   Also checks that syncing a bad file descriptor fails. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define RECORD_SIZE 512
+#define RECORD_CNT 16
+static char buf[RECORD_SIZE * RECORD_CNT];
+
+void
+test_main (void) 
+{
+  struct iostat before, after;
+  int fd, i;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create ("log", 0), "create \"log\"");
+  CHECK ((fd = open ("log")) > 1, "open \"log\"");
+
+  msg ("appending %d records", RECORD_CNT);
+  for (i = 0; i < RECORD_CNT; i++)
+    {
+      bool data_only = i % 2 != 0;
+
+      if (write (fd, buf + i * RECORD_SIZE, RECORD_SIZE) != RECORD_SIZE)
+        fail ("write of record %d failed", i);
+      if (!iostat ("filesys", &before))
+        fail ("iostat failed");
+      if (!(data_only ? fdatasync (fd) : fsync (fd)))
+        fail ("%s after record %d failed",
+              data_only ? "fdatasync" : "fsync", i);
+      if (!iostat ("filesys", &after))
+        fail ("iostat failed");
+      if (after.requests[IOSTAT_WRITE] == before.requests[IOSTAT_WRITE])
+        fail ("%s after record %d wrote nothing",
+              data_only ? "fdatasync" : "fsync", i);
+    }
+  msg ("every sync wrote to disk");
+
+  CHECK (!fsync (fd + 1), "fsync bad fd (must return false)");
+  CHECK (!fdatasync (fd + 1), "fdatasync bad fd (must return false)");
+  msg ("close \"log\"");
+  close (fd);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fsync-log) begin
+(fsync-log) create "log"
+(fsync-log) open "log"
+(fsync-log) appending 16 records
+(fsync-log) every sync wrote to disk
+(fsync-log) fsync bad fd (must return false)
+(fsync-log) fdatasync bad fd (must return false)
+(fsync-log) close "log"
+(fsync-log) end
+EOF
+pass;
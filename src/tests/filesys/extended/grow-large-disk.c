@@ -0,0 +1,100 @@
+/* Fills most of a disk of several hundred megabytes with files
+   of the maximum size, so that inodes and data blocks land far
+   beyond the first 4,096 sectors, and checks that every file
+   reads back correctly.  A small file created last, at the far
+   end of the disk, is left behind for the persistence check. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Number of large files and the size of each.  The file size is
+   just under the largest file an inode can map, and FILE_CNT of
+   them cover most of the 320 MB disk this test is run on. */
+#define FILE_CNT 32
+#define FILE_SIZE (8 * 1024 * 1024)
+
+/* First sector past the old limit on inode sectors. */
+#define OLD_SECTOR_LIMIT 4096
+
+static char buf[512];
+
+static void
+make_name (char *name, int i)
+{
+  snprintf (name, 16, "big%02d", i);
+}
+
+void
+test_main (void) 
+{
+  char name[16];
+  int last_inumber = 0;
+  int fd;
+  int i;
+
+  msg ("creating %d files of %d bytes", FILE_CNT, FILE_SIZE);
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      make_name (name, i);
+      CHECK (create (name, 0), "create \"%s\"", name);
+      CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+      seek (fd, FILE_SIZE - sizeof name);
+      CHECK (write (fd, name, sizeof name) == (int) sizeof name,
+             "write \"%s\"", name);
+      close (fd);
+    }
+  quiet = false;
+
+  msg ("verifying files");
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      size_t j;
+
+      make_name (name, i);
+      CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+      CHECK (filesize (fd) == FILE_SIZE, "filesize \"%s\"", name);
+      last_inumber = inumber (fd);
+
+      /* The middle of the file was never written, so it must read
+         back as zeros; the stamp at the end must be intact. */
+      seek (fd, FILE_SIZE / 2);
+      CHECK (read (fd, buf, sizeof buf) == (int) sizeof buf,
+             "read middle of \"%s\"", name);
+      for (j = 0; j < sizeof buf; j++)
+        if (buf[j] != 0)
+          fail ("byte %zu in middle of \"%s\" is %d, not 0",
+                FILE_SIZE / 2 + j, name, buf[j]);
+      seek (fd, FILE_SIZE - sizeof name);
+      CHECK (read (fd, buf, sizeof name) == (int) sizeof name,
+             "read end of \"%s\"", name);
+      if (memcmp (buf, name, sizeof name))
+        fail ("stamp at end of \"%s\" is wrong", name);
+      close (fd);
+    }
+  quiet = false;
+
+  if (last_inumber <= OLD_SECTOR_LIMIT)
+    fail ("last file's inode is sector %d, not beyond %d",
+          last_inumber, OLD_SECTOR_LIMIT);
+  msg ("last file's inode lies beyond sector %d", OLD_SECTOR_LIMIT);
+
+  CHECK (create ("tail", 0), "create \"tail\"");
+  CHECK ((fd = open ("tail")) > 1, "open \"tail\"");
+  CHECK (write (fd, "large disk\n", 11) == 11, "write \"tail\"");
+  msg ("close \"tail\"");
+  close (fd);
+
+  msg ("removing large files");
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      make_name (name, i);
+      CHECK (remove (name), "remove \"%s\"", name);
+    }
+  quiet = false;
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-large-disk) begin
+(grow-large-disk) creating 32 files of 8388608 bytes
+(grow-large-disk) verifying files
+(grow-large-disk) last file's inode lies beyond sector 4096
+(grow-large-disk) create "tail"
+(grow-large-disk) open "tail"
+(grow-large-disk) write "tail"
+(grow-large-disk) close "tail"
+(grow-large-disk) removing large files
+(grow-large-disk) end
+EOF
+pass;
@@ -0,0 +1,59 @@
+/* Writes a file larger than the buffer cache and reads it back,
+   then checks that iostat() counted disk reads and writes for
+   the file system device and that every request appears once
+   in each latency histogram. */
+
+#include <syscall.h>
+#include "tests/filesys/seq-test.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define TEST_SIZE 72943
+static char buf[TEST_SIZE];
+
+static size_t
+return_block_size (void) 
+{
+  return 4096;
+}
+
+/* Returns the total count in histogram HIST. */
+static unsigned long long
+hist_sum (const unsigned long long hist[IOSTAT_BUCKETS])
+{
+  unsigned long long sum = 0;
+  int i;
+
+  for (i = 0; i < IOSTAT_BUCKETS; i++)
+    sum += hist[i];
+  return sum;
+}
+
+void
+test_main (void) 
+{
+  static const char *dir_names[IOSTAT_DIR_CNT] = {"read", "write"};
+  struct iostat before, after;
+  int dir;
+
+  CHECK (iostat ("filesys", &before), "iostat \"filesys\"");
+  CHECK (!iostat ("no-such-device", &after),
+         "iostat \"no-such-device\" (must return false)");
+
+  seq_test ("testme", buf, sizeof buf, 0, return_block_size, NULL);
+
+  CHECK (iostat ("filesys", &after), "iostat \"filesys\" again");
+  for (dir = 0; dir < IOSTAT_DIR_CNT; dir++)
+    {
+      if (after.requests[dir] <= before.requests[dir])
+        fail ("no %s requests counted", dir_names[dir]);
+      if (after.bytes[dir] - before.bytes[dir]
+          < (after.requests[dir] - before.requests[dir]) * 512)
+        fail ("fewer %s bytes than requests", dir_names[dir]);
+      if (hist_sum (after.wait[dir]) != after.requests[dir]
+          || hist_sum (after.service[dir]) != after.requests[dir])
+        fail ("%s histograms do not match request count",
+              dir_names[dir]);
+    }
+  msg ("request counts and histograms are consistent");
+}
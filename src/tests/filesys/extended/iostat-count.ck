@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(iostat-count) begin
+(iostat-count) iostat "filesys"
+(iostat-count) iostat "no-such-device" (must return false)
+(iostat-count) create "testme"
+(iostat-count) open "testme"
+(iostat-count) writing "testme"
+(iostat-count) close "testme"
+(iostat-count) open "testme" for verification
+(iostat-count) verified contents of "testme"
+(iostat-count) close "testme"
+(iostat-count) iostat "filesys" again
+(iostat-count) request counts and histograms are consistent
+(iostat-count) end
+EOF
+pass;
@@ -0,0 +1,123 @@
+/* A PRI_MIN thread acquires filesys_lock, which serializes the
+   file system system calls, and then computes for HOLD_TICKS
+   ticks while SPINNER_CNT threads compute at the default
+   priority.  A PRI_MAX thread then blocks acquiring
+   filesys_lock, as a high-priority process's system call would.
+   Its donation lifts the holder above the compute threads, so it
+   should get the lock within the holder's HOLD_TICKS ticks;
+   without donation, the compute threads would starve the holder,
+   and the PRI_MAX thread with it.  Fails if the PRI_MAX thread
+   waits longer than the holder could have kept the lock. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/kernel/tests.h"
+#include "threads/bench.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/syscall.h"
+#include "devices/timer.h"
+
+/* Compute threads run beside the lock holder. */
+#define SPINNER_CNT 4
+
+/* Ticks for which the holder computes with the lock held. */
+#define HOLD_TICKS 10
+
+/* How long to wait for the PRI_MAX thread before giving up. */
+#define TIMEOUT_TICKS (10 * TIMER_FREQ)
+
+struct bound_info
+  {
+    struct semaphore held;      /* Up'd once the holder has the lock. */
+    struct semaphore acquired;  /* Up'd once the contender got it. */
+    struct semaphore done;      /* Up'd as each of them exits. */
+    int64_t wait_us;            /* Contender's wait for the lock. */
+  };
+
+static thread_func holder_thread_func;
+static thread_func contender_thread_func;
+
+void
+test_priority_donate_fslock (void)
+{
+  /* The holder keeps the lock for between HOLD_TICKS - 1 and
+     HOLD_TICKS ticks; allow one more for the switches. */
+  int64_t bound_us = (HOLD_TICKS + 1) * 1000000LL / TIMER_FREQ;
+  struct spinner spinners[SPINNER_CNT];
+  struct bound_info info;
+  int64_t start;
+  bool acquired;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  sema_init (&info.held, 0);
+  sema_init (&info.acquired, 0);
+  sema_init (&info.done, 0);
+  thread_create ("holder", PRI_MIN, holder_thread_func, &info);
+  sema_down (&info.held);
+  msg ("holder has filesys_lock.");
+
+  for (i = 0; i < SPINNER_CNT; i++)
+    if (!spinner_start (&spinners[i], PRI_DEFAULT))
+      fail ("could not start compute thread %d", i);
+  msg ("%d compute threads are running.", SPINNER_CNT);
+  thread_create ("contender", PRI_MAX, contender_thread_func, &info);
+
+  /* Poll rather than wait, so that the compute threads are
+     stopped even if the contender never gets the lock. */
+  start = timer_ticks ();
+  while (!(acquired = sema_try_down (&info.acquired))
+         && timer_elapsed (start) < TIMEOUT_TICKS)
+    timer_sleep (1);
+  for (i = 0; i < SPINNER_CNT; i++)
+    spinner_stop (&spinners[i]);
+  if (!acquired)
+    fail ("contender did not get filesys_lock within %d ticks",
+          TIMEOUT_TICKS);
+  sema_down (&info.done);
+  sema_down (&info.done);
+
+  if (info.wait_us > bound_us)
+    fail ("contender waited %"PRId64" us for filesys_lock, "
+          "more than the %"PRId64" us bound", info.wait_us, bound_us);
+  msg ("contender got filesys_lock within the holder's hold time.");
+}
+
+/* Acquires filesys_lock and keeps it while computing for
+   HOLD_TICKS ticks, like a low-priority process in a long file
+   system call. */
+static void
+holder_thread_func (void *info_)
+{
+  struct bound_info *info = info_;
+  int64_t start;
+
+  lock_acquire (&filesys_lock);
+  sema_up (&info->held);
+  start = timer_ticks ();
+  while (timer_elapsed (start) < HOLD_TICKS)
+    continue;
+  lock_release (&filesys_lock);
+  sema_up (&info->done);
+}
+
+/* Times how long it takes to acquire filesys_lock. */
+static void
+contender_thread_func (void *info_)
+{
+  struct bound_info *info = info_;
+  int64_t start = timer_usec ();
+
+  lock_acquire (&filesys_lock);
+  info->wait_us = timer_usec () - start;
+  lock_release (&filesys_lock);
+  sema_up (&info->acquired);
+  sema_up (&info->done);
+}
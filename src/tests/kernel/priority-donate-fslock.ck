@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-fslock) begin
+(priority-donate-fslock) holder has filesys_lock.
+(priority-donate-fslock) 4 compute threads are running.
+(priority-donate-fslock) contender got filesys_lock within the holder's hold time.
+(priority-donate-fslock) end
+EOF
+pass;
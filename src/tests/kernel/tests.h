@@ -0,0 +1,15 @@
+#ifndef TESTS_KERNEL_TESTS_H
+#define TESTS_KERNEL_TESTS_H
+
+void run_kernel_test (const char *);
+
+typedef void test_func (void);
+
+extern test_func test_priority_donate_fslock;
+extern test_func test_workqueue;
+
+void msg (const char *, ...);
+void fail (const char *, ...);
+void pass (void);
+
+#endif /* tests/kernel/tests.h */
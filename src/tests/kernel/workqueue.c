@@ -0,0 +1,188 @@
+/* Exercises a private workqueue with one worker: queues work
+   and flushes it, queues it again while it is pending, cancels
+   pending and delayed work, and cancels running work and work
+   that queues itself again.  Checks that work_flush() and
+   work_cancel_sync() return only once the work function has
+   finished, that cancelled work never runs, and that the worker
+   keeps running work after a cancel leaves an extra up on its
+   semaphore. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/kernel/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+/* Ticks a slow work function sleeps for. */
+#define SLOW_TICKS 5
+
+/* Ticks delayed work waits before it is due. */
+#define DELAY_TICKS 10
+
+/* Times self-queueing work queues itself again, at most. */
+#define REQUEUE_CNT 1000
+
+struct counter
+  {
+    struct work work;
+    int runs;                   /* Calls so far. */
+    bool finished;              /* Did the last call return? */
+    struct semaphore started;   /* Up'd as each call starts. */
+  };
+
+static struct workqueue test_wq;
+
+/* Holds the worker until `gate' is up'd, so that work queued
+   behind it stays pending. */
+static struct work gate_work;
+static struct semaphore gate;
+static struct semaphore gate_entered;
+
+static void
+gate_func (void *aux UNUSED)
+{
+  sema_up (&gate_entered);
+  sema_down (&gate);
+}
+
+/* Blocks the worker behind gate_work. */
+static void
+close_gate (void)
+{
+  work_queue (&test_wq, &gate_work);
+  sema_down (&gate_entered);
+}
+
+/* Counts a call, sleeping first to make it take a while. */
+static void
+slow_func (void *c_)
+{
+  struct counter *c = c_;
+
+  c->finished = false;
+  c->runs++;
+  sema_up (&c->started);
+  timer_sleep (SLOW_TICKS);
+  c->finished = true;
+}
+
+/* Counts a call and queues itself again. */
+static void
+requeue_func (void *c_)
+{
+  struct counter *c = c_;
+
+  if (c->runs++ < REQUEUE_CNT)
+    work_queue (&test_wq, &c->work);
+}
+
+static void
+counter_init (struct counter *c, work_func *func)
+{
+  work_init (&c->work, func, c);
+  c->runs = 0;
+  c->finished = false;
+  sema_init (&c->started, 0);
+}
+
+void
+test_workqueue (void)
+{
+  struct counter c;
+  int64_t start;
+  int runs;
+
+  workqueue_init (&test_wq, "testwq", 1, PRI_DEFAULT);
+  work_init (&gate_work, gate_func, NULL);
+  sema_init (&gate, 0);
+  sema_init (&gate_entered, 0);
+
+  /* Queue and flush. */
+  counter_init (&c, slow_func);
+  if (!work_queue (&test_wq, &c.work))
+    fail ("work_queue of idle work returned false");
+  work_flush (&c.work);
+  if (c.runs != 1 || !c.finished)
+    fail ("work_flush returned before the work finished");
+  msg ("work_flush waited for queued work to finish.");
+
+  /* Queue work that is already pending. */
+  close_gate ();
+  counter_init (&c, slow_func);
+  work_queue (&test_wq, &c.work);
+  if (!work_pending (&c.work))
+    fail ("queued work is not pending");
+  if (work_queue (&test_wq, &c.work))
+    fail ("work_queue of pending work returned true");
+  sema_up (&gate);
+  work_flush (&c.work);
+  if (c.runs != 1)
+    fail ("work queued twice ran %d times", c.runs);
+  msg ("work queued while pending ran once.");
+
+  /* Cancel pending work, then check that the worker skips the
+     extra up the cancel leaves and still runs new work. */
+  close_gate ();
+  counter_init (&c, slow_func);
+  work_queue (&test_wq, &c.work);
+  if (!work_cancel (&c.work))
+    fail ("work_cancel of pending work returned false");
+  if (work_pending (&c.work))
+    fail ("cancelled work is still pending");
+  sema_up (&gate);
+  workqueue_flush (&test_wq);
+  if (c.runs != 0)
+    fail ("cancelled work ran");
+  work_queue (&test_wq, &c.work);
+  work_flush (&c.work);
+  if (c.runs != 1 || !c.finished)
+    fail ("work queued after a cancel did not run");
+  msg ("cancelled work did not run, and later work did.");
+
+  /* Delayed work runs once due, and work_flush() waits for it. */
+  counter_init (&c, slow_func);
+  start = timer_ticks ();
+  work_queue_delayed (&test_wq, &c.work, DELAY_TICKS);
+  work_flush (&c.work);
+  if (c.runs != 1 || !c.finished)
+    fail ("work_flush returned before delayed work finished");
+  if (timer_elapsed (start) < DELAY_TICKS)
+    fail ("delayed work ran after %"PRId64" of %d ticks",
+          timer_elapsed (start), DELAY_TICKS);
+  msg ("delayed work ran once due.");
+
+  /* Cancelled delayed work never runs. */
+  counter_init (&c, slow_func);
+  work_queue_delayed (&test_wq, &c.work, DELAY_TICKS);
+  if (!work_cancel (&c.work))
+    fail ("work_cancel of delayed work returned false");
+  timer_sleep (2 * DELAY_TICKS);
+  workqueue_flush (&test_wq);
+  if (c.runs != 0)
+    fail ("cancelled delayed work ran");
+  msg ("cancelled delayed work did not run.");
+
+  /* work_cancel_sync() of running work waits for it. */
+  counter_init (&c, slow_func);
+  work_queue (&test_wq, &c.work);
+  sema_down (&c.started);
+  if (work_cancel_sync (&c.work))
+    fail ("work_cancel_sync of running work returned true");
+  if (!c.finished)
+    fail ("work_cancel_sync returned before running work finished");
+  msg ("work_cancel_sync waited for running work to finish.");
+
+  /* work_cancel_sync() of work that queues itself stops it. */
+  counter_init (&c, requeue_func);
+  work_queue (&test_wq, &c.work);
+  work_cancel_sync (&c.work);
+  if (work_pending (&c.work))
+    fail ("work_cancel_sync left self-queueing work pending");
+  runs = c.runs;
+  timer_sleep (SLOW_TICKS);
+  if (c.runs != runs)
+    fail ("self-queueing work ran after work_cancel_sync");
+  msg ("work_cancel_sync stopped self-queueing work.");
+}
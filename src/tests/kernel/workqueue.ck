@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue) begin
+(workqueue) work_flush waited for queued work to finish.
+(workqueue) work queued while pending ran once.
+(workqueue) cancelled work did not run, and later work did.
+(workqueue) delayed work ran once due.
+(workqueue) cancelled delayed work did not run.
+(workqueue) work_cancel_sync waited for running work to finish.
+(workqueue) work_cancel_sync stopped self-queueing work.
+(workqueue) end
+EOF
+pass;
@@ -0,0 +1,13 @@
+/* Child process for edf-hog.
+   Spins forever, so that it is always ready to run.  It is
+   still spinning when its parent exits, which ends the test. */
+
+#include "tests/lib.h"
+
+int
+main (void) 
+{
+  test_name = "child-hog";
+  for (;;)
+    continue;
+}
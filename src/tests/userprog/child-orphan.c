@@ -0,0 +1,17 @@
+/* Child process for exec-orphans.
+   Without arguments, starts a copy of itself that it never waits
+   for, then exits.  With any argument, just exits. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+
+int
+main (int argc, const char *argv[] UNUSED) 
+{
+  test_name = "child-orphan";
+  quiet = true;
+
+  if (argc == 1)
+    CHECK (exec ("child-orphan x") != -1, "exec \"child-orphan x\"");
+  return 0;
+}
@@ -0,0 +1,20 @@
+/* Child process for smp-spread.
+   Sums the integers below ITERATIONS, to keep a CPU busy for a
+   while, and exits with 42 if the sum comes out right. */
+
+#include "tests/lib.h"
+
+#define ITERATIONS 20000000
+
+int
+main (void) 
+{
+  volatile unsigned sum = 0;
+  unsigned i;
+
+  test_name = "child-spin";
+  for (i = 0; i < ITERATIONS; i++)
+    sum += i;
+  return sum == (unsigned) ((unsigned long long) ITERATIONS
+                            * (ITERATIONS - 1) / 2) ? 42 : 1;
+}
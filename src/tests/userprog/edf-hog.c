@@ -0,0 +1,42 @@
+/* Starts a child that spins forever, then reserves BUDGET ticks
+   of every PERIOD with reserve() and runs a short job in each
+   of JOBS periods.  Without the reservation each job could wait
+   out a whole time slice of the child, as long as PERIOD, and
+   miss its deadline; with it, the job runs as soon as its
+   period begins, so next_period() must report no misses. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PERIOD 4
+#define BUDGET 2
+#define JOBS 50
+
+void
+test_main (void) 
+{
+  int misses = 0;
+  int i;
+
+  CHECK (next_period () == -1, "next_period without a reservation");
+  CHECK (!reserve (PERIOD, PERIOD + 1),
+         "reserve more than the period (must return false)");
+  CHECK (!reserve (PERIOD, PERIOD),
+         "reserve a whole CPU (must return false)");
+  CHECK (exec ("child-hog") != -1, "exec \"child-hog\"");
+  CHECK (reserve (PERIOD, BUDGET), "reserve %d of every %d ticks",
+         BUDGET, PERIOD);
+
+  for (i = 0; i < JOBS; i++)
+    {
+      volatile int spin;
+
+      for (spin = 0; spin < 1000; spin++)
+        continue;
+      misses = next_period ();
+    }
+  if (misses != 0)
+    fail ("%d of %d deadlines missed", misses, JOBS);
+  msg ("no deadlines missed in %d periods", JOBS);
+}
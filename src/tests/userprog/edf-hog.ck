@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(edf-hog) begin
+(edf-hog) next_period without a reservation
+(edf-hog) reserve more than the period (must return false)
+(edf-hog) reserve a whole CPU (must return false)
+(edf-hog) exec "child-hog"
+(edf-hog) reserve 2 of every 4 ticks
+(edf-hog) no deadlines missed in 50 periods
+(edf-hog) end
+EOF
+pass;
@@ -0,0 +1,26 @@
+/* Starts a child CHILD_CNT times and waits for each.  Each child
+   starts a grandchild that nobody waits for, then exits.  Every
+   thread's page must be freed once its process is gone, or the
+   kernel runs out of memory and an exec fails. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 300
+
+void
+test_main (void) 
+{
+  int i;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pid_t pid = exec ("child-orphan");
+      if (pid == -1)
+        fail ("exec \"child-orphan\" #%d failed", i);
+      if (wait (pid) != 0)
+        fail ("wait for child #%d failed", i);
+    }
+  msg ("started and waited for %d children", CHILD_CNT);
+}
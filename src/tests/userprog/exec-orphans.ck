@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(exec-orphans) begin
+(exec-orphans) started and waited for 300 children
+(exec-orphans) end
+EOF
+pass;
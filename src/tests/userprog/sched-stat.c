@@ -0,0 +1,37 @@
+/* Checks that schedstat() keeps count for the calling process:
+   waiting for the next period of an EDF reservation must count
+   as a voluntary switch and a wakeup, and no time may run
+   backward.  Also checks that an unknown process has no
+   statistics. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct schedstat before, after;
+
+  CHECK (schedstat (0, &before), "schedstat");
+  CHECK (!schedstat (12345, &after),
+         "schedstat unknown pid (must return false)");
+
+  CHECK (reserve (10, 1), "reserve 1 of every 10 ticks");
+  CHECK (next_period () == 0, "next_period");
+  CHECK (reserve (0, 0), "cancel reservation");
+
+  CHECK (schedstat (0, &after), "schedstat again");
+  if (after.voluntary <= before.voluntary)
+    fail ("no voluntary switch counted");
+  if (after.wakeups <= before.wakeups)
+    fail ("no wakeup counted");
+  if (after.run_time <= before.run_time
+      || after.wait_time < before.wait_time
+      || after.wakeup_latency < before.wakeup_latency)
+    fail ("times ran backward");
+  if (after.wakeup_latency_max < 0
+      || after.wakeup_latency_max > after.wakeup_latency)
+    fail ("maximum wakeup latency out of range");
+  msg ("switches, wakeups, and times are consistent");
+}
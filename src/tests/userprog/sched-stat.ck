@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sched-stat) begin
+(sched-stat) schedstat
+(sched-stat) schedstat unknown pid (must return false)
+(sched-stat) reserve 1 of every 10 ticks
+(sched-stat) next_period
+(sched-stat) cancel reservation
+(sched-stat) schedstat again
+(sched-stat) switches, wakeups, and times are consistent
+(sched-stat) end
+EOF
+pass;
@@ -0,0 +1,37 @@
+/* Runs with two CPUs (-smp=2).  Starts CHILD_CNT compute-bound
+   children at once and waits for each, checking that every one
+   finished its computation, and that waiting for them counted as
+   switches and wakeups in schedstat().  The check script also
+   requires that the second CPU came up and that the scheduler
+   moved threads between the CPUs. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 4
+
+void
+test_main (void) 
+{
+  pid_t pids[CHILD_CNT];
+  struct schedstat stats;
+  int i;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pids[i] = exec ("child-spin");
+      if (pids[i] == -1)
+        fail ("exec \"child-spin\" #%d failed", i);
+    }
+  msg ("started %d compute-bound children", CHILD_CNT);
+
+  for (i = 0; i < CHILD_CNT; i++)
+    if (wait (pids[i]) != 42)
+      fail ("child #%d did not finish its computation", i);
+  msg ("all children finished");
+
+  CHECK (schedstat (0, &stats), "schedstat");
+  if (stats.voluntary == 0 || stats.wakeups == 0)
+    fail ("waiting for the children counted no switches or wakeups");
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(smp-spread) begin
+(smp-spread) started 4 compute-bound children
+(smp-spread) all children finished
+(smp-spread) schedstat
+(smp-spread) end
+EOF
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "second CPU did not come up\n"
+  if !grep (/^2 CPUs online\.$/, @output);
+
+my ($steals) = 0;
+foreach (@output) {
+    $steals += $1 if /^CPU \d+: (\d+) threads stolen$/;
+}
+fail "no thread moved between CPUs\n" if $steals == 0;
+pass;
@@ -0,0 +1,136 @@
+#include "threads/bench.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+
+/* Wakeups bench_sched() times per probe thread. */
+#define SCHEDBENCH_WAKEUPS 100
+
+/* Most compute threads bench_sched() runs beside it. */
+#define SCHEDBENCH_MAX_SPINNERS 16
+
+/* Spins, counting iterations, until asked to stop. */
+static void
+spin (void *s_)
+{
+  struct spinner *s = s_;
+
+  while (!s->stop)
+    s->spins++;
+  sema_up (&s->done);
+}
+
+/* Starts S spinning in a new thread at PRIORITY.  Returns false
+   if the thread could not be created. */
+bool
+spinner_start (struct spinner *s, int priority)
+{
+  s->stop = false;
+  s->spins = 0;
+  sema_init (&s->done, 0);
+  return thread_create ("spin", priority, spin, s) != TID_ERROR;
+}
+
+/* Returns S's iteration count.  The 64-bit counter is read with
+   interrupts off so the spinner cannot update it halfway. */
+int64_t
+spinner_count (struct spinner *s)
+{
+  enum intr_level old_level = intr_disable ();
+  int64_t spins = s->spins;
+  intr_set_level (old_level);
+  return spins;
+}
+
+/* Stops S and waits for its thread to exit. */
+void
+spinner_stop (struct spinner *s)
+{
+  s->stop = true;
+  sema_down (&s->done);
+}
+
+/* A thread for bench_sched() that sleeps one tick at a time and
+   measures how late it runs after each wakeup. */
+struct probe
+  {
+    int64_t total_us;           /* Sum of wakeup latencies. */
+    int64_t max_us;             /* Largest wakeup latency. */
+    struct semaphore done;      /* Up'd when the thread exits. */
+  };
+
+/* Sleeps SCHEDBENCH_WAKEUPS times, recording in P_ the time from
+   each tick it sleeps until to when the thread runs again. */
+static void
+probe (void *p_)
+{
+  struct probe *p = p_;
+  int i;
+
+  for (i = 0; i < SCHEDBENCH_WAKEUPS; i++)
+    {
+      int64_t due = timer_ticks () + 1;
+      int64_t latency;
+
+      timer_sleep_until (due);
+      latency = timer_usec () - due * 1000000 / TIMER_FREQ;
+      p->total_us += latency;
+      if (latency > p->max_us)
+        p->max_us = latency;
+    }
+  sema_up (&p->done);
+}
+
+/* Runs a probe thread at PRIORITY and prints its latencies. */
+static void
+schedbench_pass (int priority)
+{
+  struct probe p;
+
+  p.total_us = p.max_us = 0;
+  sema_init (&p.done, 0);
+  if (thread_create ("probe", priority, probe, &p) == TID_ERROR)
+    PANIC ("schedbench: thread creation failed");
+  sema_down (&p.done);
+
+  printf ("priority %d: wakeup latency %"PRId64" us average, "
+          "%"PRId64" us worst\n",
+          priority, p.total_us / SCHEDBENCH_WAKEUPS, p.max_us);
+}
+
+/* Starts ARGV[1] compute threads at the default priority, then
+   measures how promptly a thread that sleeps a tick at a time
+   runs after each wakeup, first at the default priority and
+   then at the maximum, at which the block devices' I/O threads
+   and the system workqueue run. */
+void
+bench_sched (char **argv)
+{
+  int spinner_cnt = atoi (argv[1]);
+  struct spinner *spinners;
+  int i;
+
+  if (spinner_cnt < 1 || spinner_cnt > SCHEDBENCH_MAX_SPINNERS)
+    PANIC ("schedbench: compute thread count must be 1 to %d",
+           SCHEDBENCH_MAX_SPINNERS);
+  spinners = malloc (spinner_cnt * sizeof *spinners);
+  if (spinners == NULL)
+    PANIC ("schedbench: out of memory");
+  printf ("Timing wakeups beside %d compute threads...\n", spinner_cnt);
+
+  for (i = 0; i < spinner_cnt; i++)
+    if (!spinner_start (&spinners[i], PRI_DEFAULT))
+      PANIC ("schedbench: thread creation failed");
+
+  schedbench_pass (PRI_DEFAULT);
+  schedbench_pass (PRI_MAX);
+
+  for (i = 0; i < spinner_cnt; i++)
+    spinner_stop (&spinners[i]);
+  free (spinners);
+}
@@ -0,0 +1,25 @@
+#ifndef THREADS_BENCH_H
+#define THREADS_BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/synch.h"
+
+/* A compute-bound thread that counts loop iterations, so that a
+   benchmark can run beside it and see how much of the CPU it
+   leaves over. */
+struct spinner
+  {
+    volatile bool stop;         /* Set to make the thread exit. */
+    volatile int64_t spins;     /* Loop iterations so far. */
+    struct semaphore done;      /* Up'd when the thread exits. */
+  };
+
+bool spinner_start (struct spinner *, int priority);
+int64_t spinner_count (struct spinner *);
+void spinner_stop (struct spinner *);
+
+/* Kernel command line action. */
+void bench_sched (char **argv);
+
+#endif /* threads/bench.h */
@@ -0,0 +1,64 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <list.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/thread.h"
+
+/* Most CPUs that Pintos will run on. */
+#define CPU_MAX 8
+
+/* Number of thread priorities. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+
+/* A CPU.
+
+   Each CPU has its own run queues, from which it picks the
+   threads it runs, and its own idle thread.  A CPU whose run
+   queues are empty steals a thread from another CPU's (see
+   next_thread_to_run() in thread.c).
+
+   All of these members are protected by turning interrupts off,
+   which with more than one CPU also takes the interrupt lock
+   (see interrupt.c). */
+struct cpu
+  {
+    int id;                     /* Index into cpus[]; 0 is the boot CPU. */
+    uint8_t apic_id;            /* Local APIC ID. */
+    bool started;               /* Running threads yet? */
+
+    /* Threads in THREAD_READY state queued on this CPU, with one
+       FIFO queue per priority.  Bit P of ready_bitmap[P / 32] is
+       set if and only if ready_queues[P] is nonempty, so that the
+       highest priority with a ready thread can be found in
+       constant time. */
+    struct list ready_queues[PRI_CNT];
+    uint32_t ready_bitmap[DIV_ROUND_UP (PRI_CNT, 32)];
+    int ready_cnt;              /* Threads in all the run queues. */
+
+    /* Threads with an EDF reservation and budget left, in order
+       of deadline.  They run ahead of all of ready_queues. */
+    struct list edf_queue;
+
+    struct thread *idle_thread; /* Runs when there is nothing else. */
+    struct thread *running;     /* Thread now running. */
+    unsigned thread_ticks;      /* # of timer ticks since last yield. */
+    long long steals;           /* # of threads taken from other CPUs. */
+
+    /* Interrupt state (see interrupt.c). */
+    bool in_external_intr;      /* Processing an external interrupt? */
+    bool yield_on_return;       /* Yield on interrupt return? */
+  };
+
+/* CPUs in the system.  Only the first cpu_cnt are in use. */
+extern struct cpu cpus[CPU_MAX];
+extern int cpu_cnt;
+
+/* True once a second CPU may be running. */
+extern bool smp_active;
+
+struct cpu *cpu_current (void);
+
+#endif /* threads/cpu.h */
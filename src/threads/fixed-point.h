@@ -0,0 +1,70 @@
+#ifndef THREADS_FIXED_POINT_H
+#define THREADS_FIXED_POINT_H
+
+#include <stdint.h>
+
+/* Signed fixed-point real numbers in 17.14 format: 17 bits
+   before the binary point, including the sign, and 14 after it,
+   so that values up to about 131,071 can be represented with a
+   resolution of 1/16,384.  The kernel has no floating point, so
+   the MLFQS scheduler computes its load average and recent CPU
+   times with these.
+
+   A fixed_t is an ordinary int: adding or subtracting two of them
+   works directly, as does multiplying or dividing one by an int.
+   Use the functions below for everything else. */
+typedef int fixed_t;
+
+#define FP_SHIFT 14                     /* Fraction bits. */
+#define FP_ONE (1 << FP_SHIFT)          /* 1.0 as a fixed_t. */
+
+/* Returns integer N as a fixed-point number. */
+static inline fixed_t
+fp_from_int (int n)
+{
+  return n * FP_ONE;
+}
+
+/* Returns X truncated toward zero. */
+static inline int
+fp_to_int (fixed_t x)
+{
+  return x / FP_ONE;
+}
+
+/* Returns X rounded to the nearest integer. */
+static inline int
+fp_round (fixed_t x)
+{
+  return x >= 0 ? (x + FP_ONE / 2) / FP_ONE : (x - FP_ONE / 2) / FP_ONE;
+}
+
+/* Returns X + N. */
+static inline fixed_t
+fp_add_int (fixed_t x, int n)
+{
+  return x + n * FP_ONE;
+}
+
+/* Returns X - N. */
+static inline fixed_t
+fp_sub_int (fixed_t x, int n)
+{
+  return x - n * FP_ONE;
+}
+
+/* Returns X * Y. */
+static inline fixed_t
+fp_mul (fixed_t x, fixed_t y)
+{
+  return ((int64_t) x) * y / FP_ONE;
+}
+
+/* Returns X / Y. */
+static inline fixed_t
+fp_div (fixed_t x, fixed_t y)
+{
+  return ((int64_t) x) * FP_ONE / y;
+}
+
+#endif /* threads/fixed-point.h */
@@ -15,13 +15,16 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/bench.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -31,9 +34,15 @@
 #else
 #include "tests/threads/tests.h"
 #endif
+#ifdef KERNEL_TESTS
+#include "tests/kernel/tests.h"
+#endif
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/iosched.h"
+#include "devices/ramdisk.h"
+#include "devices/stripe.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
@@ -66,6 +75,7 @@ static void run_actions (char **argv);
 static void usage (void);
 
 #ifdef FILESYS
+static void init_stripe (void);
 static void locate_block_devices (void);
 static void locate_block_device (enum block_type, const char *name);
 #endif
@@ -117,12 +127,17 @@ main (void)
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
+  workqueue_init_system ();
   serial_init_queue ();
   timer_calibrate ();
+  smp_init ();
 
 #ifdef FILESYS
-  /* Initialize file system. */
+  /* Initialize file system.  RAM disks go first, so that they
+     win the roles they were configured for. */
+  ramdisk_init ();
   ide_init ();
+  init_stripe ();
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
@@ -247,6 +262,27 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-dirfmt"))
+        {
+          if (value != NULL && !strcmp (value, "fixed"))
+            filesys_dir_format = DIR_FORMAT_FIXED;
+          else if (value != NULL && !strcmp (value, "compact"))
+            filesys_dir_format = DIR_FORMAT_COMPACT;
+          else
+            PANIC ("unknown directory format `%s'", value);
+        }
+      else if (!strcmp (name, "-ramdisk"))
+        ramdisk_configure (value);
+      else if (!strcmp (name, "-stripe"))
+        stripe_configure (value);
+      else if (!strcmp (name, "-iotrace"))
+        block_trace_configure (atoi (value));
+      else if (!strcmp (name, "-iosched"))
+        {
+          iosched_default = value != NULL ? iosched_find (value) : NULL;
+          if (iosched_default == NULL)
+            PANIC ("unknown I/O scheduler `%s'", value);
+        }
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
@@ -256,6 +292,12 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-smp"))
+        smp_configure (value);
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-schedtrace"))
+        thread_trace_configure (atoi (value));
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -292,6 +334,19 @@ run_task (char **argv)
   printf ("Execution of '%s' complete.\n", task);
 }
 
+#ifdef KERNEL_TESTS
+/* Runs the kernel test specified in ARGV[1]. */
+static void
+run_kernel_task (char **argv)
+{
+  const char *task = argv[1];
+
+  printf ("Executing '%s':\n", task);
+  run_kernel_test (task);
+  printf ("Execution of '%s' complete.\n", task);
+}
+#endif
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -309,12 +364,17 @@ run_actions (char **argv)
   static const struct action actions[] = 
     {
       {"run", 2, run_task},
+      {"schedbench", 2, bench_sched},
+#ifdef KERNEL_TESTS
+      {"ktest", 2, run_kernel_task},
+#endif
 #ifdef FILESYS
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
       {"rm", 2, fsutil_rm},
       {"extract", 1, fsutil_extract},
       {"append", 2, fsutil_append},
+      {"iobench", 2, fsutil_iobench},
 #endif
       {NULL, 0, NULL},
     };
@@ -356,11 +416,16 @@ usage (void)
           "  run 'PROG [ARG...]' Run PROG and wait for it to complete.\n"
 #else
           "  run TEST           Run TEST.\n"
+#endif
+          "  schedbench N       Time thread wakeups beside N compute threads.\n"
+#ifdef KERNEL_TESTS
+          "  ktest TEST         Run kernel-side TEST.\n"
 #endif
 #ifdef FILESYS
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
           "  rm FILE            Delete FILE.\n"
+          "  iobench FILE       Read FILE by PIO and DMA beside a compute thread.\n"
           "Use these actions indirectly via `pintos' -g and -p options:\n"
           "  extract            Untar from scratch device into file system.\n"
           "  append FILE        Append FILE to tar file on scratch device.\n"
@@ -373,12 +438,24 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -dirfmt=FMT        Format directories as FMT (fixed or compact).\n"
+          "  -iosched=SCHED     Schedule disk I/O with SCHED (noop, clook,\n"
+          "                     or deadline; default deadline).\n"
+          "  -iotrace=N         Trace the last N disk requests, shown at shutdown.\n"
+          "  -ramdisk=ROLE:MB[:LAT]  Add an MB-megabyte RAM disk for ROLE\n"
+          "                     (filesys, scratch, or swap) with latency LAT\n"
+          "                     (none, fixed=US, or hdd; default none).\n"
+          "  -stripe=DEV,DEV...[:KB]  Stripe the file system across DEVs\n"
+          "                     in KB-kilobyte chunks (default 64).\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -smp=N             Use at most N CPUs, up to 8 (default 1).\n"
+          "  -tickless          Stop the timer tick while the CPU is idle.\n"
+          "  -schedtrace=N      Trace the last N context switches, shown at shutdown.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -387,6 +464,17 @@ usage (void)
 }
 
 #ifdef FILESYS
+/* Creates the striped device requested with -stripe, if any,
+   and makes it the file system device unless -filesys named
+   another. */
+static void
+init_stripe (void)
+{
+  struct block *stripe = stripe_init ();
+  if (stripe != NULL && filesys_bdev_name == NULL)
+    filesys_bdev_name = block_name (stripe);
+}
+
 /* Figure out what block devices to cast in the various Pintos roles. */
 static void
 locate_block_devices (void)
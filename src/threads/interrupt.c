@@ -3,11 +3,14 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
+#include "threads/spinlock.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "devices/lapic.h"
 #include "devices/timer.h"
 
 /* Programmable Interrupt Controller (PIC) registers.
@@ -43,9 +46,23 @@ static unsigned int unexpected_cnt[INTR_CNT];
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
-static bool in_external_intr;   /* Are we processing an external interrupt? */
-static bool yield_on_return;    /* Should we yield on interrupt return? */
+   interrupt returns.  Each CPU tracks this for itself, in its
+   struct cpu. */
+
+/* Interrupt lock.
+
+   On one CPU, code that turns interrupts off has the kernel to
+   itself until it turns them back on, and most of the kernel's
+   data, from the run queues to the semaphores, relies on that.
+   Once other CPUs run, that no longer holds, so from then on a
+   CPU also holds this lock whenever its interrupts are off:
+   intr_disable() takes it, intr_enable() releases it, and an
+   interrupt that arrives with interrupts on takes it for the
+   handler's duration.  The lock passes along with the CPU
+   through a thread switch, since interrupts stay off across
+   one.  Until then, smp_active is false and the lock is never
+   touched. */
+static struct spinlock intr_spinlock;
 
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
@@ -90,6 +107,9 @@ intr_enable (void)
   enum intr_level old_level = intr_get_level ();
   ASSERT (!intr_context ());
 
+  if (old_level == INTR_OFF)
+    intr_lock_release ();
+
   /* Enable interrupts by setting the interrupt flag.
 
      See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
@@ -110,14 +130,54 @@ intr_disable (void)
      Hardware Interrupts". */
   asm volatile ("cli" : : : "memory");
 
+  if (old_level == INTR_ON)
+    intr_lock_acquire ();
+
   return old_level;
 }
+
+/* Takes the interrupt lock, if other CPUs may be running and
+   this CPU does not already hold it.  Interrupts must be off.
+   intr_disable() does this itself; other code needs it only
+   where interrupts were turned off some other way. */
+void
+intr_lock_acquire (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (smp_active && !spinlock_held_by_current_cpu (&intr_spinlock))
+    spinlock_acquire (&intr_spinlock);
+}
+
+/* Releases the interrupt lock, if this CPU holds it, without
+   turning interrupts on.  Interrupts must be off, and must be
+   turned on right afterward, as by the idle thread's `sti; hlt'. */
+void
+intr_lock_release (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (smp_active && spinlock_held_by_current_cpu (&intr_spinlock))
+    spinlock_release (&intr_spinlock);
+}
+
+/* Starts taking the interrupt lock along with turning interrupts
+   off, before a second CPU starts.  Interrupts must be off. */
+void
+intr_smp_init (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!smp_active);
+
+  spinlock_init (&intr_spinlock);
+  spinlock_acquire (&intr_spinlock);
+  smp_active = true;
+}
 
 /* Initializes the interrupt system. */
 void
 intr_init (void)
 {
-  uint64_t idtr_operand;
   int i;
 
   /* Initialize interrupt controller. */
@@ -130,8 +190,7 @@ intr_init (void)
   /* Load IDT register.
      See [IA32-v2a] "LIDT" and [IA32-v3a] 5.10 "Interrupt
      Descriptor Table (IDT)". */
-  idtr_operand = make_idtr_operand (sizeof idt - 1, idt);
-  asm volatile ("lidt %0" : : "m" (idtr_operand));
+  intr_init_ap ();
 
   /* Initialize intr_names. */
   for (i = 0; i < INTR_CNT; i++)
@@ -157,6 +216,15 @@ intr_init (void)
   intr_names[19] = "#XF SIMD Floating-Point Exception";
 }
 
+/* Points the current CPU at the IDT, which all CPUs share.
+   intr_init() does this for the boot CPU. */
+void
+intr_init_ap (void)
+{
+  uint64_t idtr_operand = make_idtr_operand (sizeof idt - 1, idt);
+  asm volatile ("lidt %0" : : "m" (idtr_operand));
+}
+
 /* Registers interrupt VEC_NO to invoke HANDLER with descriptor
    privilege level DPL.  Names the interrupt NAME for debugging
    purposes.  The interrupt handler will be invoked with
@@ -176,12 +244,13 @@ register_handler (uint8_t vec_no, int dpl, enum intr_level level,
 
 /* Registers external interrupt VEC_NO to invoke HANDLER, which
    is named NAME for debugging purposes.  The handler will
-   execute with interrupts disabled. */
+   execute with interrupts disabled.  VEC_NO is either one of the
+   PICs' vectors or one of the local APIC's (see lapic.h). */
 void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
                    const char *name) 
 {
-  ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+  ASSERT ((vec_no >= 0x20 && vec_no <= 0x2f) || is_lapic_vec (vec_no));
   register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
@@ -203,6 +272,7 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
                    intr_handler_func *handler, const char *name)
 {
   ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+  ASSERT (!is_lapic_vec (vec_no));
   register_handler (vec_no, dpl, level, handler, name);
 }
 
@@ -211,7 +281,7 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 bool
 intr_context (void) 
 {
-  return in_external_intr;
+  return cpu_current ()->in_external_intr;
 }
 
 /* During processing of an external interrupt, directs the
@@ -222,7 +292,7 @@ void
 intr_yield_on_return (void) 
 {
   ASSERT (intr_context ());
-  yield_on_return = true;
+  cpu_current ()->yield_on_return = true;
 }
 
 /* 8259A Programmable Interrupt Controller. */
@@ -258,6 +328,20 @@ pic_init (void)
   outb (PIC1_DATA, 0x00);
 }
 
+/* Returns true if the PIC has raised external interrupt VEC but
+   the CPU has not yet taken it, as while interrupts are off. */
+bool
+intr_ext_pending (uint8_t vec)
+{
+  int port = vec < 0x28 ? PIC0_CTRL : PIC1_CTRL;
+
+  ASSERT (vec >= 0x20 && vec < 0x30);
+
+  /* OCW3: read the interrupt request register. */
+  outb (port, 0x0a);
+  return (inb (port) & (1 << (vec & 7))) != 0;
+}
+
 /* Sends an end-of-interrupt signal to the PIC for the given IRQ.
    If we don't acknowledge the IRQ, it will never be delivered to
    us again, so this is important.  */
@@ -347,25 +431,38 @@ intr_handler (struct intr_frame *frame)
   bool external;
   intr_handler_func *handler;
 
+  /* An interrupt gate turned interrupts off, so take the
+     interrupt lock along with them. */
+  if (intr_get_level () == INTR_OFF)
+    intr_lock_acquire ();
+
   /* External interrupts are special.
      We only handle one at a time (so interrupts must be off)
-     and they need to be acknowledged on the PIC (see below).
+     and they need to be acknowledged on the PIC or the local
+     APIC (see below).
      An external interrupt handler cannot sleep. */
-  external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+  external = ((frame->vec_no >= 0x20 && frame->vec_no < 0x30)
+              || is_lapic_vec (frame->vec_no));
   if (external) 
     {
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (!intr_context ());
 
-      in_external_intr = true;
-      yield_on_return = false;
+      cpu_current ()->in_external_intr = true;
+      cpu_current ()->yield_on_return = false;
+
+      /* If the timer stopped ticking while the CPU was idle,
+         bring the time up to date before anything uses it. */
+      if (!is_lapic_vec (frame->vec_no))
+        timer_idle_exit ();
     }
 
   /* Invoke the interrupt's handler. */
   handler = intr_handlers[frame->vec_no];
   if (handler != NULL)
     handler (frame);
-  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f)
+  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f
+           || frame->vec_no == LAPIC_VEC_SPURIOUS)
     {
       /* There is no handler, but this interrupt can trigger
          spuriously due to a hardware fault or hardware race
@@ -377,15 +474,32 @@ intr_handler (struct intr_frame *frame)
   /* Complete the processing of an external interrupt. */
   if (external) 
     {
+      struct cpu *cpu = cpu_current ();
+
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (intr_context ());
 
-      in_external_intr = false;
-      pic_end_of_interrupt (frame->vec_no); 
+      cpu->in_external_intr = false;
+      if (is_lapic_vec (frame->vec_no))
+        lapic_eoi ();
+      else
+        pic_end_of_interrupt (frame->vec_no); 
 
-      if (yield_on_return) 
+      if (cpu->yield_on_return) 
         thread_yield (); 
     }
+
+  /* Leave the interrupt lock as the interrupted code had it:
+     held if its interrupts were off, free if `iret' is about to
+     turn them back on.  The thread may have moved to a
+     different CPU while it yielded above. */
+  if (intr_get_level () == INTR_OFF)
+    {
+      if (frame->eflags & FLAG_IF)
+        intr_lock_release ();
+      else
+        intr_lock_acquire ();
+    }
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
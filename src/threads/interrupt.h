@@ -58,12 +58,19 @@ struct intr_frame
 typedef void intr_handler_func (struct intr_frame *);
 
 void intr_init (void);
+void intr_init_ap (void);
 void intr_register_ext (uint8_t vec, intr_handler_func *, const char *name);
 void intr_register_int (uint8_t vec, int dpl, enum intr_level,
                         intr_handler_func *, const char *name);
 bool intr_context (void);
+bool intr_ext_pending (uint8_t vec);
 void intr_yield_on_return (void);
 
+/* Interrupt lock, for running on more than one CPU. */
+void intr_smp_init (void);
+void intr_lock_acquire (void);
+void intr_lock_release (void);
+
 void intr_dump_frame (const struct intr_frame *);
 const char *intr_name (uint8_t vec);
 
@@ -0,0 +1,322 @@
+#include "threads/smp.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <packed.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "devices/lapic.h"
+#include "devices/timer.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/pte.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/tss.h"
+#endif
+
+/* Symmetric multiprocessing.
+
+   At boot, only one CPU runs, the "boot CPU".  smp_init() looks
+   up the others in the BIOS's MultiProcessor Specification
+   tables and starts each one, by sending it an INIT
+   inter-processor interrupt and then two STARTUP ones pointing
+   at the code in ap-start.S.
+
+   Each started CPU runs threads from its own run queues and,
+   when those are empty, steals from other CPUs' (see
+   next_thread_to_run() in thread.c).  The kernel still relies
+   on turning interrupts off for mutual exclusion, which the
+   interrupt lock in interrupt.c extends across CPUs, so only
+   one CPU at a time runs kernel code with interrupts off.
+   User programs and kernel code with interrupts on run on all
+   the CPUs at once.
+
+   Refer to [MP] for the MultiProcessor Specification tables and
+   [IA32-v3a] 8.4 "Multiple-Processor (MP) Initialization". */
+
+/* CPUs in the system.  Only the first cpu_cnt are in use. */
+struct cpu cpus[CPU_MAX];
+int cpu_cnt;
+
+/* True once a second CPU may be running. */
+bool smp_active;
+
+/* -smp=N: Most CPUs to use.  Only the boot CPU unless -smp asks
+   for more, so that multiprocessor scheduling is opt-in. */
+static int cpu_limit = 1;
+
+/* MP floating pointer structure, which locates the MP
+   configuration table.  See [MP] 4.1. */
+struct mp_pointer
+  {
+    char signature[4];          /* "_MP_". */
+    uint32_t config;            /* Physical address of mp_config. */
+    uint8_t length;             /* In 16-byte units, normally 1. */
+    uint8_t version;            /* 1 for 1.1, 4 for 1.4. */
+    uint8_t checksum;           /* All bytes sum to 0. */
+    uint8_t type;               /* Default configuration, or 0. */
+    uint8_t features[4];
+  }
+PACKED;
+
+/* MP configuration table header.  See [MP] 4.2. */
+struct mp_config
+  {
+    char signature[4];          /* "PCMP". */
+    uint16_t length;            /* Size of header and entries. */
+    uint8_t version;            /* 1 for 1.1, 4 for 1.4. */
+    uint8_t checksum;           /* All bytes sum to 0. */
+    char oem_id[8];
+    char product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_table_size;
+    uint16_t entry_cnt;         /* Entries following the header. */
+    uint32_t lapic_addr;        /* Physical address of local APICs. */
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+  }
+PACKED;
+
+/* MP configuration table processor entry.  See [MP] 4.3.1.
+   Every other kind of entry is 8 bytes long. */
+#define MP_PROCESSOR 0
+struct mp_processor
+  {
+    uint8_t type;               /* MP_PROCESSOR. */
+    uint8_t apic_id;            /* Local APIC ID. */
+    uint8_t apic_version;
+    uint8_t flags;              /* MP_CPU_* flags. */
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+  }
+PACKED;
+#define MP_CPU_ENABLED 0x1      /* Usable. */
+#define MP_CPU_BOOT 0x2         /* The boot CPU. */
+
+/* Trampoline in ap-start.S. */
+extern char ap_start[], ap_end[];
+extern uint32_t ap_cr3, ap_esp, ap_entry;
+
+static struct mp_config *find_config (void);
+static bool start_cpu (uint8_t apic_id);
+static void ap_main (void) NO_RETURN;
+static intr_handler_func reschedule_interrupt;
+
+/* Sets the most CPUs to use from the kernel command line. */
+void
+smp_configure (const char *cpus)
+{
+  cpu_limit = cpus != NULL ? atoi (cpus) : 0;
+  if (cpu_limit < 1 || cpu_limit > CPU_MAX)
+    PANIC ("-smp: CPU count must be between 1 and %d", CPU_MAX);
+}
+
+/* Starts the CPUs other than the boot CPU, up to the -smp limit.
+   Does nothing if there are none.  Must be called after the
+   timer is calibrated and before any user process exists. */
+void
+smp_init (void)
+{
+  uint8_t apic_ids[CPU_MAX];
+  int apic_cnt = 0;
+  struct mp_config *config;
+  uint8_t *entry;
+  enum intr_level old_level;
+  int i;
+
+  ASSERT (intr_get_level () == INTR_ON);
+
+  if (cpu_limit < 2)
+    return;
+  config = find_config ();
+  if (config == NULL)
+    return;
+
+  /* Collect the other usable CPUs. */
+  entry = (uint8_t *) (config + 1);
+  for (i = 0; i < config->entry_cnt; i++)
+    if (*entry == MP_PROCESSOR)
+      {
+        struct mp_processor *p = (struct mp_processor *) entry;
+        if ((p->flags & (MP_CPU_ENABLED | MP_CPU_BOOT)) == MP_CPU_ENABLED
+            && apic_cnt < cpu_limit - 1)
+          apic_ids[apic_cnt++] = p->apic_id;
+        entry += sizeof *p;
+      }
+    else
+      entry += 8;
+  if (apic_cnt == 0)
+    return;
+
+  lapic_init (config->lapic_addr);
+  cpus[0].apic_id = lapic_id ();
+  intr_register_ext (LAPIC_VEC_RESCHEDULE, reschedule_interrupt,
+                     "Reschedule IPI");
+
+  /* Set up the trampoline, and map the low 4 MB, where it runs,
+     to itself, as it turns paging on.  That is the same page
+     table that maps those 4 MB at PHYS_BASE. */
+  memcpy (ptov (LOADER_AP_START), ap_start, ap_end - ap_start);
+  *(uint32_t *) ptov (LOADER_AP_START + ((char *) &ap_cr3 - ap_start))
+    = vtop (init_page_dir);
+  *(uint32_t *) ptov (LOADER_AP_START + ((char *) &ap_entry - ap_start))
+    = (uint32_t) ap_main;
+  init_page_dir[0] = init_page_dir[pd_no (ptov (0))];
+
+  old_level = intr_disable ();
+  intr_smp_init ();
+  intr_set_level (old_level);
+
+  /* A CPU that fails to start might still do so later, running
+     on cpus[cpu_cnt], so start no more after it. */
+  for (i = 0; i < apic_cnt; i++)
+    if (!start_cpu (apic_ids[i]))
+      break;
+
+  /* Unmap the low 4 MB again, before any user process can copy
+     the mapping into its page directory. */
+  init_page_dir[0] = 0;
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)) : "memory");
+
+  printf ("%d CPUs online.\n", cpu_cnt);
+}
+
+/* Returns true if the SIZE bytes at P add up to 0 (mod 256). */
+static bool
+checksum_ok (const void *p, size_t size)
+{
+  const uint8_t *bytes = p;
+  uint8_t sum = 0;
+
+  while (size-- > 0)
+    sum += *bytes++;
+  return sum == 0;
+}
+
+/* Returns the MP floating pointer structure in the SIZE bytes of
+   physical memory at PHYS_ADDR, or a null pointer if there is
+   none. */
+static struct mp_pointer *
+search_pointer (uintptr_t phys_addr, size_t size)
+{
+  uint8_t *p = ptov (phys_addr);
+  uint8_t *end = p + size;
+
+  for (; p + sizeof (struct mp_pointer) <= end; p += 16)
+    if (!memcmp (p, "_MP_", 4) && checksum_ok (p, sizeof (struct mp_pointer)))
+      return (struct mp_pointer *) p;
+  return NULL;
+}
+
+/* Returns the MP configuration table, or a null pointer if the
+   BIOS did not provide one.  Looks for the floating pointer in
+   the places that [MP] 4 says to: the first kB of the extended
+   BIOS data area, the last kB of base memory, and the BIOS ROM. */
+static struct mp_config *
+find_config (void)
+{
+  uint16_t ebda_seg = *(uint16_t *) ptov (0x40e);
+  uint16_t base_kb = *(uint16_t *) ptov (0x413);
+  struct mp_pointer *mp = NULL;
+  struct mp_config *config;
+
+  if (ebda_seg != 0)
+    mp = search_pointer ((uintptr_t) ebda_seg << 4, 1024);
+  if (mp == NULL)
+    mp = search_pointer (base_kb * 1024 - 1024, 1024);
+  if (mp == NULL)
+    mp = search_pointer (0xf0000, 0x10000);
+  if (mp == NULL || mp->type != 0 || mp->config == 0)
+    return NULL;
+
+  /* The table might be where Pintos has no memory mapped. */
+  if (mp->config >= init_ram_pages * PGSIZE)
+    {
+      printf ("smp: MP configuration table at %#"PRIx32" is not mapped\n",
+              mp->config);
+      return NULL;
+    }
+  config = ptov (mp->config);
+  if (memcmp (config->signature, "PCMP", 4)
+      || !checksum_ok (config, config->length))
+    return NULL;
+  return config;
+}
+
+/* Starts the CPU with local APIC ID APIC_ID as cpus[cpu_cnt]
+   and waits for it to start running threads.  Counts it in
+   cpu_cnt and returns true if it does, otherwise returns false. */
+static bool
+start_cpu (uint8_t apic_id)
+{
+  struct cpu *cpu = &cpus[cpu_cnt];
+  struct thread *idle;
+  enum intr_level old_level;
+  int i;
+
+  cpu->id = cpu_cnt;
+  cpu->apic_id = apic_id;
+  idle = thread_create_idle (cpu);
+  if (idle == NULL)
+    {
+      printf ("smp: out of memory for CPU %d\n", cpu->id);
+      return false;
+    }
+  *(uint32_t *) ptov (LOADER_AP_START + ((char *) &ap_esp - ap_start))
+    = (uint32_t) idle + PGSIZE;
+
+  /* [IA32-v3a] 8.4.4.1 "Typical BSP Initialization Sequence"
+     calls for a 10 ms wait after INIT and 200 us after each
+     STARTUP. */
+  lapic_send_init (apic_id);
+  timer_msleep (10);
+  for (i = 0; i < 2; i++)
+    {
+      lapic_send_startup (apic_id, LOADER_AP_START);
+      timer_udelay (200);
+    }
+
+  for (i = 0; i < 100 && !cpu->started; i++)
+    timer_msleep (1);
+  if (!cpu->started)
+    {
+      printf ("smp: CPU %d (APIC ID %"PRIu8") did not start\n",
+              cpu->id, apic_id);
+      return false;
+    }
+
+  old_level = intr_disable ();
+  cpu_cnt++;
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Entry point for CPUs other than the boot CPU, called by
+   ap-start.S with interrupts off, on the stack of the idle thread
+   that start_cpu() created. */
+static void
+ap_main (void)
+{
+  intr_init_ap ();
+#ifdef USERPROG
+  tss_init ();
+  gdt_init ();
+#endif
+  lapic_init_ap ();
+  thread_start_ap ();
+}
+
+/* Reschedule IPI handler.  Another CPU sends it to an idle CPU
+   that might steal a thread it just made ready. */
+static void
+reschedule_interrupt (struct intr_frame *args UNUSED)
+{
+  intr_yield_on_return ();
+}
@@ -0,0 +1,7 @@
+#ifndef THREADS_SMP_H
+#define THREADS_SMP_H
+
+void smp_configure (const char *cpus);
+void smp_init (void);
+
+#endif /* threads/smp.h */
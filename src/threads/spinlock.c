@@ -0,0 +1,70 @@
+#include "threads/spinlock.h"
+#include <debug.h>
+#include <stddef.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+
+/* Initializes spinlock L as not held. */
+void
+spinlock_init (struct spinlock *l)
+{
+  ASSERT (l != NULL);
+
+  l->locked = 0;
+  l->holder = NULL;
+}
+
+/* Atomically sets L's `locked' member and returns its previous
+   value.  XCHG with a memory operand is always locked, and it is
+   a full memory barrier.  See [IA32-v2b] "XCHG". */
+static inline uint32_t
+test_and_set (struct spinlock *l)
+{
+  uint32_t old = 1;
+  asm volatile ("xchgl %0, %1" : "+r" (old), "+m" (l->locked) : : "memory");
+  return old;
+}
+
+/* Acquires L, spinning until it is available.  The current CPU
+   must not already hold L.  Interrupts should be off; see the
+   comment on struct spinlock. */
+void
+spinlock_acquire (struct spinlock *l)
+{
+  ASSERT (l != NULL);
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!spinlock_held_by_current_cpu (l));
+
+  while (test_and_set (l) != 0)
+    {
+      /* Spin reading, not writing, so that the waiting CPUs do
+         not keep taking the cache line away from the holder.
+         PAUSE tells the processor that this is a spin-wait loop.
+         See [IA32-v2b] "PAUSE". */
+      while (l->locked != 0)
+        asm volatile ("pause" : : : "memory");
+    }
+  l->holder = cpu_current ();
+}
+
+/* Releases L, which the current CPU must hold. */
+void
+spinlock_release (struct spinlock *l)
+{
+  ASSERT (l != NULL);
+  ASSERT (spinlock_held_by_current_cpu (l));
+
+  l->holder = NULL;
+  asm volatile ("movl $0, %0" : "=m" (l->locked) : : "memory");
+}
+
+/* Returns true if the current CPU holds L, false otherwise.
+   (Note that testing whether some other CPU holds a spinlock
+   would be racy.) */
+bool
+spinlock_held_by_current_cpu (const struct spinlock *l)
+{
+  ASSERT (l != NULL);
+
+  return l->locked != 0 && l->holder == cpu_current ();
+}
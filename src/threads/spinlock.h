@@ -0,0 +1,26 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A spinlock, for mutual exclusion between CPUs.
+
+   A spinlock never sleeps, so it may be taken where a lock may
+   not, such as with interrupts off or in an interrupt handler,
+   but a CPU that waits for one does nothing else meanwhile.
+   Hold spinlocks only briefly, with interrupts off, so that an
+   interrupt handler on the same CPU cannot try to take a
+   spinlock that the code it interrupted holds. */
+struct spinlock
+  {
+    volatile uint32_t locked;   /* Nonzero if held. */
+    struct cpu *holder;         /* CPU holding the lock (for debugging). */
+  };
+
+void spinlock_init (struct spinlock *);
+void spinlock_acquire (struct spinlock *);
+void spinlock_release (struct spinlock *);
+bool spinlock_held_by_current_cpu (const struct spinlock *);
+
+#endif /* threads/spinlock.h */
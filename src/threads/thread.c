@@ -2,15 +2,20 @@
 #include <debug.h>
 #include <stddef.h>
 #include <random.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/lapic.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -22,20 +27,35 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running, wait in the run queues
+   of a CPU, as does each CPU's idle thread.  See struct cpu in
+   cpu.h. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
-/* Idle thread. */
-static struct thread *idle_thread;
-
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
+/* Thread pages.  A thread's page is freed once nothing holds it
+   (see thread_release()): the dead thread goes on zombie_list,
+   from which the reaper thread takes it, since pages cannot be
+   freed safely in the middle of a thread switch.  The reaper
+   zeroes up to THREAD_CACHE_MAX pages and keeps them in
+   page_cache for thread_create() to reuse, and gives the rest
+   back to the page allocator. */
+#define THREAD_CACHE_MAX 8
+static struct list zombie_list;
+static struct thread *reaper_thread;
+static bool reaper_sleeping;    /* Blocked waiting for zombies? */
+static void *page_cache[THREAD_CACHE_MAX];
+static int page_cache_cnt;
+static long long pages_reused;  /* # of pages thread_create() took
+                                   from page_cache. */
+static long long pages_freed;   /* # of pages freed by the reaper. */
+
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
@@ -52,26 +72,90 @@ static long long idle_ticks;    /* # of timer ticks spent idle. */
 static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
 static long long user_ticks;    /* # of timer ticks in user programs. */
 
+/* A context switch, as remembered in the trace. */
+struct trace_entry
+  {
+    int64_t time;               /* timer_usec() at the switch. */
+    int cpu;                    /* CPU that switched. */
+    enum thread_status status;  /* State the previous thread went to. */
+    tid_t prev_tid;             /* Thread switched from... */
+    tid_t next_tid;             /* ...and to. */
+    char prev_name[16];
+    char next_name[16];
+  };
+
+/* Ring buffer of the last trace_size context switches, on all
+   CPUs.  Disabled if trace_size is 0. */
+static struct trace_entry *trace;
+static size_t trace_size;
+static unsigned long long trace_cnt;   /* Switches ever traced. */
+
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
+#define DONATION_DEPTH 8        /* Most lock holders a donation reaches. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* MLFQS.  Each thread's priority falls as it uses the CPU,
+   measured by its recent_cpu, which decays once a second at a
+   rate set by the system load average, so that threads that
+   mostly wait for I/O or input keep a higher priority than
+   CPU-bound ones.  Only the running thread's recent_cpu changes
+   between those once-a-second updates, so a timer tick updates
+   no other thread. */
+#define MLFQS_PRIORITY_TICKS 4  /* Ticks between priority updates. */
+static fixed_t load_avg;        /* Ready threads, averaged over a minute. */
+
+/* EDF.  A thread with a reservation, while it has budget left,
+   is queued by deadline in its CPU's edf_queue, which is served
+   before the priority queues.  Each period starts when the one
+   before it ends, at the deadline, by an alarm that refills the
+   budget.  A period that ends before the thread has called
+   thread_edf_wait() counts as a missed deadline.  Admission
+   keeps the sum of the reservations' utilizations at most
+   EDF_UTIL_MAX, under which EDF meets every deadline. */
+static int edf_utilization;     /* Sum of edf_util over all threads. */
+static long long edf_total_misses; /* Deadlines missed by all threads. */
+static long long edf_reservations; /* Reservations ever admitted. */
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
+static void reaper (void *aux UNUSED);
+static void *alloc_thread_page (void);
+static void idle_loop (void) NO_RETURN;
 static struct thread *running_thread (void);
-static struct thread *next_thread_to_run (void);
+static struct thread *next_thread_to_run (struct cpu *);
+static void init_cpu (struct cpu *, int id);
+static bool is_idle (const struct thread *);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static void ready_push (struct cpu *, struct thread *);
+static void ready_remove (struct thread *);
+static struct thread *ready_pop (struct cpu *, int priority);
+static int ready_max_priority (const struct cpu *);
+static struct thread *edf_pop (struct cpu *);
+static void kick_idle_cpu (void);
+static void change_priority (struct thread *, int priority);
+static void refresh_priority (struct thread *);
+static void mlfqs_tick (struct thread *);
+static int mlfqs_priority (const struct thread *);
+static bool edf_active (const struct thread *);
+static bool outranks (const struct thread *, const struct thread *);
+static bool ready_outranks (struct cpu *, const struct thread *);
+static void edf_period_end (void *t);
+static void edf_cancel (struct thread *);
+static void account_switch (struct thread *cur, struct thread *next);
+static void get_stats (const struct thread *, struct schedstat *);
+static void print_thread_stats (struct thread *, void *aux);
+static void print_trace (void);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -92,14 +176,18 @@ thread_init (void)
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  init_cpu (&cpus[0], 0);
+  cpus[0].started = true;
+  cpu_cnt = 1;
   list_init (&all_list);
+  list_init (&zombie_list);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
   initial_thread->status = THREAD_RUNNING;
   initial_thread->tid = allocate_tid ();
+  cpus[0].running = initial_thread;
   
   initial_thread->current_dir = NULL;
 }
@@ -112,6 +200,14 @@ thread_start (void)
   /* Create the idle thread. */
   struct semaphore idle_started;
   sema_init (&idle_started, 0);
+
+  if (trace_size > 0)
+    {
+      trace = calloc (trace_size, sizeof *trace);
+      if (trace == NULL)
+        trace_size = 0;
+    }
+
   thread_create ("idle", PRI_MIN, idle, &idle_started);
 
   /* Start preemptive thread scheduling. */
@@ -119,6 +215,54 @@ thread_start (void)
 
   /* Wait for the idle thread to initialize idle_thread. */
   sema_down (&idle_started);
+
+  thread_create ("reaper", PRI_DEFAULT, reaper, NULL);
+}
+
+/* Creates and returns the idle thread for CPU, which has not
+   started yet, and sets up CPU's run queues.  Returns a null
+   pointer if memory is exhausted.
+
+   CPU will start out running on the idle thread's stack, at the
+   top of its page, instead of switching to it, so the idle
+   thread gets no stack frames.  See smp.c. */
+struct thread *
+thread_create_idle (struct cpu *cpu)
+{
+  char name[16];
+  struct thread *t;
+
+  ASSERT (!cpu->started);
+
+  t = palloc_get_page (PAL_ZERO);
+  if (t == NULL)
+    return NULL;
+
+  snprintf (name, sizeof name, "idle%d", cpu->id);
+  init_thread (t, name, PRI_MIN);
+  t->tid = allocate_tid ();
+  t->status = THREAD_RUNNING;
+  t->cpu = cpu;
+
+  init_cpu (cpu, cpu->id);
+  cpu->idle_thread = cpu->running = t;
+  return t;
+}
+
+/* Starts scheduling threads on the current CPU, which must not
+   be the boot CPU.  It must be running on the idle thread that
+   thread_create_idle() made for it, with interrupts off. */
+void
+thread_start_ap (void)
+{
+  struct cpu *cpu = cpu_current ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (thread_current () == cpu->idle_thread);
+
+  intr_lock_acquire ();
+  cpu->started = true;
+  idle_loop ();
 }
 
 /* Called by the timer interrupt handler at each timer tick.
@@ -127,9 +271,10 @@ void
 thread_tick (void) 
 {
   struct thread *t = thread_current ();
+  struct cpu *cpu = t->cpu;
 
   /* Update statistics. */
-  if (t == idle_thread)
+  if (is_idle (t))
     idle_ticks++;
 #ifdef USERPROG
   else if (t->pagedir != NULL)
@@ -138,17 +283,86 @@ thread_tick (void)
   else
     kernel_ticks++;
 
+  if (thread_mlfqs)
+    mlfqs_tick (t);
+
+  /* Enforce the EDF budget.  Once it is used up, T competes
+     with the threads without a reservation until its next
+     period. */
+  if (edf_active (t) && ++t->edf_used >= t->edf_budget)
+    {
+      t->edf_throttled = true;
+      intr_yield_on_return ();
+    }
+
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  if (++cpu->thread_ticks >= TIME_SLICE)
     intr_yield_on_return ();
 }
 
-/* Prints thread statistics. */
+/* Prints thread statistics: system-wide ticks, then each
+   thread's scheduler statistics, then the switch trace if
+   enabled. */
 void
 thread_print_stats (void) 
 {
+  enum intr_level old_level;
+  int i;
+
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  printf ("Thread pages: %lld reused, %lld freed\n",
+          pages_reused, pages_freed);
+  if (cpu_cnt > 1)
+    for (i = 0; i < cpu_cnt; i++)
+      printf ("CPU %d: %lld threads stolen\n", i, cpus[i].steals);
+  if (edf_reservations > 0)
+    printf ("EDF: %lld reservations, %lld deadlines missed\n",
+            edf_reservations, edf_total_misses);
+
+  printf ("Threads (times in us):\n"
+          "   tid name                   run       wait    vol  invol"
+          "   wake  avg-lat  max-lat\n");
+  old_level = intr_disable ();
+  thread_foreach (print_thread_stats, NULL);
+  intr_set_level (old_level);
+  print_trace ();
+}
+
+/* Copies the scheduler statistics of the thread with TID, or of
+   the running thread if TID is 0, into STATS, including the
+   time it has spent so far in its present state.  Returns false
+   if no thread has TID. */
+bool
+thread_get_stats (tid_t tid, struct schedstat *stats)
+{
+  enum intr_level old_level = intr_disable ();
+  struct thread *t = NULL;
+  struct list_elem *e;
+
+  if (tid == 0)
+    t = thread_current ();
+  else
+    for (e = list_begin (&all_list); e != list_end (&all_list);
+         e = list_next (e))
+      if (list_entry (e, struct thread, allelem)->tid == tid)
+        {
+          t = list_entry (e, struct thread, allelem);
+          break;
+        }
+  if (t != NULL)
+    get_stats (t, stats);
+  intr_set_level (old_level);
+  return t != NULL;
+}
+
+/* Keeps a trace of the last CNT context switches on all CPUs,
+   printed by thread_print_stats().  Must be called before
+   thread_start(), which allocates the trace. */
+void
+thread_trace_configure (size_t cnt)
+{
+  trace_size = cnt;
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -163,9 +377,8 @@ thread_print_stats (void)
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   If PRIORITY is higher than the running thread's, the new
+   thread preempts it. */
 tid_t
 thread_create (const char *name, int priority,
                thread_func *function, void *aux) 
@@ -174,12 +387,13 @@ thread_create (const char *name, int priority,
   struct kernel_thread_frame *kf;
   struct switch_entry_frame *ef;
   struct switch_threads_frame *sf;
+  enum intr_level old_level;
   tid_t tid;
 
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);  /* allocate page for thread */
+  t = alloc_thread_page ();        /* allocate page for thread */
   if (t == NULL)
     return TID_ERROR;
 
@@ -187,6 +401,15 @@ thread_create (const char *name, int priority,
   init_thread (t, name, priority); /* thread struct initialize */
   tid = t->tid = allocate_tid ();  /* thread id allocate */
 
+  /* Under the MLFQS, the new thread inherits its parent's
+     niceness and recent CPU time, which set its priority. */
+  if (thread_mlfqs)
+    {
+      t->nice = thread_current ()->nice;
+      t->recent_cpu = thread_current ()->recent_cpu;
+      t->priority = t->base_priority = mlfqs_priority (t);
+    }
+
   if(thread_current()->current_dir != NULL){
      // 자식 thread의 current dir를 부모 thread의 current dir로 directory를 다시 오픈하여 설정
     t->current_dir = dir_reopen(thread_current()->current_dir); 
@@ -234,7 +457,12 @@ thread_create (const char *name, int priority,
   sema_init(&t->sema_for_exec, 0);
 
   // 5. add to child_list for parent
+  // process_exit()도 interrupt를 끄고 child_list를 고치므로 여기서도 끔
+  old_level = intr_disable ();
   list_push_back(&thread_current()->child_list, &t->child_elem);
+  // 부모도 t의 page를 hold: wait하거나 exit할 때 thread_release()
+  t->refs++;
+  intr_set_level (old_level);
 
   // 6. sig_handler initialize
   for (int i=0;i<3;i++)
@@ -245,10 +473,38 @@ thread_create (const char *name, int priority,
 
   /* Add to run queue. */
   thread_unblock (t);
+  thread_preempt ();
 
   return tid;
 }
 
+/* Drops a hold on T's page, freeing the page once no holds
+   remain.  A thread holds its own page until it has died and
+   been switched away from, and its parent holds it until the
+   parent has waited for the thread or forgotten it, so that the
+   parent can still read the thread's exit status after it
+   dies. */
+void
+thread_release (struct thread *t)
+{
+  enum intr_level old_level = intr_disable ();
+
+  ASSERT (is_thread (t));
+  ASSERT (t->refs > 0);
+
+  if (--t->refs == 0)
+    {
+      ASSERT (t->status == THREAD_DYING);
+      list_push_back (&zombie_list, &t->elem);
+      if (reaper_sleeping)
+        {
+          reaper_sleeping = false;
+          thread_unblock (reaper_thread);
+        }
+    }
+  intr_set_level (old_level);
+}
+
 /* Puts the current thread to sleep.  It will not be scheduled
    again until awoken by thread_unblock().
 
@@ -272,7 +528,10 @@ thread_block (void)
    This function does not preempt the running thread.  This can
    be important: if the caller had disabled interrupts itself,
    it may expect that it can atomically unblock a thread and
-   update other data. */
+   update other data.  Call thread_preempt() afterward to let T
+   run at once if it has a higher priority.  In an interrupt
+   handler, T preempts the interrupted thread when the handler
+   returns. */
 void
 thread_unblock (struct thread *t) 
 {
@@ -282,11 +541,36 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  ready_push (cpu_current (), t);
   t->status = THREAD_READY;
+  t->sched_stamp = timer_usec ();
+  t->sched_woken = true;
+  t->stats.wakeups++;
+  if (intr_context () && outranks (t, thread_current ()))
+    intr_yield_on_return ();
+  else
+    kick_idle_cpu ();
   intr_set_level (old_level);
 }
 
+/* Yields the CPU if a ready thread should run ahead of the
+   running thread.  In an interrupt handler, arranges to yield
+   when the handler returns instead. */
+void
+thread_preempt (void)
+{
+  enum intr_level old_level = intr_disable ();
+  bool preempt = ready_outranks (cpu_current (), thread_current ());
+  intr_set_level (old_level);
+
+  if (!preempt)
+    return;
+  if (intr_context ())
+    intr_yield_on_return ();
+  else
+    thread_yield ();
+}
+
 /* Returns the name of the running thread. */
 const char *
 thread_name (void) 
@@ -330,6 +614,7 @@ thread_exit (void)
 #ifdef USERPROG
   process_exit ();
 #endif
+  edf_cancel (thread_current ());
 
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
@@ -352,8 +637,8 @@ thread_yield (void)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  if (cur != idle_thread) 
-    list_push_back (&ready_list, &cur->elem);
+  if (!is_idle (cur)) 
+    ready_push (cur->cpu, cur);
   cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
@@ -376,11 +661,86 @@ thread_foreach (thread_action_func *func, void *aux)
     }
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's priority to NEW_PRIORITY, yielding
+   if a ready thread now has a higher priority.  While other
+   threads donate a higher priority, the thread keeps running at
+   that one. */
 void
 thread_set_priority (int new_priority) 
 {
-  thread_current ()->priority = new_priority;
+  enum intr_level old_level;
+
+  ASSERT (PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+  /* The MLFQS sets priorities itself. */
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable ();
+  thread_current ()->base_priority = new_priority;
+  refresh_priority (thread_current ());
+  intr_set_level (old_level);
+  thread_preempt ();
+}
+
+/* Called by lock_acquire() before the current thread waits for
+   LOCK, which another thread holds.  Donates the current
+   thread's priority to the holder and, if the holder is itself
+   waiting for a lock, on down the chain of holders, up to
+   DONATION_DEPTH of them.  Interrupts must be off. */
+void
+thread_donate_priority (struct lock *lock)
+{
+  struct thread *t = thread_current ();
+  int depth;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (lock->holder != NULL);
+
+  t->wait_on_lock = lock;
+  list_push_back (&lock->holder->donations, &t->donation_elem);
+  for (depth = 0; depth < DONATION_DEPTH && t->wait_on_lock != NULL;
+       depth++)
+    {
+      struct thread *holder = t->wait_on_lock->holder;
+      if (holder == NULL || holder->priority >= t->priority)
+        break;
+      change_priority (holder, t->priority);
+      t = holder;
+    }
+}
+
+/* Called by lock_release() as the current thread gives up LOCK.
+   Drops the donations of the threads waiting for LOCK, which the
+   next holder receives instead.  Interrupts must be off. */
+void
+thread_remove_donations (struct lock *lock)
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e, *next;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (e = list_begin (&cur->donations); e != list_end (&cur->donations);
+       e = next)
+    {
+      struct thread *t = list_entry (e, struct thread, donation_elem);
+      next = list_next (e);
+      if (t->wait_on_lock == lock)
+        list_remove (e);
+    }
+  refresh_priority (cur);
+}
+
+/* Returns true if the thread with `elem' A has a lower priority
+   than the one with `elem' B.  With list_max(), picks the
+   highest-priority thread, and the earliest of equals. */
+bool
+thread_priority_less (const struct list_elem *a, const struct list_elem *b,
+                      void *aux UNUSED)
+{
+  return (list_entry (a, struct thread, elem)->priority
+          < list_entry (b, struct thread, elem)->priority);
 }
 
 /* Returns the current thread's priority. */
@@ -390,35 +750,289 @@ thread_get_priority (void)
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE and recomputes
+   its priority, yielding if it is no longer the highest. */
 void
-thread_set_nice (int nice UNUSED) 
+thread_set_nice (int nice) 
 {
-  /* Not yet implemented. */
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  if (nice < NICE_MIN)
+    nice = NICE_MIN;
+  if (nice > NICE_MAX)
+    nice = NICE_MAX;
+
+  old_level = intr_disable ();
+  cur->nice = nice;
+  if (thread_mlfqs)
+    cur->priority = cur->base_priority = mlfqs_priority (cur);
+  intr_set_level (old_level);
+  thread_preempt ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load = fp_round (load_avg * 100);
+  intr_set_level (old_level);
+  return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent = fp_round (thread_current ()->recent_cpu * 100);
+  intr_set_level (old_level);
+  return recent;
+}
+
+/* Gives the current thread an EDF reservation of BUDGET timer
+   ticks of CPU time in every PERIOD ticks, replacing any it
+   had, starting with a period that begins now.  PERIOD and
+   BUDGET both 0 cancel the reservation instead.  Returns false,
+   leaving any old reservation in place, if BUDGET does not fit
+   in PERIOD or if admitting the reservation would take the
+   total utilization past EDF_UTIL_MAX. */
+bool
+thread_edf_reserve (int64_t period, int budget)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  int util;
+
+  if (period == 0 && budget == 0)
+    {
+      edf_cancel (cur);
+      return true;
+    }
+  if (budget <= 0 || period < budget)
+    return false;
+  util = DIV_ROUND_UP ((int64_t) budget * EDF_UTIL_SCALE, period);
+
+  old_level = intr_disable ();
+  if (edf_utilization - cur->edf_util + util > EDF_UTIL_MAX)
+    {
+      intr_set_level (old_level);
+      return false;
+    }
+  edf_utilization += util - cur->edf_util;
+  edf_reservations++;
+  cur->edf_util = util;
+  cur->edf_period = period;
+  cur->edf_budget = budget;
+  cur->edf_deadline = timer_ticks () + period;
+  cur->edf_used = 0;
+  cur->edf_throttled = false;
+  cur->edf_job_done = false;
+  alarm_cancel (&cur->edf_alarm);
+  alarm_init (&cur->edf_alarm, edf_period_end, cur);
+  alarm_set (&cur->edf_alarm, cur->edf_deadline);
+  intr_set_level (old_level);
+
+  /* A thread with an earlier deadline may be ready. */
+  thread_preempt ();
+  return true;
+}
+
+/* Ends the current thread's job for this period and sleeps
+   until the next period begins.  Returns false at once if the
+   thread has no EDF reservation. */
+bool
+thread_edf_wait (void)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  if (cur->edf_period == 0)
+    return false;
+
+  old_level = intr_disable ();
+  cur->edf_job_done = true;
+  cur->edf_waiting = true;
+  thread_block ();
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Alarm function that ends a period of thread T_, an EDF
+   thread, at its deadline and starts the next one. */
+static void
+edf_period_end (void *t_)
+{
+  struct thread *t = t_;
+  bool ready = t->status == THREAD_READY;
+
+  if (!t->edf_job_done)
+    {
+      t->edf_misses++;
+      edf_total_misses++;
+    }
+
+  /* Refill the budget.  A ready thread moves to the queue that
+     matches. */
+  if (ready)
+    ready_remove (t);
+  t->edf_deadline += t->edf_period;
+  t->edf_used = 0;
+  t->edf_throttled = false;
+  t->edf_job_done = false;
+  alarm_set (&t->edf_alarm, t->edf_deadline);
+
+  if (t->edf_waiting)
+    {
+      t->edf_waiting = false;
+      thread_unblock (t);
+    }
+  else if (ready)
+    {
+      ready_push (t->cpu, t);
+      if (outranks (t, thread_current ()))
+        intr_yield_on_return ();
+    }
+}
+
+/* Drops T's EDF reservation, if it has one, giving its
+   utilization back. */
+static void
+edf_cancel (struct thread *t)
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (t->edf_period != 0)
+    {
+      ASSERT (t->status == THREAD_RUNNING);
+      alarm_cancel (&t->edf_alarm);
+      edf_utilization -= t->edf_util;
+      t->edf_util = 0;
+      t->edf_period = 0;
+    }
+  intr_set_level (old_level);
+}
+
+/* Returns true if T has an EDF reservation with budget left, so
+   that it belongs in an edf_queue when ready. */
+static bool
+edf_active (const struct thread *t)
+{
+  return t->edf_period != 0 && !t->edf_throttled;
+}
+
+/* Returns true if thread A should run ahead of thread B: A is
+   an active EDF thread and B is not or has a later deadline,
+   or neither is and A has the higher priority. */
+static bool
+outranks (const struct thread *a, const struct thread *b)
+{
+  if (edf_active (a) || edf_active (b))
+    return (edf_active (a)
+            && (!edf_active (b) || a->edf_deadline < b->edf_deadline));
+  return a->priority > b->priority;
+}
+
+/* Returns true if a thread ready on CPU should run ahead of T.
+   Interrupts must be off. */
+static bool
+ready_outranks (struct cpu *cpu, const struct thread *t)
+{
+  if (!list_empty (&cpu->edf_queue))
+    return outranks (list_entry (list_front (&cpu->edf_queue),
+                                 struct thread, elem), t);
+  return !edf_active (t) && ready_max_priority (cpu) > t->priority;
+}
+
+/* Returns true if the thread with `elem' A has an earlier EDF
+   deadline than the one with `elem' B. */
+static bool
+edf_deadline_less (const struct list_elem *a, const struct list_elem *b,
+                   void *aux UNUSED)
+{
+  return (list_entry (a, struct thread, elem)->edf_deadline
+          < list_entry (b, struct thread, elem)->edf_deadline);
+}
+
+/* Returns T's MLFQS priority, computed from its recent_cpu and
+   niceness in fixed point and then truncated, as 4.4BSD does. */
+static int
+mlfqs_priority (const struct thread *t)
+{
+  int priority = fp_to_int (fp_from_int (PRI_MAX - t->nice * 2)
+                            - t->recent_cpu / 4);
+
+  if (priority < PRI_MIN)
+    return PRI_MIN;
+  if (priority > PRI_MAX)
+    return PRI_MAX;
+  return priority;
+}
+
+/* Decays T's recent_cpu by COEFFICIENT, adds its niceness, and
+   recomputes its priority.  Called by thread_foreach(). */
+static void
+mlfqs_decay (struct thread *t, void *coefficient)
+{
+  if (is_idle (t))
+    return;
+  t->recent_cpu = fp_add_int (fp_mul (*(fixed_t *) coefficient,
+                                      t->recent_cpu), t->nice);
+  t->base_priority = mlfqs_priority (t);
+  change_priority (t, t->base_priority);
+}
+
+/* Returns the number of threads that are running or ready to
+   run, not counting idle threads.  Interrupts must be off. */
+static int
+mlfqs_ready_threads (void)
+{
+  int ready = 0;
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus[i].started)
+      ready += cpus[i].ready_cnt + !is_idle (cpus[i].running);
+  return ready;
+}
+
+/* MLFQS bookkeeping for a timer tick during which T ran.
+   Charges the tick to T, and updates T's priority every
+   MLFQS_PRIORITY_TICKS ticks.  Once a second, updates the load
+   average, then every thread's recent_cpu and priority; only
+   the boot CPU, which counts the timer ticks, does that.  Asks
+   to yield if a ready thread ends up ahead of T. */
+static void
+mlfqs_tick (struct thread *t)
+{
+  struct cpu *cpu = t->cpu;
+  int64_t ticks = timer_ticks ();
+
+  if (!is_idle (t))
+    t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+
+  if (cpu->id == 0 && ticks % TIMER_FREQ == 0)
+    {
+      int ready = mlfqs_ready_threads ();
+      fixed_t coefficient;
+
+      load_avg = (load_avg * 59 + fp_from_int (ready)) / 60;
+      coefficient = fp_div (load_avg * 2, fp_add_int (load_avg * 2, 1));
+      thread_foreach (mlfqs_decay, &coefficient);
+    }
+  else if (ticks % MLFQS_PRIORITY_TICKS == 0 && !is_idle (t))
+    t->priority = t->base_priority = mlfqs_priority (t);
+
+  if (ready_outranks (cpu, t))
+    intr_yield_on_return ();
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -429,14 +1043,81 @@ thread_get_recent_cpu (void)
    to it to enable thread_start() to continue, and immediately
    blocks.  After that, the idle thread never appears in the
    ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   special case when the ready list is empty.
+
+   That is the boot CPU's idle thread.  Every other CPU starts
+   out running its own, which goes straight to idle_loop(). */
 static void
 idle (void *idle_started_ UNUSED) 
 {
   struct semaphore *idle_started = idle_started_;
-  idle_thread = thread_current ();
+  cpu_current ()->idle_thread = thread_current ();
   sema_up (idle_started);
+  idle_loop ();
+}
 
+/* Reaper thread.  Frees the pages of threads that nothing holds
+   any longer, or zeroes them and keeps them in page_cache. */
+static void
+reaper (void *aux UNUSED)
+{
+  reaper_thread = thread_current ();
+  for (;;)
+    {
+      struct thread *t;
+      bool cache;
+
+      intr_disable ();
+      while (list_empty (&zombie_list))
+        {
+          reaper_sleeping = true;
+          thread_block ();
+        }
+      t = list_entry (list_pop_front (&zombie_list), struct thread, elem);
+      cache = page_cache_cnt < THREAD_CACHE_MAX;
+      intr_enable ();
+
+      if (cache)
+        {
+          memset (t, 0, PGSIZE);
+          intr_disable ();
+          if (page_cache_cnt < THREAD_CACHE_MAX)
+            {
+              page_cache[page_cache_cnt++] = t;
+              t = NULL;
+            }
+          intr_enable ();
+        }
+      if (t != NULL)
+        {
+          palloc_free_page (t);
+          pages_freed++;
+        }
+    }
+}
+
+/* Returns a zeroed page for a new thread, from page_cache if it
+   has one, or a null pointer if memory is exhausted. */
+static void *
+alloc_thread_page (void)
+{
+  enum intr_level old_level = intr_disable ();
+  void *page = NULL;
+
+  if (page_cache_cnt > 0)
+    {
+      page = page_cache[--page_cache_cnt];
+      pages_reused++;
+    }
+  intr_set_level (old_level);
+
+  return page != NULL ? page : palloc_get_page (PAL_ZERO);
+}
+
+/* The idle threads' main loop. */
+static void
+idle_loop (void)
+{
   for (;;) 
     {
       /* Let someone else run. */
@@ -454,7 +1135,12 @@ idle (void *idle_started_ UNUSED)
          time.
 
          See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-         7.11.1 "HLT Instruction". */
+         7.11.1 "HLT Instruction".
+
+         The interrupt lock has to go first, so that other CPUs
+         can run while this one waits. */
+      timer_idle_enter ();
+      intr_lock_release ();
       asm volatile ("sti; hlt" : : : "memory");
     }
 }
@@ -484,6 +1170,22 @@ running_thread (void)
   return pg_round_down (esp);
 }
 
+/* Returns the CPU we are running on.  Interrupts should be off,
+   or the running thread might move to another CPU before the
+   caller uses the result. */
+struct cpu *
+cpu_current (void)
+{
+  return smp_active ? running_thread ()->cpu : &cpus[0];
+}
+
+/* Returns true if T is a CPU's idle thread. */
+static bool
+is_idle (const struct thread *t)
+{
+  return t == t->cpu->idle_thread;
+}
+
 /* Returns true if T appears to point to a valid thread. */
 static bool
 is_thread (struct thread *t)
@@ -506,7 +1208,10 @@ init_thread (struct thread *t, const char *name, int priority)
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
-  t->priority = priority;
+  t->priority = t->base_priority = priority;
+  t->refs = 1;
+  list_init (&t->donations);
+  t->cpu = cpu_current ();
   t->magic = THREAD_MAGIC;
 
   old_level = intr_disable ();
@@ -532,18 +1237,195 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
-/* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+/* Sets up CPU's run queues, and gives it ID. */
+static void
+init_cpu (struct cpu *cpu, int id)
+{
+  int pri;
+
+  cpu->id = id;
+  for (pri = PRI_MIN; pri <= PRI_MAX; pri++)
+    list_init (&cpu->ready_queues[pri - PRI_MIN]);
+  list_init (&cpu->edf_queue);
+}
+
+/* Adds T to CPU's EDF queue, in order of deadline, if it has an
+   active EDF reservation, and otherwise to the back of CPU's
+   run queue for its priority.  Interrupts must be off. */
+static void
+ready_push (struct cpu *cpu, struct thread *t)
+{
+  int idx = t->priority - PRI_MIN;
+
+  t->cpu = cpu;
+  if (edf_active (t))
+    {
+      list_insert_ordered (&cpu->edf_queue, &t->elem,
+                           edf_deadline_less, NULL);
+      cpu->ready_cnt++;
+      return;
+    }
+  list_push_back (&cpu->ready_queues[idx], &t->elem);
+  cpu->ready_bitmap[idx / 32] |= 1u << (idx % 32);
+  cpu->ready_cnt++;
+}
+
+/* Removes T, which must be ready, from its run queue.
+   Interrupts must be off. */
+static void
+ready_remove (struct thread *t)
+{
+  struct cpu *cpu = t->cpu;
+  int idx = t->priority - PRI_MIN;
+
+  ASSERT (t->status == THREAD_READY);
+
+  list_remove (&t->elem);
+  if (!edf_active (t) && list_empty (&cpu->ready_queues[idx]))
+    cpu->ready_bitmap[idx / 32] &= ~(1u << (idx % 32));
+  cpu->ready_cnt--;
+}
+
+/* Removes and returns the thread at the front of CPU's run queue
+   for PRIORITY, which must not be empty.  Interrupts must be
+   off. */
 static struct thread *
-next_thread_to_run (void) 
+ready_pop (struct cpu *cpu, int priority)
+{
+  int idx = priority - PRI_MIN;
+  struct list *queue = &cpu->ready_queues[idx];
+  struct thread *t = list_entry (list_pop_front (queue), struct thread, elem);
+
+  if (list_empty (queue))
+    cpu->ready_bitmap[idx / 32] &= ~(1u << (idx % 32));
+  cpu->ready_cnt--;
+  return t;
+}
+
+/* Sets T's current priority to PRIORITY, moving it to the
+   matching run queue if it is ready.  Interrupts must be off. */
+static void
+change_priority (struct thread *t, int priority)
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
+  if (t->status == THREAD_READY && !is_idle (t))
+    {
+      ready_remove (t);
+      t->priority = priority;
+      ready_push (t->cpu, t);
+    }
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    t->priority = priority;
+}
+
+/* Recomputes T's priority as the higher of its base priority
+   and the priorities donated to it.  Interrupts must be off. */
+static void
+refresh_priority (struct thread *t)
+{
+  int priority = t->base_priority;
+  struct list_elem *e;
+
+  for (e = list_begin (&t->donations); e != list_end (&t->donations);
+       e = list_next (e))
+    {
+      struct thread *donor = list_entry (e, struct thread, donation_elem);
+      if (donor->priority > priority)
+        priority = donor->priority;
+    }
+  change_priority (t, priority);
+}
+
+/* Returns the highest priority of any thread ready on CPU, or
+   PRI_MIN - 1 if no thread is.  Interrupts must be off. */
+static int
+ready_max_priority (const struct cpu *cpu)
+{
+  int word;
+
+  for (word = DIV_ROUND_UP (PRI_CNT, 32) - 1; word >= 0; word--)
+    if (cpu->ready_bitmap[word] != 0)
+      return (PRI_MIN + word * 32 + 31
+              - __builtin_clz (cpu->ready_bitmap[word]));
+  return PRI_MIN - 1;
+}
+
+/* If another CPU is idle, interrupts it, so that it steals a
+   thread from the current CPU's run queues.  Interrupts must be
+   off. */
+static void
+kick_idle_cpu (void)
+{
+  struct cpu *self = cpu_current ();
+  int i;
+
+  if (!smp_active)
+    return;
+
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      struct cpu *cpu = &cpus[i];
+      if (cpu != self && cpu->started && is_idle (cpu->running))
+        {
+          lapic_send_ipi (cpu->apic_id, LAPIC_VEC_RESCHEDULE);
+          return;
+        }
+    }
+}
+
+/* Chooses and returns the next thread for CPU to run.  Should
+   return a thread from CPU's run queues, unless they are empty.
+   (If the running thread can continue running, then it will be
+   in the run queue.)  Picks the thread that has waited longest
+   among those of the highest priority, unless a thread in the
+   EDF queue is ready, in which case picks the one with the
+   earliest deadline.
+
+   If CPU's run queues are empty, steals from another CPU: an
+   EDF thread if any CPU has one ready, otherwise the same way
+   from the CPU with the highest-priority ready thread.  If no
+   CPU has a thread ready, returns CPU's idle thread. */
+static struct thread *
+next_thread_to_run (struct cpu *cpu) 
+{
+  struct cpu *victim = cpu;
+  int pri = ready_max_priority (cpu);
+
+  if (!list_empty (&cpu->edf_queue))
+    return edf_pop (cpu);
+
+  if (pri < PRI_MIN && smp_active)
+    {
+      int i;
+
+      for (i = 0; i < cpu_cnt; i++)
+        if (cpus[i].started && !list_empty (&cpus[i].edf_queue))
+          {
+            cpu->steals++;
+            return edf_pop (&cpus[i]);
+          }
+      for (i = 0; i < cpu_cnt; i++)
+        if (cpus[i].started && ready_max_priority (&cpus[i]) > pri)
+          {
+            victim = &cpus[i];
+            pri = ready_max_priority (victim);
+          }
+      if (victim != cpu)
+        cpu->steals++;
+    }
+
+  if (pri < PRI_MIN)
+    return cpu->idle_thread;
+  return ready_pop (victim, pri);
+}
+
+/* Removes and returns the thread with the earliest deadline in
+   CPU's EDF queue, which must not be empty.  Interrupts must be
+   off. */
+static struct thread *
+edf_pop (struct cpu *cpu)
+{
+  cpu->ready_cnt--;
+  return list_entry (list_pop_front (&cpu->edf_queue), struct thread, elem);
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -573,23 +1455,24 @@ thread_schedule_tail (struct thread *prev)
   cur->status = THREAD_RUNNING;
 
   /* Start new time slice. */
-  thread_ticks = 0;
+  cur->cpu->running = cur;
+  cur->cpu->thread_ticks = 0;
 
 #ifdef USERPROG
   /* Activate the new address space. */
   process_activate ();
 #endif
 
-  /* If the thread we switched from is dying, destroy its struct
-     thread.  This must happen late so that thread_exit() doesn't
-     pull out the rug under itself.  (We don't free
-     initial_thread because its memory was not obtained via
-     palloc().) */
+  /* If the thread we switched from is dying, drop its hold on
+     its struct thread, which is freed once its parent has
+     dropped its own.  This must happen late so that
+     thread_exit() doesn't pull out the rug under itself.  (We
+     don't free initial_thread because its memory was not
+     obtained via palloc().) */
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      /* ++++ Project 2.3 Process Hierachy  ++++ */
-      // palloc_free_page (prev); // process discriptor delete
+      thread_release (prev);
     }
 }
 
@@ -604,18 +1487,123 @@ static void
 schedule (void) 
 {
   struct thread *cur = running_thread ();
-  struct thread *next = next_thread_to_run ();
+  struct thread *next = next_thread_to_run (cur->cpu);
   struct thread *prev = NULL;
 
   ASSERT (intr_get_level () == INTR_OFF);
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  /* NEXT runs on this CPU from here on, even if it was stolen
+     from another CPU's run queue. */
+  next->cpu = cur->cpu;
+  account_switch (cur, next);
   if (cur != next)
     prev = switch_threads (cur, next);
   thread_schedule_tail (prev);
 }
 
+/* Charges the time since CUR and NEXT last changed state to
+   them, as CUR stops running on its CPU and NEXT starts, counts
+   the switch, and adds it to the trace.  A switch away from a
+   thread that blocks is voluntary; one away from a thread that
+   is still ready, because it was preempted or yielded, is
+   involuntary.  Interrupts must be off. */
+static void
+account_switch (struct thread *cur, struct thread *next)
+{
+  int64_t now = timer_usec ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  cur->stats.run_time += now - cur->sched_stamp;
+  cur->sched_stamp = now;
+  if (cur == next)
+    return;
+
+  if (cur->status == THREAD_READY)
+    cur->stats.involuntary++;
+  else if (cur->status == THREAD_BLOCKED)
+    cur->stats.voluntary++;
+
+  if (next->status == THREAD_READY)
+    {
+      int64_t wait = now - next->sched_stamp;
+
+      next->stats.wait_time += wait;
+      if (next->sched_woken)
+        {
+          next->stats.wakeup_latency += wait;
+          if (wait > next->stats.wakeup_latency_max)
+            next->stats.wakeup_latency_max = wait;
+        }
+    }
+  next->sched_woken = false;
+  next->sched_stamp = now;
+
+  if (trace != NULL)
+    {
+      struct trace_entry *e = &trace[trace_cnt++ % trace_size];
+      e->time = now;
+      e->cpu = cur->cpu->id;
+      e->status = cur->status;
+      e->prev_tid = cur->tid;
+      e->next_tid = next->tid;
+      strlcpy (e->prev_name, cur->name, sizeof e->prev_name);
+      strlcpy (e->next_name, next->name, sizeof e->next_name);
+    }
+}
+
+/* Copies T's scheduler statistics into STATS, adding the time T
+   has spent so far running or ready.  Interrupts must be off. */
+static void
+get_stats (const struct thread *t, struct schedstat *stats)
+{
+  int64_t now = timer_usec ();
+
+  *stats = t->stats;
+  if (t->status == THREAD_RUNNING)
+    stats->run_time += now - t->sched_stamp;
+  else if (t->status == THREAD_READY)
+    stats->wait_time += now - t->sched_stamp;
+}
+
+/* Prints T's scheduler statistics.  Called by thread_foreach(). */
+static void
+print_thread_stats (struct thread *t, void *aux UNUSED)
+{
+  struct schedstat s;
+
+  get_stats (t, &s);
+  printf ("  %4d %-16s %10lld %10lld %6llu %6llu %6llu %8lld %8lld\n",
+          t->tid, t->name, s.run_time, s.wait_time, s.voluntary,
+          s.involuntary, s.wakeups,
+          s.wakeups > 0 ? s.wakeup_latency / (long long) s.wakeups : 0,
+          s.wakeup_latency_max);
+}
+
+/* Prints the trace of recent context switches, oldest first. */
+static void
+print_trace (void)
+{
+  static const char *states[] = {"running", "ready", "blocked", "dying"};
+  unsigned long long i, first;
+
+  if (trace == NULL || trace_cnt == 0)
+    return;
+
+  first = trace_cnt > trace_size ? trace_cnt - trace_size : 0;
+  printf ("Switch trace (last %llu of %llu switches, times in us):\n",
+          trace_cnt - first, trace_cnt);
+  for (i = first; i < trace_cnt; i++)
+    {
+      const struct trace_entry *e = &trace[i % trace_size];
+      printf ("  %lld cpu%d %s(%d) %s -> %s(%d)\n",
+              e->time, e->cpu, e->prev_name, e->prev_tid,
+              states[e->status], e->next_name, e->next_tid);
+    }
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) 
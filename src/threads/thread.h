@@ -3,8 +3,12 @@
 
 #include <debug.h>
 #include <list.h>
+#include <schedstat.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "synch.h"
+#include "threads/fixed-point.h"
+#include "devices/timer.h"
 #include "filesys/file.h"
 
 /* States in a thread's life cycle. */
@@ -34,6 +38,19 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, for the MLFQS. */
+#define NICE_MIN -20                    /* Least nice. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Nicest. */
+
+/* EDF reservations.  A reservation's utilization, its budget
+   divided by its period, is kept in units of 1/EDF_UTIL_SCALE
+   of a CPU, and the total over all threads may not exceed
+   EDF_UTIL_MAX, leaving the rest of the CPU to interrupts and
+   to threads without a reservation. */
+#define EDF_UTIL_SCALE 1000
+#define EDF_UTIL_MAX 900
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -97,8 +114,43 @@ struct thread
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
-    int priority;                       /* Priority. */
+    int priority;                       /* Priority, including donations. */
+    int base_priority;                  /* Priority set by the thread. */
     struct list_elem allelem;           /* List element for all threads list. */
+    struct cpu *cpu;                    /* CPU running it or queueing it. */
+    int refs;                           /* Holds on its page, see
+                                           thread_release(). */
+
+    /* Priority donation, owned by thread.c. */
+    struct lock *wait_on_lock;          /* Lock being waited for, if any. */
+    struct list donations;              /* Threads donating to this one. */
+    struct list_elem donation_elem;     /* Element in holder's donations. */
+
+    /* MLFQS, owned by thread.c. */
+    int nice;                           /* Niceness, -20 to 20. */
+    fixed_t recent_cpu;                 /* Recent CPU time, in ticks. */
+
+    /* EDF reservation, owned by thread.c.  A thread with one
+       runs ahead of every thread without one for edf_budget
+       ticks of each edf_period, until it calls
+       thread_edf_wait() or uses up its budget. */
+    int64_t edf_period;                 /* Ticks per period, 0 if none. */
+    int64_t edf_deadline;               /* End of the current period. */
+    int edf_budget;                     /* Ticks of CPU per period. */
+    int edf_used;                       /* Ticks used this period. */
+    int edf_util;                       /* Utilization, see EDF_UTIL_SCALE. */
+    int edf_misses;                     /* Periods that ended too soon. */
+    bool edf_throttled;                 /* Budget used up this period? */
+    bool edf_job_done;                  /* Waited for the next period? */
+    bool edf_waiting;                   /* Blocked in thread_edf_wait()? */
+    struct alarm edf_alarm;             /* Fires at edf_deadline. */
+
+    /* Scheduler statistics, owned by thread.c. */
+    struct schedstat stats;             /* Totals so far. */
+    int64_t sched_stamp;                /* timer_usec() at last change
+                                           between running, ready, and
+                                           blocked. */
+    bool sched_woken;                   /* Ready since a wakeup? */
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
@@ -109,6 +161,7 @@ struct thread
     struct thread* parent_thread; // Point to the parent process
     struct list child_list; // Child Process List
     struct list_elem child_elem; // If you become a part of yourself,
+    bool waitable; // user process라서 부모가 wait할 수 있는지
 
     struct semaphore sema_for_wait; // To wait for the exit of the child process
     struct semaphore sema_for_exec; // To create child process
@@ -129,6 +182,8 @@ struct thread
 
    // Project 4 directory
    struct dir * current_dir;
+   // Project 4 journal: 열려 있는 transaction handle의 중첩 깊이
+   int journal_depth;
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
@@ -139,17 +194,28 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+struct cpu;
+
 void thread_init (void);
 void thread_start (void);
+struct thread *thread_create_idle (struct cpu *);
+void thread_start_ap (void) NO_RETURN;
 
 void thread_tick (void);
 void thread_print_stats (void);
+bool thread_get_stats (tid_t, struct schedstat *);
+void thread_trace_configure (size_t cnt);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
 
+void thread_release (struct thread *);
+
 void thread_block (void);
 void thread_unblock (struct thread *);
+void thread_preempt (void);
+bool thread_priority_less (const struct list_elem *,
+                           const struct list_elem *, void *aux);
 
 struct thread *thread_current (void);
 tid_t thread_tid (void);
@@ -164,10 +230,15 @@ void thread_foreach (thread_action_func *, void *);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_donate_priority (struct lock *);
+void thread_remove_donations (struct lock *);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
+bool thread_edf_reserve (int64_t period, int budget);
+bool thread_edf_wait (void);
+
 #endif /* threads/thread.h */
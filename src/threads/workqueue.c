@@ -0,0 +1,276 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* Workers in system_wq.  Work may block for a while, as a
+   journal commit does, so more than one keeps that from holding
+   up the rest. */
+#define SYSTEM_WQ_WORKERS 4
+
+struct workqueue system_wq;
+
+static thread_func worker_thread NO_RETURN;
+static void delayed_work_due (void *work);
+static bool work_running (const struct work *);
+static void wait_progress (struct workqueue *);
+
+/* Initializes WQ with WORKER_CNT worker threads at PRIORITY,
+   named after NAME.  Must be called after thread_start(). */
+void
+workqueue_init (struct workqueue *wq, const char *name,
+                int worker_cnt, int priority)
+{
+  int i;
+
+  ASSERT (wq != NULL);
+  ASSERT (worker_cnt > 0 && worker_cnt <= WORKQUEUE_MAX_WORKERS);
+
+  strlcpy (wq->name, name, sizeof wq->name);
+  list_init (&wq->pending);
+  sema_init (&wq->ready, 0);
+  sema_init (&wq->progress, 0);
+  wq->flushers = 0;
+  wq->worker_cnt = worker_cnt;
+  for (i = 0; i < worker_cnt; i++)
+    {
+      struct worker *w = &wq->workers[i];
+      char thread_name[16];
+
+      w->wq = wq;
+      w->current = NULL;
+      snprintf (thread_name, sizeof thread_name, "%s%d", name, i);
+      if (thread_create (thread_name, priority, worker_thread, w)
+          == TID_ERROR)
+        PANIC ("Failed to create worker thread for %s", name);
+    }
+}
+
+/* Initializes system_wq.  Its workers run ahead of ordinary
+   threads, as the block devices' I/O threads do, since work
+   is short and others may be waiting on it. */
+void
+workqueue_init_system (void)
+{
+  workqueue_init (&system_wq, "kworker", SYSTEM_WQ_WORKERS, PRI_MAX);
+}
+
+/* Waits until no work is pending or running on WQ.  Does not
+   wait for delayed work that is not yet due.  Must not be called
+   from WQ's own work. */
+void
+workqueue_flush (struct workqueue *wq)
+{
+  enum intr_level old_level = intr_disable ();
+  int i;
+
+  for (;;)
+    {
+      bool busy = !list_empty (&wq->pending);
+
+      for (i = 0; i < wq->worker_cnt; i++)
+        if (wq->workers[i].current != NULL)
+          busy = true;
+      if (!busy)
+        break;
+      wait_progress (wq);
+    }
+  intr_set_level (old_level);
+}
+
+/* Initializes WORK to call FUNC with AUX when it runs.  The work
+   is not queued. */
+void
+work_init (struct work *work, work_func *func, void *aux)
+{
+  ASSERT (func != NULL);
+
+  work->wq = NULL;
+  work->pending = false;
+  work->func = func;
+  work->aux = aux;
+  alarm_init (&work->alarm, delayed_work_due, work);
+}
+
+/* Queues WORK on WQ, to run as soon as a worker is free.
+   Returns false, doing nothing, if WORK is already pending.
+   May be called from an interrupt handler. */
+bool
+work_queue (struct workqueue *wq, struct work *work)
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (work->pending)
+    {
+      intr_set_level (old_level);
+      return false;
+    }
+  work->pending = true;
+  work->wq = wq;
+  list_push_back (&wq->pending, &work->elem);
+  intr_set_level (old_level);
+
+  sema_up (&wq->ready);
+  return true;
+}
+
+/* Queues WORK on WQ once TICKS timer ticks have passed.  Returns
+   false, doing nothing, if WORK is already pending.  May be
+   called from an interrupt handler. */
+bool
+work_queue_delayed (struct workqueue *wq, struct work *work, int64_t ticks)
+{
+  enum intr_level old_level;
+
+  if (ticks <= 0)
+    return work_queue (wq, work);
+
+  old_level = intr_disable ();
+  if (work->pending)
+    {
+      intr_set_level (old_level);
+      return false;
+    }
+  work->pending = true;
+  work->wq = wq;
+  alarm_set (&work->alarm, timer_ticks () + ticks);
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Returns true if WORK is queued, or delayed, and has not yet
+   started. */
+bool
+work_pending (const struct work *work)
+{
+  return work->pending;
+}
+
+/* Cancels WORK if it is pending.  Returns true if it was, false
+   if it had already started or was never queued.  Does not wait
+   for WORK to finish if it is running. */
+bool
+work_cancel (struct work *work)
+{
+  enum intr_level old_level = intr_disable ();
+  bool was_pending = work->pending;
+
+  if (was_pending)
+    {
+      /* Delayed work that is not yet due has no place in the
+         pending list. */
+      if (!alarm_cancel (&work->alarm))
+        list_remove (&work->elem);
+      work->pending = false;
+    }
+  intr_set_level (old_level);
+  return was_pending;
+}
+
+/* Cancels WORK and waits for it to finish if it is running,
+   cancelling it again if it queued itself meanwhile, so that on
+   return WORK is neither pending nor running.  Returns true if
+   it was pending.  Must not be called from WORK itself. */
+bool
+work_cancel_sync (struct work *work)
+{
+  bool was_pending = false;
+
+  do
+    {
+      was_pending |= work_cancel (work);
+      work_flush (work);
+    }
+  while (work->pending);
+  return was_pending;
+}
+
+/* Waits until WORK, if it is pending or running, has finished.
+   Delayed work that is not yet due is waited for too.  Must not
+   be called from WORK itself. */
+void
+work_flush (struct work *work)
+{
+  enum intr_level old_level = intr_disable ();
+
+  while (work->wq != NULL && (work->pending || work_running (work)))
+    wait_progress (work->wq);
+  intr_set_level (old_level);
+}
+
+/* A worker thread.  Runs the work queued on its workqueue, one
+   at a time. */
+static void
+worker_thread (void *w_)
+{
+  struct worker *w = w_;
+  struct workqueue *wq = w->wq;
+
+  for (;;)
+    {
+      struct work *work;
+
+      /* Cancelled work leaves an extra up behind, so the queue
+         may turn out to be empty. */
+      sema_down (&wq->ready);
+      intr_disable ();
+      if (list_empty (&wq->pending))
+        {
+          intr_enable ();
+          continue;
+        }
+      work = list_entry (list_pop_front (&wq->pending), struct work, elem);
+      work->pending = false;
+      w->current = work;
+      intr_enable ();
+
+      /* WORK may be freed or queued again from here on. */
+      work->func (work->aux);
+
+      intr_disable ();
+      w->current = NULL;
+      while (wq->flushers > 0)
+        {
+          wq->flushers--;
+          sema_up (&wq->progress);
+        }
+      intr_enable ();
+    }
+}
+
+/* Alarm function that queues delayed WORK_ when it is due. */
+static void
+delayed_work_due (void *work_)
+{
+  struct work *work = work_;
+
+  list_push_back (&work->wq->pending, &work->elem);
+  sema_up (&work->wq->ready);
+}
+
+/* Returns true if a worker is running WORK.  Interrupts must be
+   off. */
+static bool
+work_running (const struct work *work)
+{
+  struct workqueue *wq = work->wq;
+  int i;
+
+  for (i = 0; i < wq->worker_cnt; i++)
+    if (wq->workers[i].current == work)
+      return true;
+  return false;
+}
+
+/* Waits until a worker of WQ finishes some work.  Interrupts
+   must be off. */
+static void
+wait_progress (struct workqueue *wq)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  wq->flushers++;
+  sema_down (&wq->progress);
+}
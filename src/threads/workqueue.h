@@ -0,0 +1,70 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/timer.h"
+#include "threads/synch.h"
+
+/* Workqueues: calls to a function, made later by a kernel
+   worker thread.
+
+   Unlike an alarm's, a work function runs in a thread, so it may
+   sleep, take locks, and do I/O.  Work may be queued from
+   anywhere, including an interrupt handler.  A struct work is
+   embedded in whatever it works on, so queueing work never
+   allocates memory, and the function may free the structure
+   that holds it. */
+typedef void work_func (void *aux);
+
+struct work
+  {
+    struct list_elem elem;      /* Element in a workqueue's pending list. */
+    struct workqueue *wq;       /* Queue it was last queued on. */
+    bool pending;               /* Queued, or waiting to be, and not started? */
+    work_func *func;            /* Function to call. */
+    void *aux;                  /* Passed to FUNC. */
+    struct alarm alarm;         /* Queues it when delayed work is due. */
+  };
+
+/* Most worker threads a workqueue can have. */
+#define WORKQUEUE_MAX_WORKERS 8
+
+/* A worker thread. */
+struct worker
+  {
+    struct workqueue *wq;       /* Queue it serves. */
+    struct work *current;       /* Work it is running, if any. */
+  };
+
+/* A queue of work served by a fixed pool of worker threads,
+   which take work in the order it was queued. */
+struct workqueue
+  {
+    char name[16];              /* Name, for the workers' names. */
+    struct list pending;        /* Work due to run, oldest first. */
+    struct semaphore ready;     /* Ups once per work queued. */
+    struct semaphore progress;  /* Ups as work finishes, for flushers. */
+    int flushers;               /* Threads down on `progress'. */
+    int worker_cnt;             /* Number of workers. */
+    struct worker workers[WORKQUEUE_MAX_WORKERS];
+  };
+
+/* Workqueue shared by the kernel's modules. */
+extern struct workqueue system_wq;
+
+void workqueue_init (struct workqueue *, const char *name,
+                     int worker_cnt, int priority);
+void workqueue_init_system (void);
+void workqueue_flush (struct workqueue *);
+
+void work_init (struct work *, work_func *, void *aux);
+bool work_queue (struct workqueue *, struct work *);
+bool work_queue_delayed (struct workqueue *, struct work *, int64_t ticks);
+bool work_pending (const struct work *);
+bool work_cancel (struct work *);
+bool work_cancel_sync (struct work *);
+void work_flush (struct work *);
+
+#endif /* threads/workqueue.h */
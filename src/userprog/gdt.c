@@ -1,6 +1,7 @@
 #include "userprog/gdt.h"
 #include <debug.h>
 #include "userprog/tss.h"
+#include "threads/cpu.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
 
@@ -21,8 +22,11 @@
 
    For more information on the GDT as used here, refer to
    [IA32-v3a] 3.2 "Using Segments" through 3.5 "System Descriptor
-   Types". */
-static uint64_t gdt[SEL_CNT];
+   Types".
+
+   Each CPU has a GDT of its own, because each has its own TSS,
+   and loading a TSS marks its descriptor busy. */
+static uint64_t gdts[CPU_MAX][SEL_CNT];
 
 /* GDT helpers. */
 static uint64_t make_code_desc (int dpl);
@@ -30,11 +34,13 @@ static uint64_t make_data_desc (int dpl);
 static uint64_t make_tss_desc (void *laddr);
 static uint64_t make_gdtr_operand (uint16_t limit, void *base);
 
-/* Sets up a proper GDT.  The bootstrap loader's GDT didn't
-   include user-mode selectors or a TSS, but we need both now. */
+/* Sets up a proper GDT for the current CPU.  The bootstrap
+   loader's GDT didn't include user-mode selectors or a TSS, but
+   we need both now.  Call tss_init() first. */
 void
 gdt_init (void)
 {
+  uint64_t *gdt = gdts[cpu_current ()->id];
   uint64_t gdtr_operand;
 
   /* Initialize GDT. */
@@ -48,7 +54,7 @@ gdt_init (void)
   /* Load GDTR, TR.  See [IA32-v3a] 2.4.1 "Global Descriptor
      Table Register (GDTR)", 2.4.4 "Task Register (TR)", and
      6.2.4 "Task Register".  */
-  gdtr_operand = make_gdtr_operand (sizeof gdt - 1, gdt);
+  gdtr_operand = make_gdtr_operand (sizeof gdts[0] - 1, gdt);
   asm volatile ("lgdt %0" : : "m" (gdtr_operand));
   asm volatile ("ltr %w0" : : "q" (SEL_TSS));
 }
@@ -23,6 +23,7 @@
 
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
+static struct thread *find_child (tid_t);
 
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
@@ -57,21 +58,7 @@ process_execute (const char *file_name)
   /* Create a new thread to execute FILE_NAME. */
   tid = thread_create (prog_name, PRI_DEFAULT, start_process, fn_copy);
   /* ++++ Project 2.1 Argument Passing ++++ */
-  struct thread *cur = thread_current();
-  struct list_elem *e;
-  struct thread *child_thread = NULL;
-
-
-  /* +++++++++++++++++++++++++++++++++++++ */
-
-  for (e = list_begin (&cur->child_list); e != list_end (&cur->child_list); e = list_next (e))
-  {
-    if (list_entry (e, struct thread, child_elem)->tid == tid) 
-    {
-      child_thread = list_entry (e, struct thread, child_elem);
-      break;
-    }
-  }
+  struct thread *child_thread = find_child (tid);
 
   if (child_thread == NULL) return -1;
 
@@ -95,6 +82,9 @@ start_process (void *file_name_)
   char *file_name = file_name_;
   struct intr_frame if_;
   bool success;
+
+  // user process만 부모가 wait할 수 있음 (kernel thread는 exit 시 스스로 떨어져 나감)
+  thread_current()->waitable = true;
   
   /* ++++ Project2.1 Argument Passing  ++++ */
   // 1. declare variable
@@ -170,51 +160,65 @@ int
 process_wait (tid_t child_tid UNUSED) 
 {
   /* ++++ Project 2.4 wait implement ++++ */
-  struct thread *cur = thread_current();
-  struct list_elem *e;
-  struct thread *child_thread = NULL;
-
   // Search to know information of process
-  for (e = list_begin (&cur->child_list); e != list_end (&cur->child_list); e = list_next (e))
-  {
-    if (list_entry (e, struct thread, child_elem)->tid == child_tid) 
-    {
-      child_thread = list_entry (e, struct thread, child_elem);
-      /* Error, if the process calls wait() twice */
-      if (child_thread->called_wait) 
-        return -1;
-      /* called wait() */
-      child_thread->called_wait = 1;
-
-      /* If thread is in exit state, 
-         child_thread is exit_status is returned */
-      if (child_thread->thread_exit) 
-        return child_thread->exit_status;
-      break;
-    }
-  }
+  struct thread *child_thread = find_child (child_tid);
+  enum intr_level old_level;
+  int status;
 
   // Abnormal exit
   if (child_thread == NULL)
     return -1;
+  /* Error, if the process calls wait() twice */
+  if (child_thread->called_wait) 
+    return -1;
+  /* called wait() */
+  child_thread->called_wait = 1;
 
   // Wait for the parent process until the child process is exit
+  // 이미 exit한 child면 sema가 이미 up 되어 있어 바로 return
   sema_down(&child_thread->sema_for_wait); 
   
-  if (child_thread->thread_exit == 0)
-    return -1;
-  
+  status = child_thread->thread_exit ? child_thread->exit_status : -1;
+
+  // child_list에서 빼고 부모의 hold를 놓음: child가 완전히 죽으면 reaper가 page 회수
+  old_level = intr_disable ();
   list_remove(&child_thread->child_elem);
-  int status = child_thread->exit_status;
-  palloc_free_page(child_thread);
+  child_thread->parent_thread = NULL;
+  thread_release(child_thread);
+  intr_set_level (old_level);
   return status;
 }
 
+/* Returns the running thread's child with TID, or a null
+   pointer if it has none.  Interrupts are turned off while
+   searching, because a child that is a kernel thread removes
+   itself from the list when it exits. */
+static struct thread *
+find_child (tid_t tid)
+{
+  struct thread *cur = thread_current ();
+  struct thread *child_thread = NULL;
+  enum intr_level old_level = intr_disable ();
+  struct list_elem *e;
+
+  for (e = list_begin (&cur->child_list); e != list_end (&cur->child_list); e = list_next (e))
+  {
+    if (list_entry (e, struct thread, child_elem)->tid == tid) 
+    {
+      child_thread = list_entry (e, struct thread, child_elem);
+      break;
+    }
+  }
+  intr_set_level (old_level);
+  return child_thread;
+}
+
 /* Free the current process's resources. */
 void
 process_exit (void)
 {
   struct thread *cur = thread_current ();
+  enum intr_level old_level;
   uint32_t *pd;
 
 
@@ -240,25 +244,35 @@ process_exit (void)
       pagedir_activate (NULL);
       pagedir_destroy (pd);
     }
-  // memory leak
+  // 깨어난 부모가 exit 여부를 바로 볼 수 있도록 sema_up 전에 표시
+  thread_current ()->thread_exit = 1;
   if (thread_current()->parent_thread != NULL) 
     sema_up(&thread_current()->sema_for_wait);
   
-  thread_current ()->thread_exit = 1;
-  
   file_close(thread_current()->running_file);
   
   for (int i = 0; i < 128; i ++)
     file_close(thread_current()->fdt[i]);
   
-  struct list_elem *e;
-  struct thread *child_thread = NULL;
+  old_level = intr_disable ();
 
-  for (e = list_begin (&cur->child_list); e != list_end (&cur->child_list); e = list_next (e))
+  // 자식들은 기다리지 않고 놓아줌: 각자 exit한 뒤 reaper가 page 회수
+  while (!list_empty (&cur->child_list))
   {
-      child_thread = list_entry (e, struct thread, child_elem);
-      process_wait(child_thread->tid);
+      struct thread *child_thread = list_entry (list_pop_front (&cur->child_list),
+                                                struct thread, child_elem);
+      child_thread->parent_thread = NULL;
+      thread_release(child_thread);
   }
+
+  // 부모가 wait하지 않는 kernel thread는 스스로 부모에게서 떨어져 나감
+  if (!cur->waitable && cur->parent_thread != NULL)
+  {
+      list_remove(&cur->child_elem);
+      cur->parent_thread = NULL;
+      thread_release(cur);
+  }
+  intr_set_level (old_level);
 }
 
 /* Sets up the CPU for running user code in the current
@@ -523,6 +537,11 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
   return true;
 }
 
+/* Most pages load_segment() fills with a single file_read(), so
+   that the file system can fetch up to 64 kB of the executable
+   with one multi-sector disk command. */
+#define LOAD_CHUNK_PAGES 16
+
 /* Loads a segment starting at offset OFS in FILE at address
    UPAGE.  In total, READ_BYTES + ZERO_BYTES bytes of virtual
    memory are initialized, as follows:
@@ -548,36 +567,48 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   file_seek (file, ofs);
   while (read_bytes > 0 || zero_bytes > 0) 
     {
-      /* Calculate how to fill this page.
-         We will read PAGE_READ_BYTES bytes from FILE
-         and zero the final PAGE_ZERO_BYTES bytes. */
-      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-      size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-      /* Get a page of memory. */
-      uint8_t *kpage = palloc_get_page (PAL_USER);
+      /* Get up to LOAD_CHUNK_PAGES contiguous pages of memory,
+         or a single page if the user pool is too fragmented. */
+      size_t page_cnt = (read_bytes + zero_bytes) / PGSIZE;
+      size_t i;
+      if (page_cnt > LOAD_CHUNK_PAGES)
+        page_cnt = LOAD_CHUNK_PAGES;
+      uint8_t *kpage = palloc_get_multiple (PAL_USER, page_cnt);
       if (kpage == NULL)
-        return false;
-
-      /* Load this page. */
-      if (file_read (file, kpage, page_read_bytes) != (int) page_read_bytes)
         {
-          palloc_free_page (kpage);
-          return false; 
+          page_cnt = 1;
+          kpage = palloc_get_page (PAL_USER);
+          if (kpage == NULL)
+            return false;
         }
-      memset (kpage + page_read_bytes, 0, page_zero_bytes);
 
-      /* Add the page to the process's address space. */
-      if (!install_page (upage, kpage, writable)) 
+      /* Calculate how to fill these pages.
+         We will read CHUNK_READ_BYTES bytes from FILE
+         and zero the final CHUNK_ZERO_BYTES bytes. */
+      size_t chunk_read_bytes = (read_bytes < page_cnt * PGSIZE
+                                 ? read_bytes : page_cnt * PGSIZE);
+      size_t chunk_zero_bytes = page_cnt * PGSIZE - chunk_read_bytes;
+
+      /* Load these pages with a single read. */
+      if (file_read (file, kpage, chunk_read_bytes) != (int) chunk_read_bytes)
         {
-          palloc_free_page (kpage);
+          palloc_free_multiple (kpage, page_cnt);
           return false; 
         }
+      memset (kpage + chunk_read_bytes, 0, chunk_zero_bytes);
+
+      /* Add the pages to the process's address space. */
+      for (i = 0; i < page_cnt; i++)
+        if (!install_page (upage + i * PGSIZE, kpage + i * PGSIZE, writable)) 
+          {
+            palloc_free_multiple (kpage + i * PGSIZE, page_cnt - i);
+            return false; 
+          }
 
       /* Advance. */
-      read_bytes -= page_read_bytes;
-      zero_bytes -= page_zero_bytes;
-      upage += PGSIZE;
+      read_bytes -= chunk_read_bytes;
+      zero_bytes -= chunk_zero_bytes;
+      upage += page_cnt * PGSIZE;
     }
   return true;
 }
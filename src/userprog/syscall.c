@@ -14,6 +14,8 @@
 #include "filesys/off_t.h"
 #include "filesys/file.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "devices/block.h"    // block_get_stats()
 #include "devices/shutdown.h" // shutdown_power_off()
 #include "userprog/process.h"
 
@@ -31,6 +33,7 @@ struct inode_disk
     off_t length;     // File size in bytes. 할당 된 블록길이(byte) 파일 생성 시, 디스크 상에 연속된 block을 할당 받음
     unsigned magic;    // Magic number. 
     bool is_dir; // dir(=true), file(=1) 
+    uint8_t dir_format; // directory entry format (enum dir_format), dir only
 
     // 아래 순서대로 table을 사용
     // 1. 접근할 disk 블록의 번호들이 저장 -> direct 방식
@@ -166,6 +169,14 @@ syscall_handler (struct intr_frame *f UNUSED)
       f->eax = readdir((int)*(uint32_t *)(f->esp+4), *(char**)(f->esp+8));
       break;
 
+    case SYS_READDIR_NAME:
+      addr_validation(f->esp+4, false);
+      addr_validation(f->esp+8, false);
+      addr_validation(f->esp+12, false);
+      f->eax = readdir_name((int)*(uint32_t *)(f->esp+4), *(char**)(f->esp+8),
+                            *(size_t *)(f->esp+12));
+      break;
+
     case SYS_ISDIR: //fd 리스트에서 fd에 대한 file 정보 얻기
       addr_validation(f->esp+4, false);
       f->eax = isdir((int)*(uint32_t *)(f->esp+4));
@@ -176,6 +187,43 @@ syscall_handler (struct intr_frame *f UNUSED)
       f->eax = inumber((int)*(uint32_t *)(f->esp+4));
       break;
 
+    case SYS_IOSTAT:
+      addr_validation(f->esp+4, false);
+      addr_validation(f->esp+8, false);
+      f->eax = iostat(*(const char**)(f->esp+4),
+                      *(struct iostat **)(f->esp+8));
+      break;
+
+    // disk를 기다리는 동안 다른 process의 file system 사용을 막지 않고,
+    // 동시에 들어온 fsync들이 하나의 commit을 공유하도록 filesys_lock 없이 호출
+    case SYS_FSYNC:
+      addr_validation(f->esp+4, false);
+      f->eax = fsync((int)*(uint32_t *)(f->esp+4));
+      break;
+
+    case SYS_FDATASYNC:
+      addr_validation(f->esp+4, false);
+      f->eax = fdatasync((int)*(uint32_t *)(f->esp+4));
+      break;
+
+    ////////////// scheduling system call ////////////////
+    case SYS_RESERVE:
+      addr_validation(f->esp+4, false);
+      addr_validation(f->esp+8, false);
+      f->eax = reserve(*(int *)(f->esp+4), *(int *)(f->esp+8));
+      break;
+
+    case SYS_NEXT_PERIOD:
+      f->eax = next_period();
+      break;
+
+    case SYS_SCHEDSTAT:
+      addr_validation(f->esp+4, false);
+      addr_validation(f->esp+8, false);
+      f->eax = schedstat(*(pid_t *)(f->esp+4),
+                         *(struct schedstat **)(f->esp+8));
+      break;
+
   }
 }
 
@@ -334,7 +382,14 @@ close(int fd)
 void 
 sigaction(int signum, void(*handler)(void))
 {
-  thread_current()->parent_thread->sig_list[signum-1] = handler;
+  enum intr_level old_level;
+
+  // 부모가 이미 exit했으면 등록할 곳이 없음
+  // 부모의 process_exit()가 parent_thread를 지우는 사이에 끼지 않도록 interrupt를 끔
+  old_level = intr_disable ();
+  if (thread_current()->parent_thread != NULL)
+    thread_current()->parent_thread->sig_list[signum-1] = handler;
+  intr_set_level (old_level);
 }
 
 
@@ -343,16 +398,21 @@ sendsig(pid_t pid, int signum)
 {
   struct thread *cur = thread_current();
   struct list_elem *e;
+  bool found = false;
+  // kernel thread인 자식은 exit할 때 child_list에서 스스로 빠지므로 interrupt를 끄고 탐색
+  enum intr_level old_level = intr_disable();
   for(e=list_begin(&cur->child_list);
       e!=list_end(&cur->child_list);e=list_next(e)){
     
     struct thread *child_t = list_entry(e, struct thread, child_elem);
     
-    if(child_t->tid == pid){
-      if(cur->sig_list[signum-1])
-        printf("Signum: %d, Action: %p\n",signum, cur->sig_list[signum-1]);
-    }
+    if(child_t->tid == pid)
+      found = true;
   }
+  intr_set_level(old_level);
+
+  if(found && cur->sig_list[signum-1])
+    printf("Signum: %d, Action: %p\n",signum, cur->sig_list[signum-1]);
 }
 
 void
@@ -428,9 +488,10 @@ mkdir(const char *dir){
   struct dir* directory = parse_path(dir_copy, &dir_name);
   
   // bitmap에서 inode sector 번호 할당
+  journal_begin ();
   bool success = (directory != NULL
                   && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, 0, 1)
+                  && dir_create (inode_sector, 0, dir_get_format (directory))
                   && dir_add (directory, dir_name, inode_sector));
 
   // 해당 inode_sector 열어서 새로운 dir로 오픈
@@ -448,38 +509,77 @@ mkdir(const char *dir){
 
   if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1);
+  journal_end ();
 
   dir_close (directory);
   free(dir_copy);
   return success;
 }
 
+/* DIR에서 '.', '..' 외의 다음 entry 이름을 ENTRY에 읽음
+   더 이상 entry가 없으면 false */
+static bool
+next_entry(struct dir *dir, char entry[NAME_MAX + 1])
+{
+  while (dir_readdir (dir, entry)){
+    if (entry[0] == '.') {
+      if(strlen(entry) == 1) 
+        continue;
+      else if (entry[1] == '.'){
+        if (strlen(entry) == 2)
+          continue;
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+/* 예전 ABI: 이름을 READDIR_MAX_LEN 글자로 잘라서 NAME에 복사 */
 bool 
 readdir(int fd, char *name)
 {
   struct file* file = process_get_file(fd);
-  bool success = false;
+  // compact directory의 이름은 user buffer보다 길 수 있으므로 kernel buffer에 먼저 읽음
+  char entry[NAME_MAX + 1];
 
   if (!file) 
     return false;
-  else {
-    struct dir* dir = file;
-    // '.', '..' 파일 외의 file을 변수에 저장
-    while (dir_readdir (dir, name)){
-      
-      if (name[0] == '.') {
-        if(strlen(name) == 1) 
-          continue;
-        else if (name[1] == '.'){
-          if (strlen(name) == 2)
-            continue;
-        }
-      }
-      success = true;
-      break;
-    }
+  if (!next_entry ((struct dir *) file, entry))
+    return false;
+  strlcpy (name, entry, READDIR_MAX_LEN + 1);
+  return true;
+}
+
+/* 다음 entry의 이름 전체를 SIZE byte의 NAME에 복사하고 이름의 길이를 return
+   entry가 더 없으면 0, fd가 열려 있지 않거나 NAME이 작으면 -1
+   NAME이 작을 때는 entry를 소비하지 않으므로 더 큰 buffer로 다시 읽을 수 있음 */
+int
+readdir_name(int fd, char *name, size_t size)
+{
+  struct file* file = process_get_file(fd);
+  struct dir *dir = (struct dir *) file;
+  char entry[NAME_MAX + 1];
+  size_t len;
+  off_t pos;
+
+  if (size > 0){
+    addr_validation((void *) name, false);
+    addr_validation(name + size - 1, false);
   }
-  return success;
+  if (!file) 
+    return -1;
+
+  pos = dir_tell (dir);
+  if (!next_entry (dir, entry))
+    return 0;
+  len = strlen (entry);
+  if (len + 1 > size){
+    dir_seek (dir, pos);
+    return -1;
+  }
+  memcpy (name, entry, len + 1);
+  return len;
 }
 
 
@@ -507,3 +607,62 @@ inumber(int fd){
   // fd와 관련된 file or directory의 inode number를 return
   return inode_get_inumber(file_get_inode(f));
 }
+
+/* NAME(role 또는 block device 이름)의 I/O 통계를 STATS에 복사 */
+bool
+iostat(const char *name, struct iostat *stats){
+  // name과 stats 영역 전체가 user 영역에 있는지 확인
+  addr_validation((void *) name, false);
+  addr_validation((void *) stats, false);
+  addr_validation((uint8_t *) stats + sizeof *stats - 1, false);
+  return block_get_stats(name, stats);
+}
+
+/* fd의 data와 metadata를 disk에 기록한 뒤 return */
+bool
+fsync(int fd){
+  struct file *f = process_get_file(fd);
+  if (f == NULL)
+    return false;
+  inode_sync(file_get_inode(f), false);
+  return true;
+}
+
+/* fd의 data와, data를 찾는 데 필요한 metadata만 disk에 기록한 뒤 return */
+bool
+fdatasync(int fd){
+  struct file *f = process_get_file(fd);
+  if (f == NULL)
+    return false;
+  inode_sync(file_get_inode(f), true);
+  return true;
+}
+
+/* 매 PERIOD tick마다 BUDGET tick의 CPU 시간을 EDF로 예약
+   PERIOD와 BUDGET이 모두 0이면 예약 취소, admission에 실패하면 false */
+bool
+reserve(int period, int budget){
+  if (period < 0 || budget < 0)
+    return false;
+  return thread_edf_reserve(period, budget);
+}
+
+/* 이번 period의 job을 끝내고 다음 period가 시작될 때까지 대기
+   지금까지 놓친 deadline 수를 return, 예약이 없으면 -1 */
+int
+next_period(void){
+  if (!thread_edf_wait())
+    return -1;
+  return thread_current()->edf_misses;
+}
+
+/* PID 프로세스(0이면 자신)의 scheduler 통계를 STATS에 복사
+   그런 프로세스가 없으면 false */
+bool
+schedstat(pid_t pid, struct schedstat *stats){
+  addr_validation((void *) stats, false);
+  addr_validation((uint8_t *) stats + sizeof *stats - 1, false);
+  if (pid < 0)
+    return false;
+  return thread_get_stats(pid, stats);
+}
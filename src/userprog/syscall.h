@@ -1,11 +1,17 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 #include <stdbool.h>
+#include <iostat.h>
+#include <schedstat.h>
+#include "threads/synch.h"
 
 typedef int pid_t;
 
 void syscall_init (void);
 
+/* Serializes the file system system calls. */
+extern struct lock filesys_lock;
+
 ////////////// process related system calls //////////////
 void halt(void);
 void exit(int);
@@ -30,7 +36,16 @@ void close(int);
 bool chdir (const char *old_path);
 bool mkdir (const char *dir);
 bool readdir (int fd, char *name);
+int readdir_name (int fd, char *name, size_t size);
 bool isdir (int fd);
 int inumber (int fd);
+bool iostat (const char *name, struct iostat *);
+bool fsync (int fd);
+bool fdatasync (int fd);
+
+//////////////// scheduling system calls ////////////////
+bool reserve (int period, int budget);
+int next_period (void);
+bool schedstat (pid_t, struct schedstat *);
 
 #endif /* userprog/syscall.h */
@@ -2,8 +2,8 @@
 #include <debug.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
+#include "threads/cpu.h"
 #include "threads/thread.h"
-#include "threads/palloc.h"
 #include "threads/vaddr.h"
 
 /* The Task-State Segment (TSS).
@@ -72,35 +72,40 @@ struct tss
     uint16_t trace, bitmap;
   };
 
-/* Kernel TSS. */
-static struct tss *tss;
+/* Kernel TSSes, one per CPU, since each CPU runs a different
+   thread on a different kernel stack.  They are static, not
+   allocated, so that a CPU can set up its own before it may
+   take locks. */
+static struct tss tsses[CPU_MAX];
 
-/* Initializes the kernel TSS. */
+/* Initializes the current CPU's kernel TSS. */
 void
 tss_init (void) 
 {
+  struct tss *tss = &tsses[cpu_current ()->id];
+
   /* Our TSS is never used in a call gate or task gate, so only a
      few fields of it are ever referenced, and those are the only
      ones we initialize. */
-  tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   tss->ss0 = SEL_KDSEG;
   tss->bitmap = 0xdfff;
   tss_update ();
 }
 
-/* Returns the kernel TSS. */
+/* Returns the current CPU's kernel TSS. */
 struct tss *
 tss_get (void) 
 {
-  ASSERT (tss != NULL);
+  struct tss *tss = &tsses[cpu_current ()->id];
+
+  ASSERT (tss->ss0 == SEL_KDSEG);
   return tss;
 }
 
-/* Sets the ring 0 stack pointer in the TSS to point to the end
-   of the thread stack. */
+/* Sets the ring 0 stack pointer in the current CPU's TSS to point
+   to the end of the thread stack. */
 void
 tss_update (void) 
 {
-  ASSERT (tss != NULL);
-  tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
+  tss_get ()->esp0 = (uint8_t *) thread_current () + PGSIZE;
 }
@@ -0,0 +1,877 @@
+/* pintos-mkfs, a utility for building and checking Pintos file
+   system images on the host.
+
+   The image written is the raw contents of a file system
+   partition, laid out exactly as the kernel's do_format() and
+   filesys_create() would lay it out: the free map's inode in
+   sector 0, the root directory's inode in sector 1, the journal
+   superblock in sector 2, and indexed inodes as described by
+   struct inode_disk in filesys/inode.c.  Images built here have
+   no journal: sector 2 is reserved but left zeroed, so the
+   kernel uses them unjournaled.
+   Use it with "pintos --filesys=IMAGE" (or pintos-mkdisk) and
+   leave off -f, so that the guest neither formats nor extracts.
+
+   The structures below must be kept in sync with filesys/inode.c,
+   filesys/directory.c, filesys/free-map.c and filesys/journal.c. */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define SECTOR_SIZE 512                 /* Bytes per sector. */
+#define FREE_MAP_SECTOR 0               /* Free map file inode sector. */
+#define ROOT_DIR_SECTOR 1               /* Root directory inode sector. */
+#define JOURNAL_SECTOR 2                /* Journal superblock sector. */
+
+#define INODE_MAGIC 0x494e4f44
+#define DIRECT_CNT 123                  /* Direct blocks per inode. */
+#define INDIRECT_CNT (SECTOR_SIZE / 4)  /* Pointers per index block. */
+#define MAX_SECTORS (DIRECT_CNT + INDIRECT_CNT \
+                     + INDIRECT_CNT * INDIRECT_CNT)
+
+#define FREE_MAP_MAGIC 0x46524545
+#define JOURNAL_MAGIC 0x4a524e4c
+#define GROUP_SECTORS (SECTOR_SIZE * 8) /* Sectors per allocation group. */
+
+#define FIXED_NAME_MAX 14               /* DIR_FIXED_NAME_MAX. */
+#define NAME_MAX 255
+#define ROOT_ENTRY_CNT 16               /* Fixed root directory slots. */
+
+enum dir_format
+  {
+    DIR_FORMAT_FIXED,
+    DIR_FORMAT_COMPACT
+  };
+
+/* On-disk inode.  Must be exactly SECTOR_SIZE bytes long. */
+struct inode_disk
+  {
+    int32_t length;                     /* File size in bytes. */
+    uint32_t magic;                     /* INODE_MAGIC. */
+    uint8_t is_dir;                     /* Directory? */
+    uint8_t dir_format;                 /* enum dir_format, dirs only. */
+    uint8_t pad[2];
+    uint32_t direct[DIRECT_CNT];
+    uint32_t indirect;
+    uint32_t double_indirect;
+  };
+
+/* Fixed-format directory entry. */
+struct dir_entry
+  {
+    uint32_t inode_sector;
+    char name[FIXED_NAME_MAX + 1];
+    uint8_t in_use;
+  };
+
+/* Header of a compact-format directory record. */
+struct dir_record
+  {
+    uint32_t inode_sector;              /* 0 if free. */
+    uint16_t rec_len;
+    uint8_t name_len;
+    uint8_t unused;
+  };
+
+/* Free map file header.  Must be exactly SECTOR_SIZE bytes long. */
+struct free_map_header
+  {
+    uint32_t magic;                     /* FREE_MAP_MAGIC. */
+    uint32_t init_cnt;                  /* Number of groups written. */
+    uint8_t unused[SECTOR_SIZE - 8];
+  };
+
+/* Journal superblock.  Must be exactly SECTOR_SIZE bytes long. */
+struct journal_super
+  {
+    uint32_t magic;                     /* JOURNAL_MAGIC. */
+    uint32_t start;                     /* First sector of log. */
+    uint32_t size;                      /* Sectors in log. */
+    uint32_t seq;                       /* First transaction in log. */
+    uint8_t unused[SECTOR_SIZE - 16];
+  };
+
+/* A file to put into the image. */
+struct put_file
+  {
+    const char *src;                    /* Name on the host. */
+    const char *name;                   /* Name in the image. */
+    uint32_t sector;                    /* Inode sector. */
+  };
+
+static const char *image_name;          /* Image file name. */
+static int image_fd;                    /* Image file descriptor. */
+static uint32_t sector_cnt;             /* Sectors in image. */
+static uint8_t *free_map;               /* One bit per sector. */
+static int error_cnt;                   /* Errors found by check. */
+
+static void usage (int exit_code) __attribute__ ((noreturn));
+static void fail (const char *, ...)
+  __attribute__ ((noreturn, format (printf, 1, 2)));
+
+/* Prints a message formatted like printf() to stderr, prefixed
+   by the program name, and exits unsuccessfully. */
+static void
+fail (const char *format, ...)
+{
+  va_list args;
+
+  fprintf (stderr, "pintos-mkfs: ");
+  va_start (args, format);
+  vfprintf (stderr, format, args);
+  va_end (args);
+  putc ('\n', stderr);
+  exit (EXIT_FAILURE);
+}
+
+/* Reports a problem found by check_image(). */
+static void
+complain (const char *format, ...)
+{
+  va_list args;
+
+  fprintf (stderr, "%s: ", image_name);
+  va_start (args, format);
+  vfprintf (stderr, format, args);
+  va_end (args);
+  putc ('\n', stderr);
+  error_cnt++;
+}
+
+static void *
+xmalloc (size_t size)
+{
+  void *p = calloc (1, size ? size : 1);
+  if (p == NULL)
+    fail ("out of memory");
+  return p;
+}
+
+/* Returns the number of bytes the kernel's struct bitmap uses to
+   store BIT_CNT bits in a file: whole 32-bit elements. */
+static size_t
+bitmap_bytes (size_t bit_cnt)
+{
+  return (bit_cnt + 31) / 32 * 4;
+}
+
+static size_t
+bytes_to_sectors (size_t size)
+{
+  return (size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+}
+
+static bool
+bit_test (const uint8_t *map, uint32_t idx)
+{
+  return (map[idx / 8] >> (idx % 8)) & 1;
+}
+
+static void
+bit_mark (uint8_t *map, uint32_t idx)
+{
+  map[idx / 8] |= 1 << (idx % 8);
+}
+
+static void
+read_sector (uint32_t sector, void *buf)
+{
+  if (pread (image_fd, buf, SECTOR_SIZE, (off_t) sector * SECTOR_SIZE)
+      != SECTOR_SIZE)
+    fail ("%s: reading sector %u: %s", image_name, sector, strerror (errno));
+}
+
+static void
+write_sector (uint32_t sector, const void *buf)
+{
+  if (pwrite (image_fd, buf, SECTOR_SIZE, (off_t) sector * SECTOR_SIZE)
+      != SECTOR_SIZE)
+    fail ("%s: writing sector %u: %s", image_name, sector, strerror (errno));
+}
+
+/* Reads the 32-bit pointer at index IDX of index block SECTOR. */
+static uint32_t
+read_pointer (uint32_t sector, size_t idx)
+{
+  uint32_t block[INDIRECT_CNT];
+
+  read_sector (sector, block);
+  return block[idx];
+}
+
+/* Returns the sector that holds sector IDX of the file whose
+   inode is INODE, following the same index layout as the
+   kernel's byte_to_sector(). */
+static uint32_t
+file_sector (const struct inode_disk *inode, size_t idx)
+{
+  if (idx < DIRECT_CNT)
+    return inode->direct[idx];
+  idx -= DIRECT_CNT;
+  if (idx < INDIRECT_CNT)
+    return read_pointer (inode->indirect, idx);
+  idx -= INDIRECT_CNT;
+  return read_pointer (read_pointer (inode->double_indirect,
+                                     idx / INDIRECT_CNT),
+                       idx % INDIRECT_CNT);
+}
+
+/* Builder. */
+
+/* Allocates and returns the first free sector. */
+static uint32_t
+alloc_sector (void)
+{
+  static uint32_t hint;
+  uint32_t sector;
+
+  for (sector = hint; sector < sector_cnt; sector++)
+    if (!bit_test (free_map, sector))
+      {
+        bit_mark (free_map, sector);
+        hint = sector + 1;
+        return sector;
+      }
+  fail ("%s: image is full", image_name);
+}
+
+/* Writes an inode for a LENGTH-byte file to SECTOR, allocating
+   its data and index blocks.  If DATA is nonnull, writes LENGTH
+   bytes from it as the file's contents; otherwise the data
+   sectors are left for the caller to fill in. */
+static void
+make_inode (uint32_t sector, const uint8_t *data, size_t length,
+            bool is_dir, enum dir_format format)
+{
+  static const uint8_t zeros[SECTOR_SIZE];
+  uint32_t indirect[INDIRECT_CNT], dbl[INDIRECT_CNT];
+  uint32_t second[INDIRECT_CNT];
+  struct inode_disk inode;
+  size_t sectors = bytes_to_sectors (length);
+  size_t i;
+
+  if (sectors > MAX_SECTORS)
+    fail ("file of %zu bytes is too large for a Pintos inode", length);
+
+  memset (&inode, 0, sizeof inode);
+  inode.length = length;
+  inode.magic = INODE_MAGIC;
+  inode.is_dir = is_dir;
+  inode.dir_format = is_dir ? format : 0;
+  memset (indirect, 0, sizeof indirect);
+  memset (dbl, 0, sizeof dbl);
+  memset (second, 0, sizeof second);
+
+  for (i = 0; i < sectors; i++)
+    {
+      uint32_t block;
+
+      /* Allocate index blocks in the same order as the kernel, so
+         that an image looks like one the guest built itself. */
+      if (i == DIRECT_CNT)
+        inode.indirect = alloc_sector ();
+      else if (i == DIRECT_CNT + INDIRECT_CNT)
+        inode.double_indirect = alloc_sector ();
+      if (i >= DIRECT_CNT + INDIRECT_CNT
+          && (i - DIRECT_CNT - INDIRECT_CNT) % INDIRECT_CNT == 0)
+        dbl[(i - DIRECT_CNT - INDIRECT_CNT) / INDIRECT_CNT] = alloc_sector ();
+
+      block = alloc_sector ();
+      if (i < DIRECT_CNT)
+        inode.direct[i] = block;
+      else if (i < DIRECT_CNT + INDIRECT_CNT)
+        indirect[i - DIRECT_CNT] = block;
+      else
+        {
+          size_t j = i - DIRECT_CNT - INDIRECT_CNT;
+          second[j % INDIRECT_CNT] = block;
+          if (j % INDIRECT_CNT == INDIRECT_CNT - 1 || i == sectors - 1)
+            {
+              write_sector (dbl[j / INDIRECT_CNT], second);
+              memset (second, 0, sizeof second);
+            }
+        }
+
+      if (data != NULL)
+        {
+          size_t ofs = i * SECTOR_SIZE;
+          size_t chunk = length - ofs < SECTOR_SIZE ? length - ofs
+                                                     : SECTOR_SIZE;
+          uint8_t buf[SECTOR_SIZE];
+
+          memcpy (buf, zeros, SECTOR_SIZE);
+          memcpy (buf, data + ofs, chunk);
+          write_sector (block, buf);
+        }
+    }
+  if (sectors > DIRECT_CNT)
+    write_sector (inode.indirect, indirect);
+  if (sectors > DIRECT_CNT + INDIRECT_CNT)
+    write_sector (inode.double_indirect, dbl);
+  write_sector (sector, &inode);
+}
+
+/* Appends a compact directory record for NAME to the directory
+   contents in *BUF, which currently holds *LENGTH bytes of which
+   the last sector is filled up to *USED bytes. */
+static void
+add_record (uint8_t **buf, size_t *length, size_t *used,
+            const char *name, uint32_t inode_sector)
+{
+  size_t name_len = strlen (name);
+  size_t need = (sizeof (struct dir_record) + name_len + 3) / 4 * 4;
+  struct dir_record *r;
+
+  if (*length == 0 || SECTOR_SIZE - *used < need)
+    {
+      *buf = realloc (*buf, *length + SECTOR_SIZE);
+      if (*buf == NULL)
+        fail ("out of memory");
+      memset (*buf + *length, 0, SECTOR_SIZE);
+      *length += SECTOR_SIZE;
+      *used = 0;
+    }
+
+  /* Every record is written spanning to the end of its sector,
+     then trimmed when the next record is placed behind it. */
+  if (*used > 0)
+    {
+      size_t prev = *length - SECTOR_SIZE;
+      size_t ofs = 0;
+
+      for (;;)
+        {
+          r = (struct dir_record *) (*buf + prev + ofs);
+          if (ofs + r->rec_len == SECTOR_SIZE)
+            break;
+          ofs += r->rec_len;
+        }
+      r->rec_len = *used - ofs;
+    }
+  r = (struct dir_record *) (*buf + *length - SECTOR_SIZE + *used);
+  r->inode_sector = inode_sector;
+  r->rec_len = SECTOR_SIZE - *used;
+  r->name_len = name_len;
+  memcpy (r + 1, name, name_len);
+  *used += need;
+}
+
+/* Builds the contents of the root directory, holding "." and
+   ".." and the CNT files in FILES, and writes its inode. */
+static void
+make_root (const struct put_file *files, size_t cnt, enum dir_format format)
+{
+  uint8_t *buf = NULL;
+  size_t length = 0;
+  size_t i;
+
+  if (format == DIR_FORMAT_FIXED)
+    {
+      size_t slots = cnt + 2 > ROOT_ENTRY_CNT ? cnt + 2 : ROOT_ENTRY_CNT;
+      struct dir_entry *e;
+
+      length = slots * sizeof *e;
+      buf = xmalloc (length);
+      e = (struct dir_entry *) buf;
+      e[0].inode_sector = e[1].inode_sector = ROOT_DIR_SECTOR;
+      strcpy (e[0].name, ".");
+      strcpy (e[1].name, "..");
+      e[0].in_use = e[1].in_use = 1;
+      for (i = 0; i < cnt; i++)
+        {
+          e[i + 2].inode_sector = files[i].sector;
+          strcpy (e[i + 2].name, files[i].name);
+          e[i + 2].in_use = 1;
+        }
+    }
+  else
+    {
+      size_t used = 0;
+
+      add_record (&buf, &length, &used, ".", ROOT_DIR_SECTOR);
+      add_record (&buf, &length, &used, "..", ROOT_DIR_SECTOR);
+      for (i = 0; i < cnt; i++)
+        add_record (&buf, &length, &used, files[i].name, files[i].sector);
+    }
+  make_inode (ROOT_DIR_SECTOR, buf, length, true, format);
+  free (buf);
+}
+
+/* Reads the whole of host file NAME into a new buffer and stores
+   its size in *SIZE. */
+static uint8_t *
+slurp (const char *name, size_t *size)
+{
+  struct stat st;
+  uint8_t *buf;
+  int fd;
+
+  fd = open (name, O_RDONLY);
+  if (fd < 0 || fstat (fd, &st) < 0)
+    fail ("%s: %s", name, strerror (errno));
+  buf = xmalloc (st.st_size);
+  if (read (fd, buf, st.st_size) != st.st_size)
+    fail ("%s: read failed", name);
+  close (fd);
+  *size = st.st_size;
+  return buf;
+}
+
+/* Creates image IMAGE_NAME of SIZE_MB megabytes holding the CNT
+   files in FILES in its root directory. */
+static void
+build_image (double size_mb, struct put_file *files, size_t cnt,
+             enum dir_format format)
+{
+  size_t name_max = format == DIR_FORMAT_FIXED ? FIXED_NAME_MAX : NAME_MAX;
+  size_t map_bytes, init_cnt, used, i;
+  struct inode_disk map_inode;
+  struct free_map_header h;
+  uint8_t *contents;
+
+  sector_cnt = size_mb * 1024 * 1024 / SECTOR_SIZE;
+  if (sector_cnt <= JOURNAL_SECTOR || sector_cnt >= 1u << 28)
+    fail ("%g MB is not a usable file system size", size_mb);
+  image_fd = open (image_name, O_RDWR | O_CREAT | O_EXCL, 0666);
+  if (image_fd < 0)
+    fail ("%s: %s", image_name, strerror (errno));
+  if (ftruncate (image_fd, (off_t) sector_cnt * SECTOR_SIZE) < 0)
+    fail ("%s: %s", image_name, strerror (errno));
+
+  map_bytes = bitmap_bytes (sector_cnt);
+  free_map = xmalloc (map_bytes);
+  bit_mark (free_map, FREE_MAP_SECTOR);
+  bit_mark (free_map, ROOT_DIR_SECTOR);
+  bit_mark (free_map, JOURNAL_SECTOR);
+
+  /* Free map file first, as in do_format().  Its contents are
+     written once everything else has been allocated. */
+  make_inode (FREE_MAP_SECTOR, NULL, SECTOR_SIZE + map_bytes, false, 0);
+
+  for (i = 0; i < cnt; i++)
+    {
+      size_t size;
+      uint8_t *data;
+      size_t j;
+
+      if (strchr (files[i].name, '/') != NULL || files[i].name[0] == '\0'
+          || strlen (files[i].name) > name_max)
+        fail ("\"%s\": not a valid root directory entry name",
+              files[i].name);
+      for (j = 0; j < i; j++)
+        if (!strcmp (files[i].name, files[j].name))
+          fail ("\"%s\": duplicate file name", files[i].name);
+
+      data = slurp (files[i].src, &size);
+      files[i].sector = alloc_sector ();
+      make_inode (files[i].sector, data, size, false, 0);
+      free (data);
+    }
+  make_root (files, cnt, format);
+
+  /* Write the header and the groups in use, in one pass. */
+  for (used = sector_cnt; used > 0 && !bit_test (free_map, used - 1); used--)
+    continue;
+  init_cnt = (used + GROUP_SECTORS - 1) / GROUP_SECTORS;
+  memset (&h, 0, sizeof h);
+  h.magic = FREE_MAP_MAGIC;
+  h.init_cnt = init_cnt;
+  contents = xmalloc ((init_cnt + 1) * SECTOR_SIZE);
+  memcpy (contents, &h, sizeof h);
+  memcpy (contents + SECTOR_SIZE, free_map,
+          init_cnt * SECTOR_SIZE < map_bytes ? init_cnt * SECTOR_SIZE
+                                             : map_bytes);
+  read_sector (FREE_MAP_SECTOR, &map_inode);
+  for (i = 0; i <= init_cnt; i++)
+    write_sector (file_sector (&map_inode, i), contents + i * SECTOR_SIZE);
+  free (contents);
+
+  if (close (image_fd) < 0)
+    fail ("%s: %s", image_name, strerror (errno));
+}
+
+/* Checker. */
+
+static uint8_t *claimed;                /* Sectors referenced so far. */
+static size_t file_cnt, dir_cnt;        /* Inodes found by the walk. */
+
+/* Marks SECTOR as referenced by WHAT.  Returns false, after
+   complaining, if it is out of range or already referenced. */
+static bool
+claim (uint32_t sector, const char *what)
+{
+  if (sector >= sector_cnt)
+    {
+      complain ("%s: sector %u is beyond end of image", what, sector);
+      return false;
+    }
+  if (bit_test (claimed, sector))
+    {
+      complain ("%s: sector %u is referenced twice", what, sector);
+      return false;
+    }
+  bit_mark (claimed, sector);
+  return true;
+}
+
+/* Reads and validates the inode in SECTOR, claiming it and all of
+   its blocks on behalf of PATH.  Returns false if it is unusable. */
+static bool
+check_inode (uint32_t sector, const char *path, struct inode_disk *inode)
+{
+  size_t sectors, i;
+
+  if (!claim (sector, path))
+    return false;
+  read_sector (sector, inode);
+  if (inode->magic != INODE_MAGIC)
+    {
+      complain ("%s: sector %u has bad inode magic %08x",
+                path, sector, inode->magic);
+      return false;
+    }
+  if (inode->length < 0
+      || bytes_to_sectors (inode->length) > MAX_SECTORS)
+    {
+      complain ("%s: bad length %d", path, inode->length);
+      return false;
+    }
+
+  sectors = bytes_to_sectors (inode->length);
+  if (sectors > DIRECT_CNT && !claim (inode->indirect, path))
+    return false;
+  if (sectors > DIRECT_CNT + INDIRECT_CNT)
+    {
+      if (!claim (inode->double_indirect, path))
+        return false;
+      for (i = 0; i < (sectors - DIRECT_CNT - INDIRECT_CNT
+                       + INDIRECT_CNT - 1) / INDIRECT_CNT; i++)
+        if (!claim (read_pointer (inode->double_indirect, i), path))
+          return false;
+    }
+  for (i = 0; i < sectors; i++)
+    if (!claim (file_sector (inode, i), path))
+      return false;
+  return true;
+}
+
+/* Reads the contents of the file with INODE into a new buffer. */
+static uint8_t *
+read_file (const struct inode_disk *inode)
+{
+  uint8_t *buf = xmalloc (bytes_to_sectors (inode->length) * SECTOR_SIZE);
+  size_t i;
+
+  for (i = 0; i < bytes_to_sectors (inode->length); i++)
+    read_sector (file_sector (inode, i), buf + i * SECTOR_SIZE);
+  return buf;
+}
+
+static void check_dir (uint32_t sector, uint32_t parent, const char *path,
+                       const struct inode_disk *);
+
+/* Checks the directory entry NAME in directory PATH, whose inode
+   is in SECTOR and whose parent's is in PARENT. */
+static void
+check_entry (uint32_t sector, uint32_t parent, const char *path,
+             const char *name, uint32_t inode_sector)
+{
+  struct inode_disk inode;
+  char *child;
+
+  if (!strcmp (name, "."))
+    {
+      if (inode_sector != sector)
+        complain ("%s: \".\" points to sector %u", path, inode_sector);
+      return;
+    }
+  if (!strcmp (name, ".."))
+    {
+      if (inode_sector != parent)
+        complain ("%s: \"..\" points to sector %u", path, inode_sector);
+      return;
+    }
+
+  child = xmalloc (strlen (path) + strlen (name) + 2);
+  sprintf (child, "%s%s%s", path, strcmp (path, "/") ? "/" : "", name);
+  if (check_inode (inode_sector, child, &inode))
+    {
+      if (inode.is_dir)
+        check_dir (inode_sector, sector, child, &inode);
+      else
+        file_cnt++;
+    }
+  free (child);
+}
+
+/* Checks every entry of directory PATH, with inode INODE stored in
+   SECTOR, and everything below it. */
+static void
+check_dir (uint32_t sector, uint32_t parent, const char *path,
+           const struct inode_disk *inode)
+{
+  uint8_t *buf = read_file (inode);
+  char name[NAME_MAX + 1];
+  size_t ofs;
+
+  dir_cnt++;
+  if (inode->dir_format == DIR_FORMAT_FIXED)
+    {
+      for (ofs = 0; ofs + sizeof (struct dir_entry) <= (size_t) inode->length;
+           ofs += sizeof (struct dir_entry))
+        {
+          struct dir_entry *e = (struct dir_entry *) (buf + ofs);
+          if (!e->in_use)
+            continue;
+          if (memchr (e->name, '\0', sizeof e->name) == NULL)
+            {
+              complain ("%s: entry at offset %zu is not null-terminated",
+                        path, ofs);
+              continue;
+            }
+          check_entry (sector, parent, path, e->name, e->inode_sector);
+        }
+    }
+  else if (inode->dir_format == DIR_FORMAT_COMPACT)
+    {
+      if (inode->length % SECTOR_SIZE != 0)
+        complain ("%s: compact directory length %d is not a whole "
+                  "number of sectors", path, inode->length);
+      for (ofs = 0; ofs + SECTOR_SIZE <= (size_t) inode->length;
+           ofs += SECTOR_SIZE)
+        {
+          size_t rec_ofs = 0;
+
+          while (rec_ofs < SECTOR_SIZE)
+            {
+              struct dir_record *r
+                = (struct dir_record *) (buf + ofs + rec_ofs);
+              size_t need = (sizeof *r + r->name_len + 3) / 4 * 4;
+
+              if (rec_ofs + sizeof *r > SECTOR_SIZE
+                  || r->rec_len < sizeof *r || r->rec_len % 4 != 0
+                  || rec_ofs + r->rec_len > SECTOR_SIZE
+                  || (r->inode_sector != 0 && need > r->rec_len))
+                {
+                  complain ("%s: malformed record at offset %zu",
+                            path, ofs + rec_ofs);
+                  break;
+                }
+              if (r->inode_sector != 0)
+                {
+                  memcpy (name, r + 1, r->name_len);
+                  name[r->name_len] = '\0';
+                  check_entry (sector, parent, path, name, r->inode_sector);
+                }
+              rec_ofs += r->rec_len;
+            }
+        }
+    }
+  else
+    complain ("%s: unknown directory format %d", path, inode->dir_format);
+  free (buf);
+}
+
+/* Checks image IMAGE_NAME and reports what it finds.  Returns
+   true if the image is consistent. */
+static bool
+check_image (void)
+{
+  struct inode_disk map_inode, root;
+  struct journal_super journal;
+  struct free_map_header h;
+  size_t map_bytes, groups, used = 0;
+  uint8_t *contents;
+  uint32_t sector;
+  struct stat st;
+
+  image_fd = open (image_name, O_RDONLY);
+  if (image_fd < 0 || fstat (image_fd, &st) < 0)
+    fail ("%s: %s", image_name, strerror (errno));
+  if (st.st_size % SECTOR_SIZE != 0
+      || st.st_size <= JOURNAL_SECTOR * SECTOR_SIZE)
+    fail ("%s: size %lld is not a usable number of sectors",
+          image_name, (long long) st.st_size);
+  sector_cnt = st.st_size / SECTOR_SIZE;
+  map_bytes = bitmap_bytes (sector_cnt);
+  groups = (map_bytes + SECTOR_SIZE - 1) / SECTOR_SIZE;
+  claimed = xmalloc (map_bytes);
+
+  /* Free map. */
+  if (!check_inode (FREE_MAP_SECTOR, "free map", &map_inode))
+    return false;
+  if ((size_t) map_inode.length != SECTOR_SIZE + map_bytes)
+    {
+      complain ("free map: length %d, expected %zu for %u sectors",
+                map_inode.length, SECTOR_SIZE + map_bytes, sector_cnt);
+      return false;
+    }
+  contents = read_file (&map_inode);
+  memcpy (&h, contents, sizeof h);
+  if (h.magic != FREE_MAP_MAGIC || h.init_cnt > groups)
+    {
+      complain ("free map: bad header (magic %08x, %u groups)",
+                h.magic, h.init_cnt);
+      return false;
+    }
+  free_map = xmalloc (map_bytes);
+  memcpy (free_map, contents + SECTOR_SIZE,
+          h.init_cnt * SECTOR_SIZE < map_bytes ? h.init_cnt * SECTOR_SIZE
+                                               : map_bytes);
+  free (contents);
+
+  /* Journal superblock and, if the kernel formatted the image
+     with a journal, the log it describes. */
+  read_sector (JOURNAL_SECTOR, &journal);
+  if (claim (JOURNAL_SECTOR, "journal") && journal.magic == JOURNAL_MAGIC)
+    {
+      if (journal.start >= sector_cnt
+          || journal.size > sector_cnt - journal.start)
+        complain ("journal: log of %u sectors at %u is beyond end of image",
+                  journal.size, journal.start);
+      else
+        for (sector = journal.start;
+             sector < journal.start + journal.size; sector++)
+          if (!claim (sector, "journal"))
+            break;
+    }
+
+  /* Directory tree. */
+  if (check_inode (ROOT_DIR_SECTOR, "/", &root))
+    {
+      if (!root.is_dir)
+        complain ("/: root inode is not a directory");
+      else
+        check_dir (ROOT_DIR_SECTOR, ROOT_DIR_SECTOR, "/", &root);
+    }
+
+  /* Every referenced sector must be allocated, and vice versa. */
+  for (sector = 0; sector < sector_cnt; sector++)
+    {
+      bool in_map = bit_test (free_map, sector);
+      bool in_use = bit_test (claimed, sector);
+
+      if (in_use && !in_map)
+        complain ("sector %u is in use but marked free", sector);
+      else if (in_map && !in_use)
+        complain ("sector %u is marked in use but unreferenced", sector);
+      used += in_use;
+    }
+
+  printf ("%s: %u sectors, %zu used, %zu files, %zu directories, "
+          "%d error%s\n", image_name, sector_cnt, used, file_cnt, dir_cnt,
+          error_cnt, error_cnt == 1 ? "" : "s");
+  close (image_fd);
+  return error_cnt == 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const struct option long_options[] =
+    {
+      {"check", no_argument, NULL, 'c'},
+      {"size", required_argument, NULL, 's'},
+      {"dirfmt", required_argument, NULL, 'd'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0},
+    };
+  enum dir_format format = DIR_FORMAT_FIXED;
+  double size_mb = 2;
+  bool check = false;
+  struct put_file *files;
+  int opt, i;
+
+  if (sizeof (struct inode_disk) != SECTOR_SIZE
+      || sizeof (struct free_map_header) != SECTOR_SIZE
+      || sizeof (struct journal_super) != SECTOR_SIZE
+      || sizeof (struct dir_entry) != 20
+      || sizeof (struct dir_record) != 8)
+    fail ("on-disk structures have the wrong size on this host");
+
+  while ((opt = getopt_long (argc, argv, "cs:d:h", long_options, NULL)) != -1)
+    switch (opt)
+      {
+      case 'c':
+        check = true;
+        break;
+      case 's':
+        size_mb = atof (optarg);
+        break;
+      case 'd':
+        if (!strcmp (optarg, "fixed"))
+          format = DIR_FORMAT_FIXED;
+        else if (!strcmp (optarg, "compact"))
+          format = DIR_FORMAT_COMPACT;
+        else
+          fail ("unknown directory format \"%s\"", optarg);
+        break;
+      case 'h':
+        usage (EXIT_SUCCESS);
+      default:
+        usage (EXIT_FAILURE);
+      }
+  if (optind >= argc)
+    usage (EXIT_FAILURE);
+  image_name = argv[optind++];
+
+  if (check)
+    {
+      if (optind != argc)
+        usage (EXIT_FAILURE);
+      return check_image () ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+  files = xmalloc ((argc - optind) * sizeof *files);
+  for (i = optind; i < argc; i++)
+    {
+      struct put_file *f = &files[i - optind];
+      char *eq = strchr (argv[i], '=');
+
+      f->src = argv[i];
+      if (eq != NULL)
+        {
+          *eq = '\0';
+          f->name = eq + 1;
+        }
+      else
+        {
+          const char *slash = strrchr (argv[i], '/');
+          f->name = slash != NULL ? slash + 1 : argv[i];
+        }
+    }
+  build_image (size_mb, files, argc - optind, format);
+  return EXIT_SUCCESS;
+}
+
+static void
+usage (int exit_code)
+{
+  printf ("pintos-mkfs, a utility for building Pintos file system images\n"
+          "Usage: pintos-mkfs [OPTIONS] IMAGE [FILE[=NAME]]...\n"
+          "       pintos-mkfs --check IMAGE\n"
+          "The first form creates IMAGE, a formatted file system partition\n"
+          "whose root directory holds a copy of each host FILE, under NAME\n"
+          "if given or else under FILE's last path component.  The second\n"
+          "form verifies that IMAGE is consistent.  Boot from IMAGE with\n"
+          "\"pintos --filesys=IMAGE -- -q run ...\", without -f.\n"
+          "Options:\n"
+          "  -s, --size=SIZE          Make IMAGE SIZE MB (default: 2)\n"
+          "  -d, --dirfmt=FORMAT      Root directory format, \"fixed\" "
+          "(default)\n"
+          "                           or \"compact\", as with -dirfmt\n"
+          "  -c, --check              Check IMAGE instead of creating it\n"
+          "  -h, --help               Display this help message\n");
+  exit (exit_code);
+}